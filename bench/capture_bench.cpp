@@ -0,0 +1,144 @@
+#include "capture_file.h"
+#include "capture_filter.h"
+#include "packet_parser.h"
+
+#include <cstddef>     // size_t
+#include <cstdint>     // uint8_t, uint32_t
+#include <filesystem>  // file_size, path, temp_directory_path
+#include <fstream>     // ofstream
+#include <string>      // string
+#include <vector>      // vector
+
+#include <benchmark/benchmark.h>
+#include <tins/tins.h>
+
+static constexpr std::size_t packets_per_capture = 65536;
+
+static void append_be16(std::vector<std::uint8_t>& out, unsigned int value)
+{
+    out.push_back(static_cast<std::uint8_t>(value >> 8));
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+static void append_le32(std::vector<std::uint8_t>& out, std::uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+}
+
+/** @returns An Ethernet frame carrying an IPv4 TCP segment with @p payload bytes. */
+static std::vector<std::uint8_t> make_frame(std::size_t payload, unsigned int port)
+{
+    std::vector<std::uint8_t> frame(12, 0);
+    append_be16(frame, 0x0800);
+
+    // IPv4, with no options
+    const std::size_t ip_start = frame.size();
+    frame.push_back(0x45);
+    frame.push_back(0);
+    append_be16(frame, static_cast<unsigned int>(20 + 20 + payload));
+    frame.insert(frame.end(), {0, 1, 0x40, 0, 64, 6, 0, 0, 10, 0, 0, 1, 10, 0, 0, 2});
+
+    // TCP, from an ephemeral port to another, so it passes the base capture filter
+    append_be16(frame, port);
+    append_be16(frame, 55000);
+    frame.insert(frame.end(), {0, 0, 0, 1, 0, 0, 0, 0, 0x50, 0x18, 0xff, 0xff, 0, 0, 0, 0});
+
+    frame.resize(ip_start + 40 + payload, 'x');
+    return frame;
+}
+
+/** @returns The path of a pcap file of full-size segments, written the first time it's needed. */
+static const std::string& capture_path()
+{
+    static const std::string path = []() {
+        const auto path = std::filesystem::temp_directory_path() / "gunblade_capture_bench.pcap";
+
+        std::vector<std::uint8_t> bytes;
+        append_le32(bytes, 0xa1b2c3d4);
+        bytes.insert(bytes.end(), {2, 0, 4, 0});
+        append_le32(bytes, 0);
+        append_le32(bytes, 0);
+        append_le32(bytes, 65535);
+        append_le32(bytes, 1);
+
+        for (std::size_t i = 0; i < packets_per_capture; ++i)
+        {
+            const auto frame = make_frame(1460, 49152 + (i % 64));
+
+            append_le32(bytes, static_cast<std::uint32_t>(i / 1000));
+            append_le32(bytes, static_cast<std::uint32_t>(i % 1000) * 1000);
+            append_le32(bytes, static_cast<std::uint32_t>(frame.size()));
+            append_le32(bytes, static_cast<std::uint32_t>(frame.size()));
+            bytes.insert(bytes.end(), frame.begin(), frame.end());
+        }
+
+        std::ofstream file(path, std::ios::binary);
+        file.write(
+            reinterpret_cast<const char*>(bytes.data()),
+            static_cast<std::streamsize>(bytes.size()));
+
+        return path.string();
+    }();
+
+    return path;
+}
+
+/** @brief Walks the capture in a memory map, parsing just the headers of each packet. */
+static void BM_CaptureFileParse(benchmark::State& state)
+{
+    const auto& path = capture_path();
+    std::size_t packets = 0;
+
+    for (auto _ : state)
+    {
+        gunblade::CaptureFile file(path);
+
+        while (const auto record = file.next())
+        {
+            const auto packet = gunblade::parse_tcp_packet(record->link_type, record->data);
+
+            if (packet && gunblade::matches_base_filter(packet->src_port, packet->dst_port))
+            {
+                benchmark::DoNotOptimize(packet->payload.data());
+                ++packets;
+            }
+        }
+    }
+
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * std::filesystem::file_size(path)));
+    state.counters["packets"] = benchmark::Counter(
+        static_cast<double>(packets), benchmark::Counter::kIsRate);
+}
+
+/** @brief What replays used to do: read the capture through libpcap, and parse it with libtins. */
+static void BM_FileSnifferParse(benchmark::State& state)
+{
+    const auto& path = capture_path();
+    std::size_t packets = 0;
+
+    Tins::SnifferConfiguration config;
+    config.set_filter(gunblade::base_capture_filter);
+
+    for (auto _ : state)
+    {
+        Tins::FileSniffer sniffer(path, config);
+
+        while (const auto packet = sniffer.next_packet())
+        {
+            benchmark::DoNotOptimize(packet.pdu());
+            ++packets;
+        }
+    }
+
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * std::filesystem::file_size(path)));
+    state.counters["packets"] = benchmark::Counter(
+        static_cast<double>(packets), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_CaptureFileParse)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FileSnifferParse)->Unit(benchmark::kMillisecond);
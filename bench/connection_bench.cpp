@@ -0,0 +1,115 @@
+#include "connection_cache.h"
+#include "connection_source.h"
+
+#include <chrono>         // milliseconds
+#include <cstddef>        // size_t
+#include <cstdint>        // uint32_t
+#include <memory>         // make_unique
+#include <string>         // string
+#include <unordered_map>  // unordered_map
+#include <vector>         // vector
+
+#include <benchmark/benchmark.h>
+
+using gunblade::ConnectionCache;
+using gunblade::ConnectionInfo;
+
+/** @returns A connection table of @p count established IPv4 connections. */
+static std::vector<ConnectionInfo> make_table(std::size_t count)
+{
+    std::vector<ConnectionInfo> table;
+    table.reserve(count);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        table.push_back(ConnectionInfo{
+            Tins::IPv4Address(static_cast<std::uint32_t>(0x0200a8c0)),
+            static_cast<unsigned short>(49152 + (i % 16384)),
+            Tins::IPv4Address(static_cast<std::uint32_t>(0x010071cb + (i / 16384))),
+            static_cast<unsigned short>(55006),
+            gunblade::TcpState::ESTABLISHED,
+            static_cast<unsigned long>(1000 + (i % 64))});
+    }
+
+    return table;
+}
+
+static ConnectionCache make_cache(
+    const std::vector<ConnectionInfo>& table,
+    std::chrono::milliseconds min_refresh_interval = std::chrono::milliseconds(50))
+{
+    return ConnectionCache(
+        std::make_unique<gunblade::StaticConnectionSource>(
+            table, std::unordered_map<unsigned long, std::string>{{1000, "ffxiv_dx11.exe"}}),
+        min_refresh_interval);
+}
+
+/** @brief What every new stream used to do: scan a fresh copy of the whole table. */
+static void BM_ConnectionTableScan(benchmark::State& state)
+{
+    const auto table = make_table(static_cast<std::size_t>(state.range(0)));
+    gunblade::StaticConnectionSource source(table, {});
+    const auto key = gunblade::make_connection_key(table.back()).reversed();
+
+    for (auto _ : state)
+    {
+        unsigned long pid = 0;
+
+        for (const auto& info : source.connections())
+        {
+            const auto candidate = gunblade::make_connection_key(info);
+
+            if (candidate == key || candidate == key.reversed())
+            {
+                pid = info.pid;
+                break;
+            }
+        }
+
+        benchmark::DoNotOptimize(pid);
+    }
+}
+
+/** @brief Looks up streams that are already in the cache, from the capture's point of view. */
+static void BM_ConnectionCacheFind(benchmark::State& state)
+{
+    const auto table = make_table(static_cast<std::size_t>(state.range(0)));
+    auto cache = make_cache(table);
+
+    std::vector<gunblade::ConnectionKey> keys;
+    for (const auto& info : table)
+    {
+        keys.push_back(gunblade::make_connection_key(info).reversed());
+    }
+
+    // Load the table into the cache
+    cache.find(keys.front(), ConnectionCache::clock::now());
+
+    std::size_t i = 0;
+    for (auto _ : state)
+    {
+        const auto lookup = cache.find(keys[i], ConnectionCache::clock::time_point());
+        benchmark::DoNotOptimize(lookup.pid);
+        i = (i + 1) % keys.size();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+/** @brief Re-reads the table for every lookup, as a burst of unknown streams would. */
+static void BM_ConnectionCacheRefresh(benchmark::State& state)
+{
+    const auto table = make_table(static_cast<std::size_t>(state.range(0)));
+    auto cache = make_cache(table, std::chrono::milliseconds(0));
+    const gunblade::ConnectionKey missing{};
+
+    for (auto _ : state)
+    {
+        const auto lookup = cache.find(missing, ConnectionCache::clock::now());
+        benchmark::DoNotOptimize(lookup.status);
+    }
+}
+
+BENCHMARK(BM_ConnectionTableScan)->ArgName("connections")->Range(64, 16384);
+BENCHMARK(BM_ConnectionCacheFind)->ArgName("connections")->Range(64, 16384);
+BENCHMARK(BM_ConnectionCacheRefresh)->ArgName("connections")->Range(64, 16384);
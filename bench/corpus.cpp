@@ -0,0 +1,140 @@
+#include "corpus.h"
+
+#include "ffxiv/magic_scanner.h"
+#include "ffxiv/structs.h"
+
+#include <algorithm>  // sort
+#include <cstring>    // memcpy
+#include <fstream>    // ifstream
+#include <iterator>   // istreambuf_iterator
+#include <random>     // mt19937, uniform_int_distribution
+#include <stdexcept>  // runtime_error
+
+#include <zlib.h>
+
+using namespace gunblade::ffxiv;
+
+template <typename T>
+static void append_raw(std::vector<std::uint8_t>& out, const T& value)
+{
+    const auto* bytes = reinterpret_cast<const std::uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+static std::vector<std::uint8_t> compress(const std::vector<std::uint8_t>& data)
+{
+    auto length = compressBound(static_cast<uLong>(data.size()));
+    std::vector<std::uint8_t> compressed(length);
+
+    if (compress2(compressed.data(), &length, data.data(), static_cast<uLong>(data.size()), 6) !=
+        Z_OK)
+    {
+        throw std::runtime_error("compress2 failed");
+    }
+
+    compressed.resize(length);
+    return compressed;
+}
+
+namespace gunblade::bench
+{
+    std::vector<std::uint8_t> make_bundle(const BundleShape& shape, std::uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<unsigned int> byte(0, 255);
+        std::uniform_int_distribution<unsigned int> percent(0, 99);
+
+        std::vector<std::uint8_t> payload;
+
+        for (std::size_t i = 0; i < shape.segments; ++i)
+        {
+            Segment::Header segment{};
+            segment.size = static_cast<std::uint32_t>(
+                sizeof(Segment::Header) + sizeof(IPC::Header) + shape.ipc_size);
+            segment.source = rng();
+            segment.target = rng();
+            segment.type = SegmentType::IPC;
+
+            IPC::Header ipc{};
+            ipc.magic = 0x0014;
+            ipc.type = static_cast<std::uint16_t>(rng());
+            ipc.server_id = 1;
+            ipc.epoch = 1600000000;
+
+            append_raw(payload, segment);
+            append_raw(payload, ipc);
+
+            for (std::size_t j = 0; j < shape.ipc_size; ++j)
+            {
+                payload.push_back(
+                    percent(rng) < shape.entropy ? static_cast<std::uint8_t>(byte(rng)) : 0);
+            }
+        }
+
+        if (shape.compressed)
+        {
+            payload = compress(payload);
+        }
+
+        Bundle::Header header{};
+        std::memcpy(&header, magic_number.data(), magic_number.size());
+        header.epoch = 1600000000000;
+        header.length = static_cast<std::uint16_t>(sizeof(header) + payload.size());
+        header.message_count = static_cast<std::uint16_t>(shape.segments);
+        header.encoding = 1;
+        header.compression = shape.compressed ? Compression::ZLIB : Compression::NONE;
+
+        if (sizeof(header) + payload.size() > Bundle::max_length)
+        {
+            throw std::runtime_error("Synthetic bundle is too large");
+        }
+
+        std::vector<std::uint8_t> bundle;
+        append_raw(bundle, header);
+        bundle.insert(bundle.end(), payload.begin(), payload.end());
+
+        return bundle;
+    }
+
+    std::vector<std::uint8_t> make_stream(
+        const BundleShape& shape,
+        std::size_t count,
+        std::uint32_t seed)
+    {
+        std::vector<std::uint8_t> stream;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto bundle = make_bundle(shape, seed + static_cast<std::uint32_t>(i));
+            stream.insert(stream.end(), bundle.begin(), bundle.end());
+        }
+
+        return stream;
+    }
+
+    std::vector<CorpusFile> load_corpus(const std::filesystem::path& directory)
+    {
+        std::vector<CorpusFile> corpus;
+
+        for (const auto& entry : std::filesystem::directory_iterator(directory))
+        {
+            if (!entry.is_regular_file())
+            {
+                continue;
+            }
+
+            std::ifstream file(entry.path(), std::ios::binary);
+            corpus.push_back(CorpusFile{
+                entry.path().filename().string(),
+                std::vector<std::uint8_t>(
+                    std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>())});
+        }
+
+        // Keep the benchmark names in a stable order
+        std::sort(corpus.begin(), corpus.end(), [](const auto& a, const auto& b) {
+            return a.name < b.name;
+        });
+
+        return corpus;
+    }
+}  // namespace gunblade::bench
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>     // size_t
+#include <cstdint>     // uint8_t, uint32_t
+#include <filesystem>  // path
+#include <string>      // string
+#include <vector>      // vector
+
+namespace gunblade::bench
+{
+    /** @brief The shape of the synthetic bundles to generate. */
+    struct BundleShape
+    {
+        /** @brief The number of IPC segments in each bundle. */
+        std::size_t segments = 8;
+
+        /** @brief The size of the data in each IPC (after its header). */
+        std::size_t ipc_size = 64;
+
+        /** @brief Whether the bundle payloads are zlib compressed. */
+        bool compressed = true;
+
+        /**
+         * @brief The percentage (0-100) of IPC data bytes that are random.
+         *
+         * The rest are zero, so this controls how well the bundles compress.
+         */
+        unsigned int entropy = 50;
+    };
+
+    /** @returns One complete, encoded bundle (header and payload). */
+    std::vector<std::uint8_t> make_bundle(const BundleShape& shape, std::uint32_t seed = 0);
+
+    /** @returns @p count encoded bundles back to back, as they'd appear in a TCP stream. */
+    std::vector<std::uint8_t> make_stream(
+        const BundleShape& shape,
+        std::size_t count,
+        std::uint32_t seed = 0);
+
+    /** @brief A captured stream, or any other file of bytes to decode. */
+    struct CorpusFile
+    {
+        std::string name;
+        std::vector<std::uint8_t> data;
+    };
+
+    /**
+     * @brief Loads every file in a corpus directory.
+     *
+     * Captured corpora are raw, reassembled TCP payloads of a single flow
+     * direction (such as Wireshark's "Follow TCP Stream" saved as raw data).
+     * Fuzzer corpora work just as well.
+     */
+    std::vector<CorpusFile> load_corpus(const std::filesystem::path& directory);
+
+    /** @brief Registers a decoder benchmark for each file in @p corpus. */
+    void register_decoder_corpus(const std::vector<CorpusFile>& corpus);
+
+    /** @brief Registers a decompress, split and serialize benchmark for each file in @p corpus. */
+    void register_payload_corpus(const std::vector<CorpusFile>& corpus);
+
+    /**
+     * @brief Registers a serialize benchmark over every segment in @p corpus.
+     *
+     * Each file is a segment header followed by its data, as in the segment
+     * fuzzer's corpus.
+     */
+    void register_segment_corpus(const std::vector<CorpusFile>& corpus);
+}  // namespace gunblade::bench
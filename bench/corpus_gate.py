@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""Fails when decoding a corpus gets slower than a saved baseline.
+
+Runs the corpus total benchmarks of gunblade_bench over a corpus (such as the
+decoder fuzzer's), and compares their median throughput to a baseline saved by
+an earlier run with --save.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+
+def measure(bench, corpus, repetitions):
+    """Returns the median bytes per second of each corpus total benchmark."""
+    env = dict(os.environ, GUNBLADE_BENCH_CORPUS=corpus)
+    output = subprocess.run(
+        [
+            bench,
+            "--benchmark_filter=CorpusTotal",
+            f"--benchmark_repetitions={repetitions}",
+            "--benchmark_report_aggregates_only=true",
+            "--benchmark_format=json",
+        ],
+        env=env,
+        check=True,
+        capture_output=True,
+        text=True,
+    ).stdout
+
+    return {
+        result["run_name"]: result["bytes_per_second"]
+        for result in json.loads(output)["benchmarks"]
+        if result.get("aggregate_name") == "median"
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("bench", help="the gunblade_bench executable")
+    parser.add_argument("corpus", help="the corpus directory")
+    parser.add_argument("baseline", help="the baseline JSON file")
+    parser.add_argument("--save", action="store_true", help="save a new baseline instead")
+    parser.add_argument("--tolerance", type=float, default=0.05,
+                        help="the slowdown allowed, as a fraction (default: 0.05)")
+    parser.add_argument("--repetitions", type=int, default=5)
+    args = parser.parse_args()
+
+    results = measure(args.bench, args.corpus, args.repetitions)
+
+    if args.save:
+        with open(args.baseline, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+
+    failed = False
+
+    for name, expected in sorted(baseline.items()):
+        actual = results.get(name)
+
+        if actual is None:
+            print(f"{name}: missing")
+            failed = True
+            continue
+
+        change = actual / expected - 1
+        regressed = change < -args.tolerance
+        failed |= regressed
+
+        print(f"{name}: {actual / 1e6:.1f} MB/s ({change:+.1%}){' REGRESSED' if regressed else ''}")
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
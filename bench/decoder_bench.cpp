@@ -0,0 +1,198 @@
+#include "corpus.h"
+
+#include "ffxiv/decoder.h"
+#include "ffxiv/stream_decoder.h"
+
+#include <algorithm>  // min
+#include <cstddef>    // size_t
+#include <span>       // span
+#include <vector>     // vector
+
+#include <benchmark/benchmark.h>
+
+using gunblade::FinalFantasyDecoder;
+
+static constexpr std::size_t bundles_per_stream = 256;
+
+/**
+ * @brief Feeds a stream to a decoder in chunks of @p fragment bytes,
+ * pulling out every bundle as soon as it's complete.
+ *
+ * @return The number of bundles pulled out.
+ */
+template <bool Owned>
+static std::size_t decode_once(
+    FinalFantasyDecoder& decoder,
+    const std::vector<std::uint8_t>& stream,
+    std::size_t fragment)
+{
+    std::size_t bundles = 0;
+
+    for (std::size_t offset = 0; offset < stream.size(); offset += fragment)
+    {
+        const auto first = stream.begin() + offset;
+        decoder.feed_data(first, first + std::min(fragment, stream.size() - offset));
+
+        if constexpr (Owned)
+        {
+            while (const auto bundle = decoder.next_bundle())
+            {
+                benchmark::DoNotOptimize(bundle->payload.data());
+                ++bundles;
+            }
+        }
+        else
+        {
+            while (const auto bundle = decoder.next_bundle_view())
+            {
+                benchmark::DoNotOptimize(bundle->payload.data());
+                ++bundles;
+            }
+        }
+    }
+
+    decoder.clear();
+    return bundles;
+}
+
+/** @brief Decodes @p stream once per iteration, in chunks of @p fragment bytes. */
+template <bool Owned>
+static void decode_stream(
+    benchmark::State& state,
+    const std::vector<std::uint8_t>& stream,
+    std::size_t fragment)
+{
+    FinalFantasyDecoder decoder;
+    std::size_t bundles = 0;
+
+    for (auto _ : state)
+    {
+        bundles += decode_once<Owned>(decoder, stream, fragment);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * stream.size()));
+    state.counters["bundles"] = benchmark::Counter(
+        static_cast<double>(bundles), benchmark::Counter::kIsRate);
+}
+
+/** @brief Args: IPC size, fragment size. */
+static void BM_DecoderNextBundleView(benchmark::State& state)
+{
+    gunblade::bench::BundleShape shape;
+    shape.ipc_size = static_cast<std::size_t>(state.range(0));
+
+    const auto stream = gunblade::bench::make_stream(shape, bundles_per_stream);
+    decode_stream<false>(state, stream, static_cast<std::size_t>(state.range(1)));
+}
+
+/** @brief Args: IPC size, fragment size. */
+static void BM_DecoderNextBundle(benchmark::State& state)
+{
+    gunblade::bench::BundleShape shape;
+    shape.ipc_size = static_cast<std::size_t>(state.range(0));
+
+    const auto stream = gunblade::bench::make_stream(shape, bundles_per_stream);
+    decode_stream<true>(state, stream, static_cast<std::size_t>(state.range(1)));
+}
+
+/** @brief Args: size of the junk between bundles. */
+static void BM_DecoderResync(benchmark::State& state)
+{
+    gunblade::bench::BundleShape shape;
+    const auto bundle = gunblade::bench::make_bundle(shape);
+
+    // Bundles separated by bytes that never contain a magic number,
+    // so the scanner has to walk over all of them
+    std::vector<std::uint8_t> stream;
+    for (std::size_t i = 0; i < bundles_per_stream; ++i)
+    {
+        stream.insert(stream.end(), static_cast<std::size_t>(state.range(0)), 0xab);
+        stream.insert(stream.end(), bundle.begin(), bundle.end());
+    }
+
+    decode_stream<false>(state, stream, 1460);
+}
+
+/** @brief Decodes whole bundles through the public API. Args: IPC size, entropy. */
+static void BM_StreamDecoder(benchmark::State& state)
+{
+    gunblade::bench::BundleShape shape;
+    shape.ipc_size = static_cast<std::size_t>(state.range(0));
+    shape.entropy = static_cast<unsigned int>(state.range(1));
+
+    const auto stream = gunblade::bench::make_stream(shape, bundles_per_stream);
+    gunblade::ffxiv::StreamDecoder decoder;
+    std::size_t segments = 0;
+
+    for (auto _ : state)
+    {
+        for (std::size_t offset = 0; offset < stream.size(); offset += 1460)
+        {
+            const auto length = std::min<std::size_t>(1460, stream.size() - offset);
+            decoder.push(std::span(stream).subspan(offset, length));
+
+            while (const auto decoded = decoder.pull())
+            {
+                segments += decoded->segments.size();
+            }
+        }
+
+        decoder.reset();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * stream.size()));
+    state.counters["segments"] = benchmark::Counter(
+        static_cast<double>(segments), benchmark::Counter::kIsRate);
+}
+
+// Fragment sizes: a tiny write, a typical Ethernet MSS, and a whole read buffer
+BENCHMARK(BM_DecoderNextBundleView)
+    ->ArgNames({"ipc_size", "fragment"})
+    ->ArgsProduct({{16, 256, 4096}, {64, 1460, 65536}});
+
+BENCHMARK(BM_DecoderNextBundle)
+    ->ArgNames({"ipc_size", "fragment"})
+    ->ArgsProduct({{16, 256, 4096}, {64, 1460, 65536}});
+
+BENCHMARK(BM_StreamDecoder)
+    ->ArgNames({"ipc_size", "entropy"})
+    ->ArgsProduct({{64, 1024}, {0, 50, 100}});
+
+BENCHMARK(BM_DecoderResync)->ArgName("junk")->Arg(64)->Arg(4096);
+
+namespace gunblade::bench
+{
+    void register_decoder_corpus(const std::vector<CorpusFile>& corpus)
+    {
+        std::size_t total_size = 0;
+
+        for (const auto& file : corpus)
+        {
+            total_size += file.data.size();
+
+            benchmark::RegisterBenchmark(
+                ("BM_DecoderCorpus/" + file.name).c_str(),
+                [&file](benchmark::State& state) { decode_stream<false>(state, file.data, 1460); });
+        }
+
+        // Every file in one benchmark, to compare whole corpora (see bench/corpus_gate.py)
+        benchmark::RegisterBenchmark(
+            "BM_DecoderCorpusTotal",
+            [&corpus, total_size](benchmark::State& state) {
+                FinalFantasyDecoder decoder;
+                std::size_t bundles = 0;
+
+                for (auto _ : state)
+                {
+                    for (const auto& file : corpus)
+                    {
+                        bundles += decode_once<false>(decoder, file.data, 1460);
+                    }
+                }
+
+                state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * total_size));
+                state.counters["bundles"] = benchmark::Counter(
+                    static_cast<double>(bundles), benchmark::Counter::kIsRate);
+            });
+    }
+}  // namespace gunblade::bench
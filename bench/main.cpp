@@ -0,0 +1,44 @@
+#include "corpus.h"
+
+#include <cstdlib>     // getenv
+#include <filesystem>  // path
+#include <vector>      // vector
+
+#include <benchmark/benchmark.h>
+
+/**
+ * @brief Runs every benchmark, plus one per file of the captured corpus
+ * in the directory named by the `GUNBLADE_BENCH_CORPUS` environment variable,
+ * plus one over the segments in `GUNBLADE_BENCH_SEGMENT_CORPUS`.
+ */
+int main(int argc, char** argv)
+{
+    // The registered benchmarks refer to the corpus, so it has to outlive them
+    static std::vector<gunblade::bench::CorpusFile> corpus;
+    static std::vector<gunblade::bench::CorpusFile> segment_corpus;
+
+    if (const auto* directory = std::getenv("GUNBLADE_BENCH_CORPUS"))
+    {
+        corpus = gunblade::bench::load_corpus(std::filesystem::path(directory));
+        gunblade::bench::register_decoder_corpus(corpus);
+        gunblade::bench::register_payload_corpus(corpus);
+    }
+
+    if (const auto* directory = std::getenv("GUNBLADE_BENCH_SEGMENT_CORPUS"))
+    {
+        segment_corpus = gunblade::bench::load_corpus(std::filesystem::path(directory));
+        gunblade::bench::register_segment_corpus(segment_corpus);
+    }
+
+    benchmark::Initialize(&argc, argv);
+
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    return 0;
+}
@@ -0,0 +1,308 @@
+#include "corpus.h"
+
+#include "ffxiv/decoder.h"
+#include "ffxiv/inflater.h"
+#include "ffxiv/json_writer.h"
+#include "ffxiv/structs.h"
+
+#include <cstddef>    // size_t
+#include <cstring>    // memcpy
+#include <stdexcept>  // runtime_error
+#include <string>     // string
+#include <vector>     // vector
+
+#include <benchmark/benchmark.h>
+#include <nlohmann/json.hpp>
+
+using namespace gunblade::ffxiv;
+
+static const Connection connection{{"203.0.113.1", 55006}, {"192.168.0.2", 50000}};
+
+/** @returns The bundle described by the benchmark's args: IPC size, entropy. */
+static Bundle make_bundle(const benchmark::State& state, bool compressed = true)
+{
+    gunblade::bench::BundleShape shape;
+    shape.ipc_size = static_cast<std::size_t>(state.range(0));
+    shape.entropy = static_cast<unsigned int>(state.range(1));
+    shape.compressed = compressed;
+
+    const auto bytes = gunblade::bench::make_bundle(shape);
+
+    gunblade::FinalFantasyDecoder decoder;
+    decoder.feed_data(bytes.begin(), bytes.end());
+    return *decoder.next_bundle();
+}
+
+/** @returns Every bundle in a captured stream, leaving out any that are malformed. */
+static std::vector<Bundle> decode_all(const std::vector<std::uint8_t>& stream)
+{
+    gunblade::FinalFantasyDecoder decoder;
+    decoder.feed_data(stream.begin(), stream.end());
+
+    std::vector<Bundle> bundles;
+    while (auto bundle = decoder.next_bundle())
+    {
+        // Fuzzer corpora are mostly malformed bundles, which never get as far as being written
+        try
+        {
+            bundle->segments();
+        }
+        catch (const std::runtime_error&)
+        {
+            continue;
+        }
+
+        bundles.push_back(std::move(*bundle));
+    }
+
+    return bundles;
+}
+
+/** @brief Decompresses, splits and serializes @p bundles, as a flow does once they're decoded. */
+static void write_bundles(benchmark::State& state, const std::vector<Bundle>& bundles)
+{
+    Inflater inflater;
+    std::string records;
+    std::size_t written = 0;
+
+    for (auto _ : state)
+    {
+        for (const auto& bundle : bundles)
+        {
+            const auto view = bundle.view();
+            const auto segments = view.segments(view.decompressed_payload(inflater));
+            write_json_line(records, connection, 1234, view, segments);
+        }
+
+        written += records.size();
+        records.clear();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(written));
+}
+
+static void set_compression_ratio(benchmark::State& state, const Bundle& bundle)
+{
+    state.counters["ratio"] = static_cast<double>(bundle.decompressed_payload().size()) /
+                              static_cast<double>(bundle.payload.size());
+}
+
+static void BM_InflaterDecompress(benchmark::State& state)
+{
+    const auto bundle = make_bundle(state);
+    const auto view = bundle.view();
+    Inflater inflater;
+
+    std::size_t decompressed = 0;
+    for (auto _ : state)
+    {
+        const auto payload = view.decompressed_payload(inflater);
+        benchmark::DoNotOptimize(payload.data());
+        decompressed += payload.size();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(decompressed));
+    set_compression_ratio(state, bundle);
+}
+
+static void BM_BundleDecompress(benchmark::State& state)
+{
+    const auto bundle = make_bundle(state);
+
+    std::size_t decompressed = 0;
+    for (auto _ : state)
+    {
+        const auto payload = bundle.decompressed_payload();
+        benchmark::DoNotOptimize(payload.data());
+        decompressed += payload.size();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(decompressed));
+    set_compression_ratio(state, bundle);
+}
+
+static void BM_BundleViewSegments(benchmark::State& state)
+{
+    const auto bundle = make_bundle(state, false);
+    const auto view = bundle.view();
+
+    for (auto _ : state)
+    {
+        const auto segments = view.segments(view.payload);
+        benchmark::DoNotOptimize(segments.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * bundle.header.message_count);
+}
+
+static void BM_BundleViewSegmentsView(benchmark::State& state)
+{
+    const auto bundle = make_bundle(state, false);
+    const auto view = bundle.view();
+
+    for (auto _ : state)
+    {
+        for (const auto& segment : view.segments_view(view.payload))
+        {
+            benchmark::DoNotOptimize(segment.data.data());
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * bundle.header.message_count);
+}
+
+static void BM_BundleSegments(benchmark::State& state)
+{
+    const auto bundle = make_bundle(state, false);
+
+    for (auto _ : state)
+    {
+        const auto segments = bundle.segments();
+        benchmark::DoNotOptimize(segments.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * bundle.header.message_count);
+}
+
+/** @brief The original serialization: build a DOM with `to_json`, then dump it. */
+static void BM_ToJson(benchmark::State& state)
+{
+    const auto bundle = make_bundle(state, false);
+
+    std::size_t written = 0;
+    for (auto _ : state)
+    {
+        // clang-format off
+        const nlohmann::json j = {
+            {"connection", {
+                {"source", {
+                    {"host", connection.source.host},
+                    {"port", connection.source.port}
+                }},
+                {"destination", {
+                    {"host", connection.destination.host},
+                    {"port", connection.destination.port}
+                }},
+            }},
+            {"processId", 1234},
+            {"bundle", bundle}
+        };
+        // clang-format on
+
+        const auto line = j.dump();
+        benchmark::DoNotOptimize(line.data());
+        written += line.size();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(written));
+}
+
+static void BM_WriteJsonLine(benchmark::State& state)
+{
+    const auto bundle = make_bundle(state, false);
+    const auto view = bundle.view();
+    const auto segments = view.segments(view.payload);
+
+    std::string line;
+    std::size_t written = 0;
+    for (auto _ : state)
+    {
+        line.clear();
+        write_json_line(line, connection, 1234, view, segments);
+        benchmark::DoNotOptimize(line.data());
+        written += line.size();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(written));
+}
+
+// Args: IPC size, percentage of random bytes (lower compresses better)
+BENCHMARK(BM_InflaterDecompress)
+    ->ArgNames({"ipc_size", "entropy"})
+    ->ArgsProduct({{64, 512, 4096}, {0, 50, 100}});
+
+BENCHMARK(BM_BundleDecompress)
+    ->ArgNames({"ipc_size", "entropy"})
+    ->ArgsProduct({{64, 512, 4096}, {0, 50, 100}});
+
+BENCHMARK(BM_BundleViewSegments)->ArgNames({"ipc_size", "entropy"})->Args({64, 50});
+BENCHMARK(BM_BundleViewSegmentsView)->ArgNames({"ipc_size", "entropy"})->Args({64, 50});
+BENCHMARK(BM_BundleSegments)->ArgNames({"ipc_size", "entropy"})->Args({64, 50});
+
+BENCHMARK(BM_ToJson)->ArgNames({"ipc_size", "entropy"})->Args({64, 50})->Args({4096, 50});
+BENCHMARK(BM_WriteJsonLine)->ArgNames({"ipc_size", "entropy"})->Args({64, 50})->Args({4096, 50});
+
+namespace gunblade::bench
+{
+    void register_payload_corpus(const std::vector<CorpusFile>& corpus)
+    {
+        std::vector<Bundle> all;
+
+        for (const auto& file : corpus)
+        {
+            auto bundles = decode_all(file.data);
+            all.insert(all.end(), bundles.begin(), bundles.end());
+
+            benchmark::RegisterBenchmark(
+                ("BM_PayloadCorpus/" + file.name).c_str(),
+                [bundles = std::move(bundles)](benchmark::State& state) {
+                    write_bundles(state, bundles);
+                });
+        }
+
+        benchmark::RegisterBenchmark(
+            "BM_PayloadCorpusTotal",
+            [all = std::move(all)](benchmark::State& state) { write_bundles(state, all); });
+    }
+
+    void register_segment_corpus(const std::vector<CorpusFile>& corpus)
+    {
+        std::vector<Segment> segments;
+
+        for (const auto& file : corpus)
+        {
+            if (file.data.size() < sizeof(Segment::Header))
+            {
+                continue;
+            }
+
+            Segment segment;
+            std::memcpy(&segment.header, file.data.data(), sizeof(segment.header));
+            segment.data.assign(file.data.begin() + sizeof(segment.header), file.data.end());
+
+            // Leave out the segments that are too short for their type
+            try
+            {
+                nlohmann::json j = segment;
+            }
+            catch (const std::runtime_error&)
+            {
+                continue;
+            }
+
+            segments.push_back(std::move(segment));
+        }
+
+        benchmark::RegisterBenchmark(
+            "BM_SegmentCorpusTotal",
+            [segments = std::move(segments)](benchmark::State& state) {
+                const BundleView bundle{Bundle::Header{}, {}};
+                std::string records;
+                std::size_t written = 0;
+
+                for (auto _ : state)
+                {
+                    for (const auto& segment : segments)
+                    {
+                        const auto view = segment.view();
+                        write_json_line(records, connection, 1234, bundle, {&view, 1});
+                    }
+
+                    written += records.size();
+                    records.clear();
+                }
+
+                state.SetBytesProcessed(static_cast<int64_t>(written));
+            });
+    }
+}  // namespace gunblade::bench
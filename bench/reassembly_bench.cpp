@@ -0,0 +1,235 @@
+#include "packet_parser.h"
+#include "tcp_reassembler.h"
+
+#include <chrono>   // microseconds
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t, uint32_t
+#include <memory>   // make_unique, unique_ptr
+#include <span>     // span
+#include <utility>  // swap
+#include <vector>   // vector
+
+#include <benchmark/benchmark.h>
+#include <tins/tins.h>
+#include <tins/tcp_ip/stream_follower.h>
+
+static constexpr std::size_t connections = 16;
+static constexpr std::size_t segments_per_connection = 4096;
+static constexpr std::size_t segment_size = 1200;
+
+static constexpr std::uint8_t tcp_syn = 0x02;
+static constexpr std::uint8_t tcp_psh_ack = 0x18;
+static constexpr std::uint8_t tcp_syn_ack = 0x12;
+
+static void append_be16(std::vector<std::uint8_t>& out, unsigned int value)
+{
+    out.push_back(static_cast<std::uint8_t>(value >> 8));
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+static void append_be32(std::vector<std::uint8_t>& out, std::uint32_t value)
+{
+    append_be16(out, value >> 16);
+    append_be16(out, value & 0xffff);
+}
+
+/** @returns A raw IPv4 packet carrying a TCP segment with @p payload bytes. */
+static std::vector<std::uint8_t> make_packet(
+    std::size_t connection,
+    bool from_server,
+    std::uint32_t seq,
+    std::uint8_t flags,
+    std::size_t payload)
+{
+    const std::uint8_t client[] = {10, 0, 0, 1};
+    const std::uint8_t server[] = {10, 0, 1, static_cast<std::uint8_t>(connection)};
+    const auto client_port = static_cast<unsigned int>(49152 + connection);
+
+    std::vector<std::uint8_t> packet = {0x45, 0};
+    append_be16(packet, static_cast<unsigned int>(20 + 20 + payload));
+    packet.insert(packet.end(), {0, 1, 0x40, 0, 64, 6, 0, 0});
+    packet.insert(packet.end(), from_server ? server : client, (from_server ? server : client) + 4);
+    packet.insert(packet.end(), from_server ? client : server, (from_server ? client : server) + 4);
+
+    append_be16(packet, from_server ? 55000 : client_port);
+    append_be16(packet, from_server ? client_port : 55000);
+    append_be32(packet, seq);
+    append_be32(packet, 1);
+    packet.insert(packet.end(), {0x50, flags, 0xff, 0xff, 0, 0, 0, 0});
+
+    packet.resize(40 + payload, 'x');
+    return packet;
+}
+
+/**
+ * @returns Connections' handshakes, then their data from the server, interleaved.
+ * When @p reorder is set, one segment in every 16 arrives after the one behind it.
+ */
+static std::vector<std::vector<std::uint8_t>> make_packets(bool reorder)
+{
+    std::vector<std::vector<std::uint8_t>> packets;
+
+    for (std::size_t connection = 0; connection < connections; ++connection)
+    {
+        packets.push_back(make_packet(connection, false, 0, tcp_syn, 0));
+        packets.push_back(make_packet(connection, true, 0, tcp_syn_ack, 0));
+    }
+
+    for (std::size_t segment = 0; segment < segments_per_connection; ++segment)
+    {
+        for (std::size_t connection = 0; connection < connections; ++connection)
+        {
+            const auto seq = static_cast<std::uint32_t>(1 + segment * segment_size);
+            packets.push_back(make_packet(connection, true, seq, tcp_psh_ack, segment_size));
+        }
+
+        // Swap this round's packets with the last round's, so every connection reorders
+        if (reorder && segment % 16 == 15)
+        {
+            const auto end = packets.size();
+
+            for (std::size_t i = end - connections; i < end; ++i)
+            {
+                std::swap(packets[i], packets[i - connections]);
+            }
+        }
+    }
+
+    return packets;
+}
+
+static const std::vector<std::vector<std::uint8_t>>& packets(bool reorder)
+{
+    static const auto in_order = make_packets(false);
+    static const auto reordered = make_packets(true);
+
+    return reorder ? reordered : in_order;
+}
+
+static void set_counters(benchmark::State& state, std::size_t bytes)
+{
+    const auto expected = connections * segments_per_connection * segment_size;
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * expected));
+    state.counters["complete"] = static_cast<double>(bytes) /
+                                 static_cast<double>(state.iterations() * expected);
+}
+
+/** @brief What replays do now: parse each packet with libtins, and follow it with libtins. */
+static void BM_StreamFollower(benchmark::State& state)
+{
+    const auto& input = packets(state.range(0) != 0);
+    std::size_t bytes = 0;
+
+    for (auto _ : state)
+    {
+        Tins::TCPIP::StreamFollower follower;
+        follower.follow_partial_streams(true);
+        follower.new_stream_callback([&bytes](Tins::TCPIP::Stream& stream) {
+            stream.server_data_callback([&bytes](Tins::TCPIP::Stream& stream) {
+                bytes += stream.server_flow().payload().size();
+                stream.server_flow().payload().clear();
+            });
+        });
+
+        for (const auto& packet : input)
+        {
+            Tins::IP ip(packet.data(), static_cast<std::uint32_t>(packet.size()));
+            follower.process_packet(ip);
+        }
+    }
+
+    set_counters(state, bytes);
+}
+
+/** @brief Counts the bytes that the server sends. */
+class CountingHandler final : public gunblade::TcpStreamHandler
+{
+public:
+    explicit CountingHandler(std::size_t& bytes) : bytes_(bytes)
+    {
+        // Do nothing
+    }
+
+    bool on_data(bool from_client, std::span<const std::uint8_t> data) override
+    {
+        if (!from_client)
+        {
+            benchmark::DoNotOptimize(data.data());
+            bytes_ += data.size();
+        }
+
+        return true;
+    }
+
+private:
+    std::size_t& bytes_;
+};
+
+/** @brief Parse each packet in place, and follow it with `TcpReassembler`. */
+static void BM_TcpReassembler(benchmark::State& state)
+{
+    const auto& input = packets(state.range(0) != 0);
+    std::size_t bytes = 0;
+
+    for (auto _ : state)
+    {
+        gunblade::TcpReassembler reassembler;
+        reassembler.new_stream_callback([&bytes](const gunblade::TcpEndpoints&) {
+            return std::make_unique<CountingHandler>(bytes);
+        });
+
+        for (const auto& packet : input)
+        {
+            if (const auto parsed = gunblade::parse_tcp_packet(gunblade::link_type::raw, packet))
+            {
+                reassembler.process(*parsed, std::chrono::microseconds(0));
+            }
+        }
+    }
+
+    set_counters(state, bytes);
+}
+
+/** @brief Like `BM_TcpReassembler`, but hands packets over in batches of `batch`. */
+static void BM_TcpReassemblerBatch(benchmark::State& state)
+{
+    const auto& input = packets(state.range(0) != 0);
+    const auto batch_size = static_cast<std::size_t>(state.range(1));
+    std::vector<gunblade::CapturedPacket> batch;
+    std::size_t bytes = 0;
+
+    for (auto _ : state)
+    {
+        gunblade::TcpReassembler reassembler;
+        reassembler.new_stream_callback([&bytes](const gunblade::TcpEndpoints&) {
+            return std::make_unique<CountingHandler>(bytes);
+        });
+
+        for (const auto& packet : input)
+        {
+            if (const auto parsed = gunblade::parse_tcp_packet(gunblade::link_type::raw, packet))
+            {
+                batch.push_back(gunblade::CapturedPacket{std::chrono::microseconds(0), *parsed});
+            }
+
+            if (batch.size() == batch_size)
+            {
+                reassembler.process(batch);
+                batch.clear();
+            }
+        }
+
+        reassembler.process(batch);
+        batch.clear();
+    }
+
+    set_counters(state, bytes);
+}
+
+BENCHMARK(BM_StreamFollower)->ArgName("reorder")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TcpReassembler)->ArgName("reorder")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TcpReassemblerBatch)
+    ->ArgNames({"reorder", "batch"})
+    ->ArgsProduct({{0, 1}, {1, 64, 256}})
+    ->Unit(benchmark::kMillisecond);
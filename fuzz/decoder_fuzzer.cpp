@@ -0,0 +1,82 @@
+#include "ffxiv/decoder.h"
+#include "ffxiv/inflater.h"
+#include "ffxiv/json_writer.h"
+#include "ffxiv/structs.h"
+
+#include <algorithm>  // min
+#include <cstddef>    // size_t
+#include <cstdint>    // uint8_t, uint32_t
+#include <cstdlib>    // abort
+#include <stdexcept>  // runtime_error
+#include <string>     // string
+#include <vector>     // vector
+
+using namespace gunblade::ffxiv;
+
+static const Connection connection{{"203.0.113.1", 55006}, {"192.168.0.2", 50000}};
+
+/** @returns The size of the next fragment to feed, from 1 to 2048 bytes (xorshift32). */
+static std::size_t next_fragment(std::uint32_t& state) noexcept
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return 1 + (state % 2048);
+}
+
+/**
+ * @brief Feeds a stream to `FinalFantasyDecoder` in fragments, and decodes,
+ * splits and serializes every bundle that comes out of it.
+ *
+ * The input is the stream itself, so the corpus doubles as a corpus of streams
+ * for `gunblade_bench`. How it's fragmented is seeded by its last byte, so
+ * every input is always split up the same way.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+    gunblade::FinalFantasyDecoder decoder;
+    Inflater inflater;
+    std::vector<SegmentView> segments;
+    std::string line;
+
+    std::uint32_t state = 0x9e3779b9u ^ (size > 0 ? data[size - 1] : 0);
+
+    for (std::size_t offset = 0; offset < size;)
+    {
+        const auto length = std::min(next_fragment(state), size - offset);
+        decoder.feed_data(data + offset, data + offset + length);
+        offset += length;
+
+        while (const auto bundle = decoder.next_bundle_view())
+        {
+            // A bundle must be exactly as long as its header says, header included
+            if (bundle->header.length < sizeof(Bundle::Header) ||
+                bundle->payload.size() != bundle->header.payload_length())
+            {
+                std::abort();
+            }
+
+            try
+            {
+                const auto range = bundle->segments_view(bundle->decompressed_payload(inflater));
+                segments.assign(range.begin(), range.end());
+
+                line.clear();
+                write_json_line(line, connection, 0, *bundle, segments);
+            }
+            catch (const std::runtime_error&)
+            {
+                // Malformed bundles are rejected, which is all that's asked of them
+            }
+        }
+
+        // Just like a flow over its buffer limit, give up on a bundle that can't complete
+        if (decoder.size() > Bundle::max_length)
+        {
+            decoder.resync();
+        }
+    }
+
+    return 0;
+}
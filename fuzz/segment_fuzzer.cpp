@@ -0,0 +1,81 @@
+#include "ffxiv/json_writer.h"
+#include "ffxiv/structs.h"
+
+#include <cstddef>    // size_t
+#include <cstdint>    // uint8_t
+#include <cstdlib>    // abort
+#include <cstring>    // memcpy
+#include <span>       // span
+#include <stdexcept>  // runtime_error
+#include <string>     // string
+
+#include <nlohmann/json.hpp>
+
+using namespace gunblade::ffxiv;
+
+static const Connection connection{{"203.0.113.1", 55006}, {"192.168.0.2", 50000}};
+
+/**
+ * @brief Serializes a segment with `to_json`, and checks that `write_json_line`
+ * writes exactly what `nlohmann::json::dump()` does for the same record.
+ *
+ * The input is a segment header followed by the segment's data. The header's
+ * size is left as it is, so it needn't match the data.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+    if (size < sizeof(Segment::Header))
+    {
+        return 0;
+    }
+
+    Segment segment;
+    std::memcpy(&segment.header, data, sizeof(segment.header));
+    segment.data.assign(data + sizeof(segment.header), data + size);
+
+    nlohmann::json j;
+
+    try
+    {
+        to_json(j, segment);
+    }
+    catch (const std::runtime_error&)
+    {
+        // Too short for its type, which is all that's asked of it
+        return 0;
+    }
+
+    Bundle::Header header{};
+    header.epoch = 1234;
+
+    const auto view = segment.view();
+    std::string line;
+    write_json_line(line, connection, 0, BundleView{header, {}}, std::span(&view, 1));
+
+    // clang-format off
+    const nlohmann::json record = {
+        {"connection", {
+            {"source", {
+                {"host", connection.source.host},
+                {"port", connection.source.port}
+            }},
+            {"destination", {
+                {"host", connection.destination.host},
+                {"port", connection.destination.port}
+            }},
+        }},
+        {"processId", 0},
+        {"bundle", {
+            {"epoch", header.epoch},
+            {"segments", nlohmann::json::array({j})}
+        }}
+    };
+    // clang-format on
+
+    if (line != record.dump() + "\n")
+    {
+        std::abort();
+    }
+
+    return 0;
+}
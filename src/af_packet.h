@@ -0,0 +1,151 @@
+#pragma once
+
+#include "capture_filter.h"
+#include "packet_parser.h"
+#include "pipeline.h"
+
+#include <chrono>    // milliseconds
+#include <cstddef>   // size_t
+#include <cstdint>   // uint8_t, uint16_t, uint32_t, uint64_t
+#include <memory>    // shared_ptr
+#include <optional>  // optional
+#include <span>      // span
+#include <string>    // string
+#include <vector>    // vector
+
+namespace gunblade
+{
+    struct AfPacketOptions
+    {
+        /** @brief The network interface to capture on. */
+        std::string interface;
+
+        /**
+         * @brief The fanout group that the socket joins, if any. Sockets in the same
+         * group split the interface's packets between them by flow.
+         */
+        std::optional<std::uint16_t> fanout_group;
+
+        /** @brief The size of each block of the ring. Must be a multiple of the page size. */
+        std::size_t block_size = 1024 * 1024;
+
+        /** @brief The number of blocks in the ring. */
+        std::size_t block_count = 32;
+
+        /**
+         * @brief The longest that the kernel fills a block before handing it over,
+         * however empty it is. This bounds the latency added by batching.
+         */
+        std::chrono::milliseconds block_timeout = std::chrono::milliseconds(5);
+    };
+
+    /**
+     * @brief Captures packets from a Linux `AF_PACKET` socket, through a
+     * `TPACKET_V3` ring that's shared with the kernel.
+     *
+     * The kernel fills whole blocks of packets at a time, and each block is
+     * parsed in place and handed over as one batch, so there's no system call
+     * or copy per packet. Several sockets on the same interface and in the same
+     * fanout group split its packets between them by a symmetric flow hash, so
+     * that both directions of a connection always go to the same socket, and
+     * each socket can be read by its own worker.
+     *
+     * Only Linux is supported. Must only be used from one thread, except for `stats()`.
+     */
+    class AfPacketSocket final : public PacketSource
+    {
+    public:
+        /** @brief The counters kept by the kernel, since the socket was opened. */
+        struct Stats
+        {
+            /** @brief Packets that passed the filter, including those dropped. */
+            std::uint64_t received = 0;
+
+            /** @brief Packets dropped because the ring was full. */
+            std::uint64_t dropped = 0;
+        };
+
+        /**
+         * @brief Opens a socket, starting out with `base_capture_filter`.
+         *
+         * @throws std::runtime_error If the socket can't be opened, which usually
+         * means that the process doesn't have `CAP_NET_RAW`.
+         */
+        explicit AfPacketSocket(const AfPacketOptions& options);
+
+        AfPacketSocket(const AfPacketSocket&) = delete;
+        AfPacketSocket& operator=(const AfPacketSocket&) = delete;
+
+        ~AfPacketSocket() override;
+
+        /** @brief Narrows the filter down to FFXIV's connections, as they come and go. */
+        void narrow_filter(std::shared_ptr<ConnectionCache> connections);
+
+        /**
+         * @brief Hands the last block back to the kernel, then waits for the next one.
+         *
+         * @return The TCP packets in the block, or nothing if no block was filled in time.
+         */
+        std::span<const CapturedPacket> next_batch(std::chrono::milliseconds timeout) override;
+
+        /**
+         * @brief Swaps the socket's filter.
+         *
+         * @param expression A libpcap filter expression
+         * @return Whether the filter was valid, and set.
+         */
+        bool set_filter(const std::string& expression);
+
+        /** @returns The kernel's counters. May be called from any one thread at a time. */
+        Stats stats();
+
+        /** @returns A fanout group that no other process is likely to be using. */
+        static std::uint16_t default_fanout_group() noexcept;
+
+    private:
+        /** @brief Sets up the ring, the filter and the fanout, then starts capturing. */
+        void open(const AfPacketOptions& options);
+
+        /** @brief Unmaps the ring and closes the socket. */
+        void close() noexcept;
+
+        /** @brief Hands the block being read back to the kernel, if there is one. */
+        void release_block() noexcept;
+
+        /** @brief Parses the TCP packets out of the block being read. */
+        void read_block();
+
+        /** @returns The libpcap link-layer header type (`DLT_` value) of the interface. */
+        int dlt() const noexcept;
+
+        /** @brief Swaps the socket's filter for one that's already compiled. */
+        bool attach(const CompiledFilter& compiled);
+
+        int fd_ = -1;
+
+        /** @brief The link-layer header type of the interface (see `link_type`). */
+        std::uint32_t link_type_ = link_type::ethernet;
+
+        /**
+         * @brief Whether packets that the host sends are skipped. On loopback, every
+         * packet is seen twice, once going out and once coming back in.
+         */
+        bool skip_outgoing_ = false;
+
+        std::uint8_t* ring_ = nullptr;
+        std::size_t block_size_ = 0;
+        std::size_t block_count_ = 0;
+
+        /** @brief The next block to be filled by the kernel. */
+        std::size_t block_ = 0;
+
+        /** @brief Whether the current block has been read, and not yet handed back. */
+        bool holding_block_ = false;
+
+        std::vector<CapturedPacket> packets_;
+        std::optional<CaptureFilter> filter_;
+
+        /** @brief The kernel's counters, which it resets each time they're read. */
+        Stats stats_;
+    };
+}  // namespace gunblade
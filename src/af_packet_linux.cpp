@@ -0,0 +1,371 @@
+#include "af_packet.h"
+
+#include <atomic>     // atomic_ref
+#include <cerrno>     // errno
+#include <chrono>     // duration_cast, microseconds, nanoseconds, seconds
+#include <cstring>    // strerror
+#include <stdexcept>  // invalid_argument, runtime_error
+#include <utility>    // move
+
+#include <fmt/format.h>  // format
+
+#include <arpa/inet.h>  // htons
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <pcap/pcap.h>
+
+/** @brief The hardware type of interfaces that carry raw IP. Not in glibc's <net/if_arp.h>. */
+static constexpr unsigned short arphrd_rawip = 519;
+
+/** @brief Has a fanout group ignore outgoing packets, since Linux 6.9. Not in older headers. */
+static constexpr int fanout_flag_ignore_outgoing = 0x4000;
+
+/**
+ * @brief The nominal size of each frame in a block. Frames are packed as tightly
+ * as they fit in `TPACKET_V3`, but the kernel still checks this.
+ */
+static constexpr unsigned int frame_size = 2048;
+
+[[noreturn]] static void throw_errno(const std::string& what)
+{
+    throw std::runtime_error(fmt::format("{}: {}", what, std::strerror(errno)));
+}
+
+/** @returns The link-layer header type of the interface named @p interface. */
+static std::uint32_t interface_link_type(int fd, const std::string& interface)
+{
+    ifreq request{};
+    interface.copy(request.ifr_name, IFNAMSIZ - 1);
+
+    if (ioctl(fd, SIOCGIFHWADDR, &request) != 0)
+    {
+        throw_errno(fmt::format("Unable to look up interface {}", interface));
+    }
+
+    switch (request.ifr_hwaddr.sa_family)
+    {
+        // Loopback frames have an Ethernet header too, with zeroed addresses
+        case ARPHRD_ETHER:
+        case ARPHRD_LOOPBACK:
+            return gunblade::link_type::ethernet;
+
+        case ARPHRD_NONE:
+        case arphrd_rawip:
+            return gunblade::link_type::raw;
+
+        default:
+            throw std::runtime_error(
+                fmt::format("Unsupported link-layer type on interface {}", interface));
+    }
+}
+
+/** @returns Whether the interface named @p interface is a loopback interface. */
+static bool is_loopback(int fd, const std::string& interface)
+{
+    ifreq request{};
+    interface.copy(request.ifr_name, IFNAMSIZ - 1);
+
+    if (ioctl(fd, SIOCGIFFLAGS, &request) != 0)
+    {
+        throw_errno(fmt::format("Unable to look up interface {}", interface));
+    }
+
+    return (request.ifr_flags & IFF_LOOPBACK) != 0;
+}
+
+/** @returns The status word of the block at @p index, which is shared with the kernel. */
+static std::atomic_ref<std::uint32_t> block_status(
+    std::uint8_t* ring,
+    std::size_t block_size,
+    std::size_t index) noexcept
+{
+    auto* block = reinterpret_cast<tpacket_block_desc*>(ring + index * block_size);
+    return std::atomic_ref<std::uint32_t>(block->hdr.bh1.block_status);
+}
+
+namespace gunblade
+{
+    AfPacketSocket::AfPacketSocket(const AfPacketOptions& options)
+    {
+        try
+        {
+            open(options);
+        }
+        catch (...)
+        {
+            close();
+            throw;
+        }
+    }
+
+    AfPacketSocket::~AfPacketSocket()
+    {
+        close();
+    }
+
+    void AfPacketSocket::open(const AfPacketOptions& options)
+    {
+        // No protocol yet, so that nothing is captured until the socket is bound
+        fd_ = socket(AF_PACKET, SOCK_RAW, 0);
+
+        if (fd_ < 0)
+        {
+            throw_errno("Unable to open an AF_PACKET socket");
+        }
+
+        link_type_ = interface_link_type(fd_, options.interface);
+        skip_outgoing_ = is_loopback(fd_, options.interface);
+
+#ifdef PACKET_IGNORE_OUTGOING
+        // Have the kernel drop loopback's outgoing copies before they're even counted.
+        // Older kernels don't support this, so they're skipped in read_block() instead.
+        const int ignore_outgoing = 1;
+
+        if (skip_outgoing_)
+        {
+            setsockopt(
+                fd_,
+                SOL_PACKET,
+                PACKET_IGNORE_OUTGOING,
+                &ignore_outgoing,
+                sizeof(ignore_outgoing));
+        }
+#endif
+
+        const int version = TPACKET_V3;
+
+        if (setsockopt(fd_, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0)
+        {
+            throw_errno("Unable to use TPACKET_V3");
+        }
+
+        block_size_ = options.block_size;
+        block_count_ = options.block_count;
+
+        tpacket_req3 request{};
+        request.tp_block_size = static_cast<unsigned int>(block_size_);
+        request.tp_block_nr = static_cast<unsigned int>(block_count_);
+        request.tp_frame_size = frame_size;
+        request.tp_frame_nr = static_cast<unsigned int>(block_size_ / frame_size * block_count_);
+        request.tp_retire_blk_tov = static_cast<unsigned int>(options.block_timeout.count());
+
+        if (setsockopt(fd_, SOL_PACKET, PACKET_RX_RING, &request, sizeof(request)) != 0)
+        {
+            throw_errno("Unable to set up the capture ring");
+        }
+
+        void* ring = mmap(
+            nullptr,
+            block_size_ * block_count_,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED,
+            fd_,
+            0);
+
+        if (ring == MAP_FAILED)
+        {
+            throw_errno("Unable to map the capture ring");
+        }
+
+        ring_ = static_cast<std::uint8_t*>(ring);
+
+        if (!set_filter(base_capture_filter))
+        {
+            throw std::runtime_error("Unable to set the capture filter");
+        }
+
+        sockaddr_ll address{};
+        address.sll_family = AF_PACKET;
+        address.sll_protocol = htons(ETH_P_ALL);
+        address.sll_ifindex = static_cast<int>(if_nametoindex(options.interface.c_str()));
+
+        if (address.sll_ifindex == 0 ||
+            bind(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            throw_errno(fmt::format("Unable to capture on interface {}", options.interface));
+        }
+
+        if (options.fanout_group)
+        {
+            // The hash is symmetric, and fragments are put back together before hashing
+            int flags = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+
+            // The group captures in place of the socket, so it has to ignore outgoing packets too
+            if (skip_outgoing_)
+            {
+                flags |= fanout_flag_ignore_outgoing;
+            }
+
+            int fanout = *options.fanout_group | (flags << 16);
+            int joined = setsockopt(fd_, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout));
+
+            // Older kernels don't know the flag, and refuse it
+            if (joined != 0 && errno == EINVAL && skip_outgoing_)
+            {
+                fanout &= ~(fanout_flag_ignore_outgoing << 16);
+                joined = setsockopt(fd_, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout));
+            }
+
+            if (joined != 0)
+            {
+                throw_errno(fmt::format("Unable to join fanout group {}", *options.fanout_group));
+            }
+        }
+    }
+
+    void AfPacketSocket::close() noexcept
+    {
+        if (ring_ != nullptr)
+        {
+            munmap(ring_, block_size_ * block_count_);
+            ring_ = nullptr;
+        }
+
+        if (fd_ >= 0)
+        {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    void AfPacketSocket::narrow_filter(std::shared_ptr<ConnectionCache> connections)
+    {
+        filter_.emplace(std::move(connections), dlt());
+    }
+
+    std::span<const CapturedPacket> AfPacketSocket::next_batch(std::chrono::milliseconds timeout)
+    {
+        release_block();
+        packets_.clear();
+
+        auto status = block_status(ring_, block_size_, block_);
+
+        if ((status.load(std::memory_order_acquire) & TP_STATUS_USER) == 0)
+        {
+            pollfd descriptor{fd_, POLLIN | POLLERR, 0};
+            poll(&descriptor, 1, static_cast<int>(timeout.count()));
+        }
+
+        if ((status.load(std::memory_order_acquire) & TP_STATUS_USER) != 0)
+        {
+            read_block();
+        }
+
+        if (filter_)
+        {
+            filter_->update([this](const CompiledFilter& filter) { return attach(filter); });
+        }
+
+        return packets_;
+    }
+
+    bool AfPacketSocket::set_filter(const std::string& expression)
+    {
+        try
+        {
+            return attach(CompiledFilter(expression, dlt()));
+        }
+        catch (const std::invalid_argument&)
+        {
+            return false;
+        }
+    }
+
+    int AfPacketSocket::dlt() const noexcept
+    {
+        return link_type_ == link_type::raw ? DLT_RAW : DLT_EN10MB;
+    }
+
+    bool AfPacketSocket::attach(const CompiledFilter& compiled)
+    {
+        sock_fprog filter{};
+        filter.len = static_cast<unsigned short>(compiled.program()->bf_len);
+        filter.filter = reinterpret_cast<sock_filter*>(compiled.program()->bf_insns);
+
+        // The new filter replaces the old one in a single step, so nothing slips through
+        return setsockopt(fd_, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter)) == 0;
+    }
+
+    AfPacketSocket::Stats AfPacketSocket::stats()
+    {
+        tpacket_stats_v3 kernel{};
+        socklen_t size = sizeof(kernel);
+
+        if (getsockopt(fd_, SOL_PACKET, PACKET_STATISTICS, &kernel, &size) == 0)
+        {
+            stats_.received += kernel.tp_packets;
+            stats_.dropped += kernel.tp_drops;
+        }
+
+        return stats_;
+    }
+
+    std::uint16_t AfPacketSocket::default_fanout_group() noexcept
+    {
+        return static_cast<std::uint16_t>(getpid());
+    }
+
+    void AfPacketSocket::release_block() noexcept
+    {
+        if (!holding_block_)
+        {
+            return;
+        }
+
+        block_status(ring_, block_size_, block_).store(TP_STATUS_KERNEL, std::memory_order_release);
+        block_ = (block_ + 1) % block_count_;
+        holding_block_ = false;
+    }
+
+    void AfPacketSocket::read_block()
+    {
+        const auto* block = ring_ + block_ * block_size_;
+        const auto& header = reinterpret_cast<const tpacket_block_desc*>(block)->hdr.bh1;
+        const auto* frame = block + header.offset_to_first_pkt;
+
+        holding_block_ = true;
+
+        for (std::uint32_t i = 0; i < header.num_pkts; ++i)
+        {
+            const auto& frame_header = *reinterpret_cast<const tpacket3_hdr*>(frame);
+            const auto& link = *reinterpret_cast<const sockaddr_ll*>(
+                frame + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+
+            if (skip_outgoing_ && link.sll_pkttype == PACKET_OUTGOING)
+            {
+                frame += frame_header.tp_next_offset;
+                continue;
+            }
+
+            const std::span<const std::uint8_t> data(
+                frame + frame_header.tp_mac,
+                frame_header.tp_snaplen);
+
+            if (const auto packet = parse_tcp_packet(link_type_, data))
+            {
+                const auto timestamp =
+                    std::chrono::seconds(frame_header.tp_sec) +
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::nanoseconds(frame_header.tp_nsec));
+
+                packets_.push_back(CapturedPacket{timestamp, *packet});
+
+                if (filter_)
+                {
+                    filter_->observe(*packet);
+                }
+            }
+
+            frame += frame_header.tp_next_offset;
+        }
+    }
+}  // namespace gunblade
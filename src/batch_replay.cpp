@@ -0,0 +1,886 @@
+#include "batch_replay.h"
+#include "capture_reader.h"
+#include "tcp_reassembler.h"
+#include "trace.h"
+
+#include <algorithm>     // clamp, count_if, max, move, sort, stable_sort
+#include <atomic>        // atomic
+#include <chrono>        // microseconds
+#include <cstdint>       // uint8_t, uint32_t, uint64_t
+#include <deque>         // deque
+#include <exception>     // exception
+#include <filesystem>    // create_directory, exists, file_size, is_directory, remove, ...
+#include <fstream>       // ifstream, ofstream
+#include <functional>    // greater
+#include <iterator>      // back_inserter
+#include <limits>        // numeric_limits
+#include <memory>        // make_unique, unique_ptr
+#include <mutex>         // lock_guard, mutex
+#include <numeric>       // iota
+#include <optional>      // nullopt, optional
+#include <queue>         // priority_queue
+#include <random>        // random_device
+#include <stdexcept>     // invalid_argument, runtime_error
+#include <string>        // to_string
+#include <string_view>   // string_view
+#include <system_error>  // error_code
+#include <thread>        // thread
+#include <utility>       // move, pair
+
+#include <fmt/format.h>     // format
+#include <spdlog/spdlog.h>  // debug, error, info, warn
+
+#include <tins/packet.h>
+#include <tins/tcp_ip/stream_follower.h>
+
+/** @brief The size at which merged records are handed to the output sink. */
+static constexpr std::size_t merge_batch_bytes = 64 * 1024;
+
+/** @brief The most packets that are reassembled, then decoded, in one go. */
+static constexpr std::size_t replay_batch_size = 256;
+
+/** @brief The most sorted runs that are merged at once, to stay well within the open file limit. */
+static constexpr std::size_t max_merge_runs = 64;
+
+/** @brief The smallest buffer that a running task spills its output from. */
+static constexpr std::size_t min_task_buffer = 1024 * 1024;
+
+/** @returns Whether @p path looks like a pcap/pcapng capture file. */
+static bool is_capture_file(const std::filesystem::path& path)
+{
+    const auto extension = path.extension();
+    return extension == ".pcap" || extension == ".pcapng" || extension == ".cap";
+}
+
+/** @brief One worker's queue of tasks, which the other workers can steal from. */
+class TaskQueue final
+{
+public:
+    void push(std::size_t task)
+    {
+        std::lock_guard lock(mutex_);
+        tasks_.push_back(task);
+    }
+
+    /** @brief Takes the next task from the front, for the worker that owns the queue. */
+    std::optional<std::size_t> pop()
+    {
+        std::lock_guard lock(mutex_);
+
+        if (tasks_.empty())
+        {
+            return std::nullopt;
+        }
+
+        const auto task = tasks_.front();
+        tasks_.pop_front();
+        return task;
+    }
+
+    /** @brief Takes the last (and smallest) task from the back, for another worker. */
+    std::optional<std::size_t> steal()
+    {
+        std::lock_guard lock(mutex_);
+
+        if (tasks_.empty())
+        {
+            return std::nullopt;
+        }
+
+        const auto task = tasks_.back();
+        tasks_.pop_back();
+        return task;
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<std::size_t> tasks_;
+};
+
+/** @brief A record in a sorted run. */
+struct RunRecord
+{
+    std::uint64_t epoch = 0;
+    bool priority = false;
+    std::string_view data;
+};
+
+/** @brief A run of records, sorted by timestamp, that's read back one record at a time. */
+class SortedRun
+{
+public:
+    virtual ~SortedRun() = default;
+
+    /**
+     * @brief Moves on to the next record.
+     *
+     * @return The record, which is only valid until the next call, or null at the end.
+     */
+    virtual const RunRecord* next() = 0;
+
+    /** @returns Whether the run is read from a file, which is kept open until it's done. */
+    virtual bool in_file() const noexcept = 0;
+};
+
+/** @brief A sorted run that's still in memory. */
+class MemoryRun final : public SortedRun
+{
+public:
+    MemoryRun(std::vector<RunRecord> records, std::string data)
+        : records_(std::move(records)), data_(std::move(data))
+    {
+        // Do nothing
+    }
+
+    const RunRecord* next() override
+    {
+        return next_ < records_.size() ? &records_[next_++] : nullptr;
+    }
+
+    bool in_file() const noexcept override
+    {
+        return false;
+    }
+
+private:
+    /** @brief The records, which point into `data_`. */
+    std::vector<RunRecord> records_;
+    std::string data_;
+    std::size_t next_ = 0;
+};
+
+/**
+ * @brief Writes a sorted run to a spill file, as a sequence of records that each
+ * start with their timestamp, size and priority, in native byte order.
+ */
+class RunWriter final
+{
+public:
+    /** @throws std::runtime_error If the file can't be created. */
+    explicit RunWriter(const std::filesystem::path& path)
+        : path_(path), file_(path, std::ios::binary | std::ios::trunc)
+    {
+        if (!file_)
+        {
+            throw std::runtime_error(fmt::format("Unable to create {}", path_.string()));
+        }
+    }
+
+    void write(const RunRecord& record)
+    {
+        const auto size = static_cast<std::uint32_t>(record.data.size());
+        const auto priority = static_cast<std::uint8_t>(record.priority);
+
+        file_.write(reinterpret_cast<const char*>(&record.epoch), sizeof(record.epoch));
+        file_.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        file_.write(reinterpret_cast<const char*>(&priority), sizeof(priority));
+        file_.write(record.data.data(), static_cast<std::streamsize>(record.data.size()));
+    }
+
+    /** @throws std::runtime_error If anything couldn't be written, such as when out of disk. */
+    void close()
+    {
+        file_.close();
+
+        if (!file_)
+        {
+            throw std::runtime_error(fmt::format("Unable to write to {}", path_.string()));
+        }
+    }
+
+private:
+    const std::filesystem::path path_;
+    std::ofstream file_;
+};
+
+/**
+ * @brief A sorted run in a spill file, which is deleted once it's been read.
+ * The file is only opened once the first record is read.
+ */
+class FileRun final : public SortedRun
+{
+public:
+    explicit FileRun(std::filesystem::path path) : path_(std::move(path))
+    {
+        // Do nothing
+    }
+
+    FileRun(const FileRun&) = delete;
+    FileRun& operator=(const FileRun&) = delete;
+
+    ~FileRun() override
+    {
+        file_.close();
+
+        std::error_code ec;
+        std::filesystem::remove(path_, ec);
+    }
+
+    /** @throws std::runtime_error If the file can't be read, or ends partway through a record. */
+    const RunRecord* next() override
+    {
+        if (!file_.is_open())
+        {
+            file_.open(path_, std::ios::binary);
+
+            if (!file_)
+            {
+                throw std::runtime_error(fmt::format("Unable to open {}", path_.string()));
+            }
+        }
+
+        std::uint32_t size = 0;
+        std::uint8_t priority = 0;
+
+        if (!file_.read(reinterpret_cast<char*>(&record_.epoch), sizeof(record_.epoch)))
+        {
+            if (file_.gcount() == 0 && file_.eof())
+            {
+                return nullptr;
+            }
+
+            throw std::runtime_error(fmt::format("{} is truncated", path_.string()));
+        }
+
+        file_.read(reinterpret_cast<char*>(&size), sizeof(size));
+        file_.read(reinterpret_cast<char*>(&priority), sizeof(priority));
+        data_.resize(size);
+        file_.read(data_.data(), static_cast<std::streamsize>(size));
+
+        if (!file_)
+        {
+            throw std::runtime_error(fmt::format("{} is truncated", path_.string()));
+        }
+
+        record_.priority = priority != 0;
+        record_.data = data_;
+        return &record_;
+    }
+
+    bool in_file() const noexcept override
+    {
+        return true;
+    }
+
+private:
+    const std::filesystem::path path_;
+    std::ifstream file_;
+    std::string data_;
+    RunRecord record_;
+};
+
+/**
+ * @brief Merges sorted runs by timestamp, passing each record to @p emit in turn.
+ * Records with the same timestamp are kept in the order of the runs they came from.
+ */
+template <typename Emit>
+static void merge_runs(std::vector<std::unique_ptr<SortedRun>>& runs, Emit&& emit)
+{
+    using Head = std::pair<std::uint64_t, std::size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<>> heads;
+    std::vector<const RunRecord*> current(runs.size());
+
+    for (std::size_t i = 0; i < runs.size(); ++i)
+    {
+        current[i] = runs[i]->next();
+
+        if (current[i] != nullptr)
+        {
+            heads.emplace(current[i]->epoch, i);
+        }
+    }
+
+    while (!heads.empty())
+    {
+        const auto i = heads.top().second;
+        heads.pop();
+
+        emit(*current[i]);
+        current[i] = runs[i]->next();
+
+        if (current[i] != nullptr)
+        {
+            heads.emplace(current[i]->epoch, i);
+        }
+    }
+}
+
+namespace gunblade
+{
+    /**
+     * @brief The temporary directory that a replay's output is spilled to, and the
+     * memory that finished tasks share to keep their output in instead.
+     * The directory is only created when something is spilled, and is removed
+     * with everything in it once the replay is over.
+     */
+    class BatchReplay::Spill final
+    {
+    public:
+        Spill(std::filesystem::path parent, std::size_t retain_limit)
+            : parent_(std::move(parent)), retain_limit_(retain_limit)
+        {
+            // Do nothing
+        }
+
+        Spill(const Spill&) = delete;
+        Spill& operator=(const Spill&) = delete;
+
+        ~Spill()
+        {
+            if (!directory_.empty())
+            {
+                std::error_code ec;
+                std::filesystem::remove_all(directory_, ec);
+            }
+        }
+
+        /**
+         * @returns A new path to spill a sorted run to.
+         * @throws std::runtime_error If the temporary directory can't be created.
+         */
+        std::filesystem::path next_path()
+        {
+            std::lock_guard lock(mutex_);
+
+            if (directory_.empty())
+            {
+                create_directory();
+            }
+
+            return directory_ / fmt::format("run-{}", runs_++);
+        }
+
+        /**
+         * @brief Reserves @p bytes of the memory that finished tasks share.
+         *
+         * @return Whether there was enough left. If not, nothing is reserved.
+         */
+        bool retain(std::size_t bytes)
+        {
+            std::lock_guard lock(mutex_);
+
+            if (retained_ + bytes > retain_limit_)
+            {
+                return false;
+            }
+
+            retained_ += bytes;
+            return true;
+        }
+
+    private:
+        void create_directory()
+        {
+            const auto parent = parent_.empty() ? std::filesystem::temp_directory_path() : parent_;
+            std::random_device random;
+
+            // Another replay may be spilling to the same place at the same time
+            for (int attempt = 0; attempt < 16; ++attempt)
+            {
+                auto path = parent / fmt::format("gunblade-spill-{:08x}{:08x}", random(), random());
+
+                std::error_code ec;
+
+                if (std::filesystem::create_directory(path, ec))
+                {
+                    directory_ = std::move(path);
+                    spdlog::info("Spilling replay output to {}", directory_.string());
+                    return;
+                }
+            }
+
+            throw std::runtime_error(
+                fmt::format("Unable to create a temporary directory in {}", parent.string()));
+        }
+
+        const std::filesystem::path parent_;
+        const std::size_t retain_limit_;
+
+        std::mutex mutex_;
+        std::filesystem::path directory_;
+        std::size_t runs_ = 0;
+        std::size_t retained_ = 0;
+    };
+
+    /**
+     * @brief Holds one task's records, until they can be merged with every other
+     * task's, spilling them to sorted runs on disk whenever its buffer fills up.
+     */
+    class BatchReplay::Collector final : public RecordWriter
+    {
+    public:
+        /** @throws std::runtime_error If the buffer fills up, and can't be spilled. */
+        void write(std::string_view record, std::uint64_t epoch, bool priority) override
+        {
+            records_.push_back(Record{epoch, data_.size(), record.size(), priority});
+            data_.append(record);
+
+            if (data_.size() >= max_buffered_)
+            {
+                spill();
+            }
+        }
+
+        std::chrono::microseconds capture_time() const noexcept override
+        {
+            return capture_time_;
+        }
+
+        /** @brief Sets when the packet about to be followed was captured. */
+        inline void set_capture_time(std::chrono::microseconds time) noexcept
+        {
+            capture_time_ = time;
+        }
+
+        /** @brief Sets where to spill to, once @p max_buffered bytes of records are buffered. */
+        inline void set_spill(Spill& spill, std::size_t max_buffered) noexcept
+        {
+            spill_ = &spill;
+            max_buffered_ = max_buffered;
+        }
+
+        /**
+         * @brief Sorts what's left in the buffer, which is kept in memory if
+         * there's room for it, or otherwise spilled too.
+         *
+         * @throws std::runtime_error If the buffer can't be spilled.
+         */
+        void finish()
+        {
+            if (records_.empty() || spill_->retain(data_.size()))
+            {
+                sort();
+                return;
+            }
+
+            spill();
+
+            data_.shrink_to_fit();
+            records_.shrink_to_fit();
+        }
+
+        /** @brief Hands over every sorted run, in the order they were written. */
+        void take_runs(std::vector<std::unique_ptr<SortedRun>>& runs)
+        {
+            for (auto& path : spilled_)
+            {
+                runs.push_back(std::make_unique<FileRun>(std::move(path)));
+            }
+
+            spilled_.clear();
+
+            if (!records_.empty())
+            {
+                runs.push_back(std::make_unique<MemoryRun>(run_records(), std::move(data_)));
+                records_.clear();
+            }
+        }
+
+        /** @returns How many runs have been spilled. */
+        inline std::size_t spilled_runs() const noexcept
+        {
+            return spilled_runs_;
+        }
+
+        /** @returns How many bytes of records have been spilled. */
+        inline std::uint64_t spilled_bytes() const noexcept
+        {
+            return spilled_bytes_;
+        }
+
+    private:
+        struct Record
+        {
+            std::uint64_t epoch;
+            std::size_t offset;
+            std::size_t size;
+            bool priority;
+        };
+
+        /** @brief Sorts the records by timestamp, keeping the order of those with the same one. */
+        void sort()
+        {
+            std::stable_sort(records_.begin(), records_.end(), [](const auto& a, const auto& b) {
+                return a.epoch < b.epoch;
+            });
+        }
+
+        /** @returns The buffered records, pointing into the buffer. */
+        std::vector<RunRecord> run_records() const
+        {
+            std::vector<RunRecord> records;
+            records.reserve(records_.size());
+
+            for (const auto& record : records_)
+            {
+                records.push_back(RunRecord{
+                    record.epoch,
+                    record.priority,
+                    std::string_view(data_).substr(record.offset, record.size)});
+            }
+
+            return records;
+        }
+
+        /** @brief Sorts the buffer, writes it out as a run, and empties it. */
+        void spill()
+        {
+            GUNBLADE_TRACE_SPAN("spill");
+            sort();
+
+            auto path = spill_->next_path();
+            RunWriter writer(path);
+
+            for (const auto& record : run_records())
+            {
+                writer.write(record);
+            }
+
+            writer.close();
+            spilled_.push_back(std::move(path));
+
+            ++spilled_runs_;
+            spilled_bytes_ += data_.size();
+
+            data_.clear();
+            records_.clear();
+        }
+
+        std::string data_;
+        std::vector<Record> records_;
+        std::chrono::microseconds capture_time_{0};
+
+        Spill* spill_ = nullptr;
+        std::size_t max_buffered_ = std::numeric_limits<std::size_t>::max();
+
+        /** @brief The runs that have been spilled, oldest first. */
+        std::vector<std::filesystem::path> spilled_;
+        std::size_t spilled_runs_ = 0;
+        std::uint64_t spilled_bytes_ = 0;
+    };
+
+    struct BatchReplay::Task
+    {
+        /** @brief The capture file to replay. */
+        std::string path;
+
+        /** @brief Which of the file's shards of flows to follow. */
+        std::size_t shard = 0;
+
+        /** @brief How many shards the file's flows are split into. */
+        std::size_t shards = 1;
+
+        /** @brief Roughly how much of the file the task decodes, to deal out the biggest first. */
+        std::uintmax_t cost = 0;
+
+        Collector output;
+        std::uint64_t packets = 0;
+        bool failed = false;
+    };
+
+    BatchReplay::BatchReplay(const BatchOptions& options, Pipeline::FollowerSetup setup)
+        : options_(options), setup_(std::move(setup))
+    {
+        // Do nothing
+    }
+
+    BatchReplay::BatchReplay(const BatchOptions& options, ReassemblerSetup setup)
+        : options_(options), reassembler_setup_(std::move(setup))
+    {
+        // Do nothing
+    }
+
+    BatchReplay::Stats BatchReplay::run(
+        const std::vector<std::string>& files,
+        OutputSink& out) const
+    {
+        // Split each file into enough shards to cover it, but no more than can run at once
+        std::vector<Task> tasks;
+
+        for (const auto& path : files)
+        {
+            std::error_code ec;
+            const auto size = std::filesystem::file_size(path, ec);
+            const auto bytes = ec ? 0 : size;
+
+            const auto shards = std::clamp<std::uintmax_t>(
+                (bytes + options_.bytes_per_task - 1) / options_.bytes_per_task,
+                1,
+                options_.workers);
+
+            for (std::size_t shard = 0; shard < shards; ++shard)
+            {
+                auto& task = tasks.emplace_back();
+                task.path = path;
+                task.shard = shard;
+                task.shards = static_cast<std::size_t>(shards);
+                task.cost = bytes / shards;
+            }
+        }
+
+        Stats stats;
+        stats.tasks = tasks.size();
+
+        if (tasks.empty())
+        {
+            return stats;
+        }
+
+        const auto workers = std::clamp<std::size_t>(options_.workers, 1, tasks.size());
+
+        // Half of the merge memory buffers the running tasks' output, and the other half
+        // keeps finished tasks' output, so that as little of it as possible goes to disk
+        Spill spill(options_.spill_directory, options_.merge_memory / 2);
+        const auto task_buffer = std::max(options_.merge_memory / 2 / workers, min_task_buffer);
+
+        for (auto& task : tasks)
+        {
+            task.output.set_spill(spill, task_buffer);
+        }
+
+        // Deal out the biggest tasks first, so the small ones are left to even out the workers
+        std::vector<std::size_t> order(tasks.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&tasks](std::size_t a, std::size_t b) {
+            return tasks[a].cost > tasks[b].cost;
+        });
+
+        std::vector<TaskQueue> queues(workers);
+
+        for (std::size_t i = 0; i < order.size(); ++i)
+        {
+            queues[i % workers].push(order[i]);
+        }
+
+        spdlog::info(
+            "Replaying {} capture file(s) as {} task(s) on {} worker(s)",
+            files.size(),
+            tasks.size(),
+            workers);
+
+        std::atomic<std::size_t> stolen = 0;
+        std::vector<std::thread> threads;
+
+        for (std::size_t worker = 0; worker < workers; ++worker)
+        {
+            threads.emplace_back([this, worker, workers, &tasks, &queues, &stolen]() {
+                trace::set_thread_name("batch worker " + std::to_string(worker));
+
+                while (true)
+                {
+                    auto task = queues[worker].pop();
+
+                    // Out of work, so take some from the next worker that has any left
+                    for (std::size_t other = 1; !task.has_value() && other < workers; ++other)
+                    {
+                        task = queues[(worker + other) % workers].steal();
+
+                        if (task.has_value())
+                        {
+                            stolen.fetch_add(1, std::memory_order_relaxed);
+                        }
+                    }
+
+                    // Nobody has any left, and no more are ever added
+                    if (!task.has_value())
+                    {
+                        break;
+                    }
+
+                    replay(tasks[*task]);
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        stats.stolen_tasks = stolen.load(std::memory_order_relaxed);
+
+        // Merge every task's sorted runs, breaking ties by task so that the output is stable
+        GUNBLADE_TRACE_SPAN("merge");
+
+        std::vector<std::unique_ptr<SortedRun>> runs;
+
+        for (auto& task : tasks)
+        {
+            stats.packets += task.packets;
+            stats.failed_tasks += task.failed ? 1 : 0;
+            stats.spilled_runs += task.output.spilled_runs();
+            stats.spilled_bytes += task.output.spilled_bytes();
+
+            task.output.take_runs(runs);
+        }
+
+        const auto files_open = [&runs]() {
+            return std::count_if(runs.begin(), runs.end(), [](const auto& run) {
+                return run->in_file();
+            });
+        };
+
+        // Too many spilled runs to read at once are merged into fewer, longer ones first.
+        // Neighbouring runs are merged together, so the ties between them break the same way.
+        while (static_cast<std::size_t>(files_open()) > max_merge_runs)
+        {
+            std::vector<std::unique_ptr<SortedRun>> merged;
+            std::vector<std::unique_ptr<SortedRun>> group;
+            std::size_t group_files = 0;
+
+            for (auto& run : runs)
+            {
+                group_files += run->in_file() ? 1 : 0;
+                group.push_back(std::move(run));
+
+                if (group_files < max_merge_runs)
+                {
+                    continue;
+                }
+
+                auto path = spill.next_path();
+                RunWriter writer(path);
+                merge_runs(group, [&writer](const RunRecord& record) { writer.write(record); });
+                writer.close();
+
+                merged.push_back(std::make_unique<FileRun>(std::move(path)));
+                group.clear();
+                group_files = 0;
+            }
+
+            // The runs after the last full group are left for the next pass
+            std::move(group.begin(), group.end(), std::back_inserter(merged));
+            runs = std::move(merged);
+        }
+
+        // Hand the merged records over in big batches, rather than one at a time
+        std::string batch;
+        bool priority = false;
+
+        merge_runs(runs, [&](const RunRecord& record) {
+            batch.append(record.data);
+            priority |= record.priority;
+            ++stats.records;
+
+            if (batch.size() >= merge_batch_bytes)
+            {
+                out.write(batch, priority);
+                batch.clear();
+                priority = false;
+            }
+        });
+
+        out.write(batch, priority);
+        out.flush();
+        return stats;
+    }
+
+    void BatchReplay::replay(Task& task) const
+    {
+        GUNBLADE_TRACE_SPAN("replay_task");
+        spdlog::debug("Replaying {} (shard {} of {})", task.path, task.shard + 1, task.shards);
+
+        try
+        {
+            // Other shards' packets are skipped before libtins ever parses them
+            CaptureReader reader(task.path);
+            reader.set_shard(task.shard, task.shards);
+
+            if (reassembler_setup_)
+            {
+                // Packets go straight from the file to the reassembler, never through libtins
+                TcpReassembler reassembler;
+                reassembler_setup_(reassembler, task.output);
+
+                while (true)
+                {
+                    const auto batch = reader.next_batch(replay_batch_size);
+
+                    if (batch.empty())
+                    {
+                        break;
+                    }
+
+                    // Each batch is decoded in one go, so it's stamped with its last packet
+                    task.output.set_capture_time(batch.back().timestamp);
+                    reassembler.process(batch);
+                    task.packets += batch.size();
+                }
+            }
+            else
+            {
+                // Each task has its own follower, which only ever sees its own shard's flows
+                Tins::TCPIP::StreamFollower follower;
+                setup_(follower, task.output);
+
+                while (true)
+                {
+                    Tins::Packet packet = reader.next_packet();
+
+                    if (!packet)
+                    {
+                        break;
+                    }
+
+                    task.output.set_capture_time(packet_time(packet));
+                    follower.process_packet(packet);
+                    ++task.packets;
+                }
+            }
+
+            if (reader.truncated())
+            {
+                spdlog::warn("{} ends with a truncated or malformed record", task.path);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            spdlog::error("Unable to replay {}: {}", task.path, e.what());
+            task.failed = true;
+        }
+
+        try
+        {
+            task.output.finish();
+        }
+        catch (const std::exception& e)
+        {
+            spdlog::error("Unable to spill the output of {}: {}", task.path, e.what());
+            task.failed = true;
+        }
+    }
+
+    std::vector<std::string> BatchReplay::expand_paths(const std::vector<std::string>& paths)
+    {
+        std::vector<std::string> files;
+
+        for (const auto& path : paths)
+        {
+            if (!std::filesystem::exists(path))
+            {
+                throw std::invalid_argument(fmt::format("No such file or directory: {}", path));
+            }
+
+            if (!std::filesystem::is_directory(path))
+            {
+                files.push_back(path);
+                continue;
+            }
+
+            std::vector<std::string> found;
+
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(path))
+            {
+                if (entry.is_regular_file() && is_capture_file(entry.path()))
+                {
+                    found.push_back(entry.path().string());
+                }
+            }
+
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        }
+
+        return files;
+    }
+}  // namespace gunblade
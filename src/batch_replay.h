@@ -0,0 +1,130 @@
+#pragma once
+
+#include "output.h"
+#include "output_sink.h"
+#include "pipeline.h"
+
+#include <cstddef>     // size_t
+#include <cstdint>     // uint64_t, uintmax_t
+#include <filesystem>  // path
+#include <string>      // string
+#include <vector>      // vector
+
+namespace gunblade
+{
+    struct BatchOptions
+    {
+        /** @brief The number of worker threads to replay on. */
+        std::size_t workers = 1;
+
+        /**
+         * @brief How many bytes of capture file each task should cover, roughly.
+         *
+         * Larger files are split by flow into more tasks, so that one big file
+         * can still be replayed across every worker.
+         */
+        std::uintmax_t bytes_per_task = 32 * 1024 * 1024;
+
+        /**
+         * @brief The most bytes of output to hold in memory until the merge, across
+         * every task. The rest is spilled to sorted runs in temporary files.
+         */
+        std::size_t merge_memory = 512 * 1024 * 1024;
+
+        /** @brief Where to put the temporary files. Empty for the system's temporary directory. */
+        std::filesystem::path spill_directory;
+    };
+
+    /**
+     * @brief Replays many capture files at once, across every worker, and merges
+     * their output in timestamp order.
+     *
+     * Each file is split into one or more tasks, each of which follows only the
+     * flows whose hash falls in its shard. Every task has its own stream follower
+     * (or `TcpReassembler`), so each flow is still only ever followed and decoded
+     * by one thread. Tasks
+     * are dealt out to per-worker queues up front, largest first, and a worker
+     * that runs out steals from the back of another's queue.
+     *
+     * Each task's output is sorted by bundle timestamp, and once every task has
+     * finished, merged into one stream. Half of the merge memory is shared
+     * between the running tasks to buffer their output in, and a task spills
+     * its buffer to a sorted run on disk whenever it fills up. The other half
+     * keeps finished tasks' last runs in memory, so small replays never touch
+     * the disk. The runs are merged a bounded number at a time, so an archive
+     * of any size is merged in about the merge memory, plus temporary files as
+     * big as its output. Flows that span more than one file (such as captures
+     * rotated by size) are followed separately in each file.
+     */
+    class BatchReplay final
+    {
+    public:
+        /** @brief Sets up a task's reassembler, with the writer that the task's output goes to. */
+        using ReassemblerSetup = Pipeline::ReassemblerSetup;
+
+        struct Stats
+        {
+            /** @brief The number of tasks that the files were split into. */
+            std::size_t tasks = 0;
+
+            /** @brief Tasks that a worker took from another worker's queue. */
+            std::size_t stolen_tasks = 0;
+
+            /** @brief Tasks that couldn't finish, because their file couldn't be read. */
+            std::size_t failed_tasks = 0;
+
+            /** @brief Packets that were followed, across every task. */
+            std::uint64_t packets = 0;
+
+            /** @brief Records that were written. */
+            std::uint64_t records = 0;
+
+            /** @brief Sorted runs of output that were spilled to disk, before merging. */
+            std::size_t spilled_runs = 0;
+
+            /** @brief Bytes of output that were spilled to disk, before merging. */
+            std::uint64_t spilled_bytes = 0;
+        };
+
+        /**
+         * @param options How to split up and run the replay
+         * @param setup Sets up each task's stream follower, with the writer to write to
+         */
+        BatchReplay(const BatchOptions& options, Pipeline::FollowerSetup setup);
+
+        /**
+         * @param options How to split up and run the replay
+         * @param setup Sets up each task's reassembler, which is used instead of libtins
+         */
+        BatchReplay(const BatchOptions& options, ReassemblerSetup setup);
+
+        /**
+         * @brief Replays every capture file in @p files, then writes their merged output to @p out.
+         *
+         * @return What was replayed. Files that can't be read are logged and skipped.
+         * @throws std::runtime_error If spilled output can't be read back to merge it.
+         */
+        Stats run(const std::vector<std::string>& files, OutputSink& out) const;
+
+        /**
+         * @brief Expands directories to the capture files inside them (recursively).
+         *
+         * Files are kept in the order given, and the files in each directory are sorted by path.
+         *
+         * @throws std::invalid_argument If a path doesn't exist.
+         */
+        static std::vector<std::string> expand_paths(const std::vector<std::string>& paths);
+
+    private:
+        class Collector;
+        class Spill;
+        struct Task;
+
+        /** @brief Follows the task's share of its file's flows, and sorts what they write. */
+        void replay(Task& task) const;
+
+        const BatchOptions options_;
+        const Pipeline::FollowerSetup setup_;
+        const ReassemblerSetup reassembler_setup_;
+    };
+}  // namespace gunblade
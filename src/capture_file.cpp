@@ -0,0 +1,455 @@
+#include "capture_file.h"
+
+#include <algorithm>   // min
+#include <cstring>     // memcpy
+#include <filesystem>  // path
+#include <stdexcept>   // runtime_error
+
+#include <fmt/format.h>  // format
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr std::uint32_t pcap_magic_microseconds = 0xa1b2c3d4;
+static constexpr std::uint32_t pcap_magic_nanoseconds = 0xa1b23c4d;
+
+static constexpr std::uint32_t pcapng_section_header = 0x0a0d0d0a;
+static constexpr std::uint32_t pcapng_interface = 1;
+static constexpr std::uint32_t pcapng_packet = 2;
+static constexpr std::uint32_t pcapng_simple_packet = 3;
+static constexpr std::uint32_t pcapng_enhanced_packet = 6;
+static constexpr std::uint32_t pcapng_byte_order_magic = 0x1a2b3c4d;
+
+static constexpr std::uint16_t pcapng_option_end = 0;
+static constexpr std::uint16_t pcapng_option_tsresol = 9;
+
+static inline std::uint16_t byteswap16(std::uint16_t value) noexcept
+{
+    return static_cast<std::uint16_t>((value << 8) | (value >> 8));
+}
+
+static inline std::uint32_t byteswap32(std::uint32_t value) noexcept
+{
+    return ((value & 0x000000ff) << 24) | ((value & 0x0000ff00) << 8) |
+           ((value & 0x00ff0000) >> 8) | ((value & 0xff000000) >> 24);
+}
+
+static inline std::uint32_t load32(const std::uint8_t* data) noexcept
+{
+    std::uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+/** @brief Converts a timestamp in @p ticks_per_second units, without overflowing. */
+static std::chrono::microseconds to_microseconds(
+    std::uint64_t ticks,
+    std::uint64_t ticks_per_second) noexcept
+{
+    const auto whole = ticks / ticks_per_second * 1000000;
+    const auto fraction = ticks % ticks_per_second * 1000000 / ticks_per_second;
+
+    return std::chrono::microseconds(static_cast<std::int64_t>(whole + fraction));
+}
+
+namespace gunblade
+{
+    CaptureFile::CaptureFile(const std::string& path)
+    {
+#ifdef _WIN32
+        file_ = CreateFileW(
+            std::filesystem::path(path).c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN,
+            nullptr);
+
+        if (file_ == INVALID_HANDLE_VALUE)
+        {
+            file_ = nullptr;
+            throw std::runtime_error(fmt::format("Unable to open {}", path));
+        }
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(file_, &size);
+        size_ = static_cast<std::size_t>(size.QuadPart);
+
+        if (size_ > 0)
+        {
+            mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            const auto* view =
+                mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+            if (view == nullptr)
+            {
+                unmap();
+                throw std::runtime_error(fmt::format("Unable to map {}", path));
+            }
+
+            data_ = static_cast<const std::uint8_t*>(view);
+        }
+#else
+        const int fd = open(path.c_str(), O_RDONLY);
+
+        if (fd < 0)
+        {
+            throw std::runtime_error(fmt::format("Unable to open {}", path));
+        }
+
+        struct stat info{};
+        fstat(fd, &info);
+        size_ = static_cast<std::size_t>(info.st_size);
+
+        if (size_ > 0)
+        {
+            void* view = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+
+            if (view == MAP_FAILED)
+            {
+                throw std::runtime_error(fmt::format("Unable to map {}", path));
+            }
+
+            // The file is read once, front to back, so read ahead aggressively
+            madvise(view, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const std::uint8_t*>(view);
+        }
+        else
+        {
+            close(fd);
+        }
+#endif
+
+        if (!read_file_header())
+        {
+            unmap();
+            throw std::runtime_error(fmt::format("{} is not a pcap or pcapng file", path));
+        }
+    }
+
+    CaptureFile::~CaptureFile()
+    {
+        unmap();
+    }
+
+    std::optional<CaptureRecord> CaptureFile::next() noexcept
+    {
+        return pcapng_ ? next_pcapng() : next_pcap();
+    }
+
+    bool CaptureFile::read_file_header() noexcept
+    {
+        if (size_ < 12)
+        {
+            return false;
+        }
+
+        const auto magic = load32(data_);
+
+        if (magic == pcapng_section_header)
+        {
+            // Each section sets its own byte order, so it's read along with the blocks
+            pcapng_ = true;
+            return read_byte_order(0);
+        }
+
+        if (size_ < 24)
+        {
+            return false;
+        }
+
+        if (magic == pcap_magic_microseconds || magic == pcap_magic_nanoseconds)
+        {
+            swapped_ = false;
+        }
+        else if (magic == byteswap32(pcap_magic_microseconds) ||
+                 magic == byteswap32(pcap_magic_nanoseconds))
+        {
+            swapped_ = true;
+        }
+        else
+        {
+            return false;
+        }
+
+        nanoseconds_ = read32(0) == pcap_magic_nanoseconds;
+
+        // The top bits of the link type say whether frames end in a checksum, which doesn't matter
+        link_type_ = read32(20) & 0x0fffffff;
+        offset_ = 24;
+
+        return true;
+    }
+
+    void CaptureFile::unmap() noexcept
+    {
+#ifdef _WIN32
+        if (data_)
+        {
+            UnmapViewOfFile(data_);
+        }
+
+        if (mapping_)
+        {
+            CloseHandle(mapping_);
+        }
+
+        if (file_)
+        {
+            CloseHandle(file_);
+        }
+
+        mapping_ = nullptr;
+        file_ = nullptr;
+#else
+        if (data_)
+        {
+            munmap(const_cast<std::uint8_t*>(data_), size_);
+        }
+#endif
+
+        data_ = nullptr;
+    }
+
+    std::optional<CaptureRecord> CaptureFile::next_pcap() noexcept
+    {
+        constexpr std::size_t header_size = 16;
+
+        if (offset_ == size_)
+        {
+            return std::nullopt;
+        }
+
+        if (size_ - offset_ < header_size)
+        {
+            return stop();
+        }
+
+        const auto seconds = read32(offset_);
+        const auto fraction = read32(offset_ + 4);
+        const std::size_t captured = read32(offset_ + 8);
+
+        if (captured > size_ - offset_ - header_size)
+        {
+            return stop();
+        }
+
+        CaptureRecord record;
+        record.timestamp = std::chrono::seconds(seconds) +
+                           std::chrono::microseconds(nanoseconds_ ? fraction / 1000 : fraction);
+        record.link_type = link_type_;
+        record.data = {data_ + offset_ + header_size, captured};
+
+        offset_ += header_size + captured;
+
+        return record;
+    }
+
+    std::optional<CaptureRecord> CaptureFile::next_pcapng() noexcept
+    {
+        while (offset_ != size_)
+        {
+            const auto block = offset_;
+
+            if (size_ - block < 12)
+            {
+                return stop();
+            }
+
+            const auto type = read32(block);
+
+            if (type == pcapng_section_header)
+            {
+                if (!read_byte_order(block))
+                {
+                    return stop();
+                }
+
+                // Interfaces are numbered from zero again in each section
+                interfaces_.clear();
+            }
+
+            const std::size_t length = read32(block + 4);
+
+            if (length < 12 || length % 4 != 0 || length > size_ - block)
+            {
+                return stop();
+            }
+
+            offset_ += length;
+
+            const auto body = block + 8;
+            const auto body_length = length - 12;
+
+            std::size_t interface = 0;
+            std::uint64_t ticks = 0;
+            std::size_t captured = 0;
+            std::size_t header_size = 0;
+
+            switch (type)
+            {
+                case pcapng_interface:
+                    read_interface(body, body_length);
+                    continue;
+
+                case pcapng_enhanced_packet:
+                case pcapng_packet:
+                    header_size = 20;
+
+                    if (body_length < header_size)
+                    {
+                        return stop();
+                    }
+
+                    // The obsolete packet block has a 16-bit interface ID, then a drop count
+                    interface = type == pcapng_enhanced_packet ? read32(body) : read16(body);
+                    ticks = (std::uint64_t{read32(body + 4)} << 32) | read32(body + 8);
+                    captured = read32(body + 12);
+                    break;
+
+                case pcapng_simple_packet:
+                    // Simple packets don't say how much was captured, or when
+                    header_size = 4;
+
+                    if (body_length < header_size)
+                    {
+                        return stop();
+                    }
+
+                    captured = std::min<std::size_t>(read32(body), body_length - header_size);
+                    break;
+
+                default:
+                    // Statistics, name resolution and the like
+                    continue;
+            }
+
+            if (captured > body_length - header_size || interface >= interfaces_.size())
+            {
+                return stop();
+            }
+
+            const auto& info = interfaces_[interface];
+
+            CaptureRecord record;
+            record.timestamp = to_microseconds(ticks, info.ticks_per_second);
+            record.link_type = info.link_type;
+            record.data = {data_ + body + header_size, captured};
+
+            return record;
+        }
+
+        return std::nullopt;
+    }
+
+    bool CaptureFile::read_byte_order(std::size_t block) noexcept
+    {
+        const auto magic = load32(data_ + block + 8);
+
+        if (magic == pcapng_byte_order_magic)
+        {
+            swapped_ = false;
+        }
+        else if (magic == byteswap32(pcapng_byte_order_magic))
+        {
+            swapped_ = true;
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    void CaptureFile::read_interface(std::size_t offset, std::size_t length) noexcept
+    {
+        // Add it even if it's malformed, so the interfaces after it keep their numbers
+        Interface interface;
+
+        if (length < 8)
+        {
+            interface.link_type = 0xffffffff;
+            interfaces_.push_back(interface);
+            return;
+        }
+
+        interface.link_type = read16(offset);
+
+        const auto end = offset + length;
+        offset += 8;
+
+        while (end - offset >= 4)
+        {
+            const auto code = read16(offset);
+            const std::size_t value_length = read16(offset + 2);
+
+            if (code == pcapng_option_end || value_length > end - offset - 4)
+            {
+                break;
+            }
+
+            if (code == pcapng_option_tsresol && value_length >= 1)
+            {
+                // A negative power of 10, or of 2 if the top bit is set
+                const auto resolution = data_[offset + 4];
+                const auto exponent = resolution & 0x7f;
+
+                if (resolution & 0x80)
+                {
+                    if (exponent <= 40)
+                    {
+                        interface.ticks_per_second = std::uint64_t{1} << exponent;
+                    }
+                }
+                else if (exponent <= 12)
+                {
+                    interface.ticks_per_second = 1;
+
+                    for (int i = 0; i < exponent; ++i)
+                    {
+                        interface.ticks_per_second *= 10;
+                    }
+                }
+            }
+
+            // Option values are padded to 32 bits
+            offset += 4 + ((value_length + 3) & ~std::size_t{3});
+
+            if (offset > end)
+            {
+                break;
+            }
+        }
+
+        interfaces_.push_back(interface);
+    }
+
+    std::uint16_t CaptureFile::read16(std::size_t offset) const noexcept
+    {
+        std::uint16_t value;
+        std::memcpy(&value, data_ + offset, sizeof(value));
+        return swapped_ ? byteswap16(value) : value;
+    }
+
+    std::uint32_t CaptureFile::read32(std::size_t offset) const noexcept
+    {
+        const auto value = load32(data_ + offset);
+        return swapped_ ? byteswap32(value) : value;
+    }
+
+    std::nullopt_t CaptureFile::stop() noexcept
+    {
+        truncated_ = true;
+        offset_ = size_;
+        return std::nullopt;
+    }
+}  // namespace gunblade
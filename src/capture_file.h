@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>    // microseconds
+#include <cstddef>   // size_t
+#include <cstdint>   // uint8_t, uint32_t, uint64_t
+#include <optional>  // optional
+#include <span>      // span
+#include <string>    // string
+#include <vector>    // vector
+
+namespace gunblade
+{
+    /** @brief One packet record in a capture file, pointing into the mapped file. */
+    struct CaptureRecord
+    {
+        /** @brief When the packet was captured, since the Unix epoch. */
+        std::chrono::microseconds timestamp{0};
+
+        /** @brief The link-layer header type of the packet (see `link_type`). */
+        std::uint32_t link_type = 0;
+
+        /** @brief The bytes that were captured, which may be fewer than were sent. */
+        std::span<const std::uint8_t> data;
+    };
+
+    /**
+     * @brief Walks the packet records of a pcap or pcapng file in place, in a memory map.
+     *
+     * Nothing is copied or allocated per packet, and the whole file is mapped
+     * up front so the kernel can read ahead as far as it likes. Compressed
+     * captures aren't supported.
+     */
+    class CaptureFile final
+    {
+    public:
+        /** @throws std::runtime_error If the file can't be mapped, or isn't a capture file. */
+        explicit CaptureFile(const std::string& path);
+
+        CaptureFile(const CaptureFile&) = delete;
+        CaptureFile& operator=(const CaptureFile&) = delete;
+
+        ~CaptureFile();
+
+        /**
+         * @brief Gets the next packet record.
+         *
+         * @return The next record, which stays valid for as long as the file does,
+         * or nothing if the end of the file (or something malformed) was reached.
+         */
+        std::optional<CaptureRecord> next() noexcept;
+
+        /** @returns Whether reading stopped early, at a truncated or malformed record. */
+        inline bool truncated() const noexcept
+        {
+            return truncated_;
+        }
+
+        /** @returns The size of the file, in bytes. */
+        inline std::size_t size() const noexcept
+        {
+            return size_;
+        }
+
+    private:
+        /** @brief An interface described by a pcapng file, which its packets refer to by index. */
+        struct Interface
+        {
+            std::uint32_t link_type = 0;
+
+            /** @brief The units that the interface's timestamps count, per second. */
+            std::uint64_t ticks_per_second = 1000000;
+        };
+
+        /** @brief Works out the file's format from its header, and skips past it. */
+        bool read_file_header() noexcept;
+
+        void unmap() noexcept;
+
+        std::optional<CaptureRecord> next_pcap() noexcept;
+        std::optional<CaptureRecord> next_pcapng() noexcept;
+
+        /** @brief Reads the byte order of a pcapng section, from its header block. */
+        bool read_byte_order(std::size_t block) noexcept;
+
+        void read_interface(std::size_t offset, std::size_t length) noexcept;
+
+        std::uint16_t read16(std::size_t offset) const noexcept;
+        std::uint32_t read32(std::size_t offset) const noexcept;
+
+        /** @brief Stops reading, because the file ends in the middle of something. */
+        std::nullopt_t stop() noexcept;
+
+        const std::uint8_t* data_ = nullptr;
+        std::size_t size_ = 0;
+        std::size_t offset_ = 0;
+
+        bool pcapng_ = false;
+        bool swapped_ = false;
+        bool truncated_ = false;
+
+        /** @brief The link type of a pcap file. */
+        std::uint32_t link_type_ = 0;
+
+        /** @brief Whether a pcap file's timestamps are in nanoseconds, rather than microseconds. */
+        bool nanoseconds_ = false;
+
+        /** @brief The interfaces of the current pcapng section. */
+        std::vector<Interface> interfaces_;
+
+#ifdef _WIN32
+        void* file_ = nullptr;
+        void* mapping_ = nullptr;
+#endif
+    };
+}  // namespace gunblade
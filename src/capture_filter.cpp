@@ -0,0 +1,280 @@
+#include "capture_filter.h"
+#include "ffxiv/stream_handler.h"
+
+#include <algorithm>  // min, sort
+#include <array>      // array
+#include <cstdint>    // uint8_t
+#include <exception>  // exception
+#include <stdexcept>  // invalid_argument
+#include <string>     // string
+#include <tuple>      // tie
+#include <utility>    // move
+#include <vector>     // erase_if
+
+#include <fmt/format.h>     // format
+#include <spdlog/spdlog.h>  // debug, info, warn
+
+#include <tins/ipv6_address.h>
+#include <tins/tcp.h>
+
+#include <pcap/pcap.h>
+
+/** @brief Guards libpcap's filter compiler, which isn't thread-safe in older versions. */
+static std::mutex compile_mutex;
+
+static std::string address_to_string(const std::array<std::uint8_t, 16>& addr, bool is_v6)
+{
+    if (is_v6)
+    {
+        return Tins::IPv6Address(addr.data()).to_string();
+    }
+
+    // IPv4 addresses are stored in network byte order
+    return fmt::format("{}.{}.{}.{}", addr[0], addr[1], addr[2], addr[3]);
+}
+
+static constexpr std::uint8_t tcp_syn = 0x02;
+
+/** @returns The filter expression matching both directions of a connection. */
+static std::string connection_filter(const gunblade::ConnectionKey& key)
+{
+    const auto local = address_to_string(key.local_addr, key.is_v6);
+    const auto remote = address_to_string(key.remote_addr, key.is_v6);
+
+    return fmt::format(
+        "(src host {0} and src port {1} and dst host {2} and dst port {3}) or "
+        "(src host {2} and src port {3} and dst host {0} and dst port {1})",
+        local,
+        key.local_port,
+        remote,
+        key.remote_port);
+}
+
+namespace gunblade
+{
+    CompiledFilter::CompiledFilter(std::string expression, int link_type)
+        : expression_(std::move(expression)), program_(new bpf_program{})
+    {
+        std::lock_guard lock(compile_mutex);
+
+        pcap_t* pcap = pcap_open_dead(link_type, 65535);
+
+        if (pcap == nullptr)
+        {
+            throw std::invalid_argument("Unable to open libpcap to compile the capture filter");
+        }
+
+        const bool compiled =
+            pcap_compile(pcap, program_.get(), expression_.c_str(), 1, PCAP_NETMASK_UNKNOWN) == 0;
+        pcap_close(pcap);
+
+        if (!compiled)
+        {
+            throw std::invalid_argument(fmt::format("Invalid capture filter: {}", expression_));
+        }
+    }
+
+    void CompiledFilter::ProgramDeleter::operator()(bpf_program* program) const noexcept
+    {
+        pcap_freecode(program);
+        delete program;
+    }
+
+    CaptureFilter::CaptureFilter(
+        std::shared_ptr<ConnectionCache> connections,
+        int link_type,
+        std::chrono::milliseconds interval)
+        : connections_(std::move(connections)), link_type_(link_type), interval_(interval)
+    {
+        refresher_ = std::thread(&CaptureFilter::refresh_loop, this);
+    }
+
+    CaptureFilter::~CaptureFilter()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            stopped_ = true;
+        }
+
+        wake_.notify_all();
+        refresher_.join();
+    }
+
+    void CaptureFilter::observe(const Tins::PDU& pdu)
+    {
+        const auto* tcp = pdu.find_pdu<Tins::TCP>();
+
+        if (tcp != nullptr && tcp->has_flags(Tins::TCP::SYN))
+        {
+            expedite();
+        }
+    }
+
+    void CaptureFilter::observe(const TcpPacketView& packet)
+    {
+        if ((packet.flags & tcp_syn) != 0)
+        {
+            expedite();
+        }
+    }
+
+    void CaptureFilter::update(Tins::BaseSniffer& sniffer)
+    {
+        update([&sniffer](const CompiledFilter& filter) {
+            return pcap_setfilter(sniffer.get_pcap_handle(), filter.program()) == 0;
+        });
+    }
+
+    void CaptureFilter::update(const Setter& set_filter)
+    {
+        // Almost every packet gets here with nothing new to swap in
+        if (!has_pending_.load(std::memory_order_acquire))
+        {
+            return;
+        }
+
+        std::unique_ptr<CompiledFilter> filter;
+        std::size_t connections = 0;
+
+        {
+            std::lock_guard lock(mutex_);
+            filter = std::move(pending_);
+            connections = pending_connections_;
+            has_pending_.store(false, std::memory_order_relaxed);
+        }
+
+        if (!filter)
+        {
+            return;
+        }
+
+        if (!set_filter(*filter))
+        {
+            // Keep the old filter, and try again next time
+            spdlog::warn("Unable to set the capture filter: {}", filter->expression());
+            return;
+        }
+
+        spdlog::info("Capture filter narrowed to {} FFXIV connection(s)", connections);
+        spdlog::debug("Capture filter: {}", filter->expression());
+
+        std::lock_guard lock(mutex_);
+        filter_ = filter->expression();
+    }
+
+    void CaptureFilter::expedite()
+    {
+        std::lock_guard lock(mutex_);
+
+        // Most SYNs arrive while an update is already being brought forward
+        if (expedited_)
+        {
+            return;
+        }
+
+        // A connection is being opened, which might be one of FFXIV's
+        next_update_ = std::min(next_update_, last_update_ + expedited_interval);
+        expedited_ = true;
+        wake_.notify_one();
+    }
+
+    void CaptureFilter::refresh_loop()
+    {
+        std::unique_lock lock(mutex_);
+
+        while (!stopped_)
+        {
+            const auto now = clock::now();
+
+            if (now < next_update_)
+            {
+                wake_.wait_until(lock, next_update_);
+                continue;
+            }
+
+            // A SYN needs a fresh connection table to have any chance of showing its connection
+            const auto max_age = expedited_ ? expedited_interval : interval_;
+
+            last_update_ = now;
+            next_update_ = now + interval_;
+            expedited_ = false;
+
+            // Don't hold up the capture thread while the table is read
+            lock.unlock();
+            refresh(max_age);
+            lock.lock();
+        }
+    }
+
+    void CaptureFilter::refresh(std::chrono::milliseconds max_age)
+    {
+        try
+        {
+            const auto connections = connections_->owned_by(ffxiv::ffxiv_process_name, max_age);
+            auto expression = build(connections);
+
+            {
+                std::lock_guard lock(mutex_);
+
+                // The capture already has this filter, so any other that's waiting is out of date
+                if (expression == filter_)
+                {
+                    pending_.reset();
+                    has_pending_.store(false, std::memory_order_relaxed);
+                    return;
+                }
+
+                if (pending_ && expression == pending_->expression())
+                {
+                    return;
+                }
+            }
+
+            auto filter = std::make_unique<CompiledFilter>(std::move(expression), link_type_);
+
+            std::lock_guard lock(mutex_);
+            pending_ = std::move(filter);
+            pending_connections_ = connections.size();
+            has_pending_.store(true, std::memory_order_release);
+        }
+        catch (const std::exception& e)
+        {
+            // Keep the old filter, and try again next time
+            spdlog::warn("Unable to update the capture filter: {}", e.what());
+        }
+    }
+
+    std::string CaptureFilter::build(std::vector<ConnectionKey> connections)
+    {
+        // Listening sockets don't have a remote end to match on
+        std::erase_if(connections, [](const auto& key) { return key.remote_port == 0; });
+
+        if (connections.empty() || connections.size() > max_connections)
+        {
+            return base_capture_filter;
+        }
+
+        // Sort the connections so that the same ones always make the same filter
+        std::sort(connections.begin(), connections.end(), [](const auto& a, const auto& b) {
+            return std::tie(a.local_addr, a.local_port, a.remote_addr, a.remote_port) <
+                   std::tie(b.local_addr, b.local_port, b.remote_addr, b.remote_port);
+        });
+
+        std::string filter = "tcp and (";
+
+        for (const auto& key : connections)
+        {
+            filter += connection_filter(key);
+            filter += " or ";
+        }
+
+        // Still let the SYNs of other connections through, so new FFXIV connections are noticed.
+        // tcp[] only indexes into IPv4 packets, so IPv6 SYNs are found at a fixed offset
+        // instead, past the 40-byte header (when TCP follows it directly, as it almost always does)
+        filter += "(((ip and tcp[tcpflags] & tcp-syn != 0) or "
+                  "(ip6 and ip6[6] == 6 and ip6[53] & tcp-syn != 0)) and "
+                  "src portrange 49152-65535 and dst portrange 49152-65535))";
+
+        return filter;
+    }
+}  // namespace gunblade
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "connection_cache.h"
+#include "packet_parser.h"
+
+#include <atomic>              // atomic
+#include <chrono>              // milliseconds, steady_clock
+#include <condition_variable>  // condition_variable
+#include <cstddef>             // size_t
+#include <cstdint>             // uint16_t
+#include <functional>          // function
+#include <memory>              // shared_ptr, unique_ptr
+#include <mutex>               // mutex
+#include <string>              // string
+#include <thread>              // thread
+#include <vector>              // vector
+
+#include <tins/pdu.h>
+#include <tins/sniffer.h>
+
+struct bpf_program;
+
+namespace gunblade
+{
+    /** @brief The capture filter that every sniffer starts out with. */
+    inline constexpr auto base_capture_filter =
+        "tcp and src portrange 49152-65535 and dst portrange 49152-65535";
+
+    /** @returns Whether a TCP segment between these ports would pass `base_capture_filter`. */
+    inline constexpr bool matches_base_filter(
+        std::uint16_t src_port,
+        std::uint16_t dst_port) noexcept
+    {
+        return src_port >= 49152 && dst_port >= 49152;
+    }
+
+    /**
+     * @brief A capture filter expression, compiled by libpcap into a BPF program.
+     *
+     * The program is independent of any capture, so it can be compiled on one
+     * thread and attached on another.
+     */
+    class CompiledFilter final
+    {
+    public:
+        /**
+         * @param expression A libpcap filter expression
+         * @param link_type The link-layer header type (a `DLT_` value) of the capture
+         * @throws std::invalid_argument If the expression doesn't compile.
+         */
+        CompiledFilter(std::string expression, int link_type);
+
+        CompiledFilter(const CompiledFilter&) = delete;
+        CompiledFilter& operator=(const CompiledFilter&) = delete;
+
+        ~CompiledFilter() = default;
+
+        inline const std::string& expression() const noexcept
+        {
+            return expression_;
+        }
+
+        /** @returns The BPF program, to hand to `pcap_setfilter` or `SO_ATTACH_FILTER`. */
+        inline bpf_program* program() const noexcept
+        {
+            return program_.get();
+        }
+
+    private:
+        struct ProgramDeleter final
+        {
+            void operator()(bpf_program* program) const noexcept;
+        };
+
+        std::string expression_;
+        std::unique_ptr<bpf_program, ProgramDeleter> program_;
+    };
+
+    /**
+     * @brief Narrows a live sniffer's capture filter down to the FFXIV connections.
+     *
+     * The base filter lets every ephemeral-to-ephemeral TCP flow into userspace.
+     * Once the connection table shows that FFXIV has connections open, the
+     * filter is swapped for one that only matches those exact connections,
+     * plus the SYNs (over IPv4 or IPv6) of any others, so that the kernel
+     * drops everything else before it's copied. Seeing a SYN brings the next
+     * update forward, so a new game connection is usually added before its
+     * handshake finishes.
+     *
+     * Reading the connection table and compiling the filter both happen on a
+     * background thread, so the capture thread only ever swaps in a filter
+     * that's ready. Apart from the destructor, the member functions must only
+     * be used from the thread that reads packets from the capture.
+     */
+    class CaptureFilter final
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /** @brief The most connections to list in a filter, to keep the BPF program small. */
+        static constexpr std::size_t max_connections = 64;
+
+        /** @brief How soon after the last update a SYN can bring the next one forward. */
+        static constexpr std::chrono::milliseconds expedited_interval{50};
+
+        /**
+         * @brief Starts watching for connections being opened or closed.
+         *
+         * @param connections Where to find out which connections FFXIV has open
+         * @param link_type The link-layer header type (a `DLT_` value) of the capture
+         * @param interval How often to check for connections being opened or closed
+         */
+        CaptureFilter(
+            std::shared_ptr<ConnectionCache> connections,
+            int link_type,
+            std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+
+        CaptureFilter(const CaptureFilter&) = delete;
+        CaptureFilter& operator=(const CaptureFilter&) = delete;
+
+        /** @brief Stops watching, waiting for a check that's in progress to finish. */
+        ~CaptureFilter();
+
+        /** @brief Attaches a compiled filter to a capture, returning whether that worked. */
+        using Setter = std::function<bool(const CompiledFilter&)>;
+
+        /** @brief Notes a captured packet, bringing the next update forward if it opens a connection. */
+        void observe(const Tins::PDU& pdu);
+
+        /** @brief Notes a captured packet that was parsed in place. */
+        void observe(const TcpPacketView& packet);
+
+        /** @brief Swaps @p sniffer's filter, if a new one is ready. */
+        void update(Tins::BaseSniffer& sniffer);
+
+        /** @brief Swaps a capture's filter with @p set_filter, just like a sniffer's. */
+        void update(const Setter& set_filter);
+
+        /** @returns The filter that matches exactly the given connections, and any SYNs. */
+        static std::string build(std::vector<ConnectionKey> connections);
+
+    private:
+        /** @brief Brings the next update forward, since a connection is being opened. */
+        void expedite();
+
+        /** @brief Checks the connections and prepares new filters, until stopped. */
+        void refresh_loop();
+
+        /** @brief Prepares a new filter if the FFXIV connections have changed. */
+        void refresh(std::chrono::milliseconds max_age);
+
+        std::shared_ptr<ConnectionCache> connections_;
+        const int link_type_;
+        const std::chrono::milliseconds interval_;
+
+        std::thread refresher_;
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        bool stopped_ = false;
+
+        clock::time_point last_update_;
+        clock::time_point next_update_;
+
+        /** @brief Whether the next update was brought forward by a SYN. */
+        bool expedited_ = false;
+
+        /** @brief The filter that the capture has. */
+        std::string filter_ = base_capture_filter;
+
+        /** @brief The filter to swap in next, if there is one, and how many connections it has. */
+        std::unique_ptr<CompiledFilter> pending_;
+        std::size_t pending_connections_ = 0;
+
+        /** @brief Whether `pending_` is set, so checking for it doesn't need the mutex. */
+        std::atomic<bool> has_pending_ = false;
+    };
+}  // namespace gunblade
@@ -0,0 +1,113 @@
+#include "capture_filter.h"
+#include "capture_reader.h"
+#include "flow_hash.h"
+
+#include <exception>  // exception
+#include <memory>     // make_unique, unique_ptr
+
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/pdu.h>
+#include <tins/timestamp.h>
+
+namespace gunblade
+{
+    CaptureReader::CaptureReader(const std::string& path) : file_(path)
+    {
+        // Do nothing
+    }
+
+    void CaptureReader::set_shard(std::size_t shard, std::size_t shards) noexcept
+    {
+        shard_ = shard;
+        shards_ = shards > 0 ? shards : 1;
+    }
+
+    Tins::Packet CaptureReader::next_packet()
+    {
+        while (const auto packet = next_match())
+        {
+            const auto& ip = packet->tcp.ip;
+            const auto size = static_cast<std::uint32_t>(ip.size());
+            std::unique_ptr<Tins::PDU> pdu;
+
+            try
+            {
+                if (packet->tcp.is_v6)
+                {
+                    pdu = std::make_unique<Tins::IPv6>(ip.data(), size);
+                }
+                else
+                {
+                    pdu = std::make_unique<Tins::IP>(ip.data(), size);
+                }
+            }
+            catch (const std::exception&)
+            {
+                ++stats_.malformed;
+                continue;
+            }
+
+            ++stats_.packets;
+
+            return Tins::Packet(pdu.release(), Tins::Timestamp(packet->timestamp));
+        }
+
+        return Tins::Packet();
+    }
+
+    std::optional<CaptureReader::ParsedPacket> CaptureReader::next_parsed() noexcept
+    {
+        auto packet = next_match();
+
+        if (packet)
+        {
+            ++stats_.packets;
+        }
+
+        return packet;
+    }
+
+    std::span<const CaptureReader::ParsedPacket> CaptureReader::next_batch(std::size_t max)
+    {
+        batch_.clear();
+
+        while (batch_.size() < max)
+        {
+            const auto packet = next_parsed();
+
+            if (!packet)
+            {
+                break;
+            }
+
+            batch_.push_back(*packet);
+        }
+
+        return batch_;
+    }
+
+    std::optional<CaptureReader::ParsedPacket> CaptureReader::next_match() noexcept
+    {
+        while (const auto record = file_.next())
+        {
+            ++stats_.records;
+
+            const auto packet = parse_tcp_packet(record->link_type, record->data);
+
+            if (!packet || !matches_base_filter(packet->src_port, packet->dst_port))
+            {
+                continue;
+            }
+
+            if (shards_ > 1 && flow_hash(*packet) % shards_ != shard_)
+            {
+                continue;
+            }
+
+            return ParsedPacket{record->timestamp, *packet};
+        }
+
+        return std::nullopt;
+    }
+}  // namespace gunblade
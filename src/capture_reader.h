@@ -0,0 +1,103 @@
+#pragma once
+
+#include "capture_file.h"
+#include "packet_parser.h"
+
+#include <cstddef>   // size_t
+#include <cstdint>   // uint64_t
+#include <optional>  // optional
+#include <span>      // span
+#include <string>    // string
+#include <vector>    // vector
+
+#include <tins/packet.h>
+
+namespace gunblade
+{
+    /**
+     * @brief Replays the TCP packets of a capture file that `base_capture_filter`
+     * lets through, reading the file directly rather than through libpcap.
+     *
+     * Every record is parsed in place with `parse_tcp_packet()`, so packets that
+     * are filtered out never reach libtins at all. The packets that are kept are
+     * handed over as libtins packets, starting from their IP layer, or just as
+     * they were parsed.
+     */
+    class CaptureReader final
+    {
+    public:
+        struct Stats
+        {
+            /** @brief Packet records read from the file. */
+            std::uint64_t records = 0;
+
+            /** @brief Packets handed over, after filtering. */
+            std::uint64_t packets = 0;
+
+            /** @brief Packets that passed the filter, but that libtins couldn't parse. */
+            std::uint64_t malformed = 0;
+        };
+
+        /**
+         * @brief A packet that passed the filter, parsed in place in the file. It
+         * points into the file for as long as the reader lives.
+         */
+        using ParsedPacket = CapturedPacket;
+
+        /** @throws std::runtime_error If the file can't be mapped, or isn't a capture file. */
+        explicit CaptureReader(const std::string& path);
+
+        /**
+         * @brief Only keeps the packets whose flows hash into one shard, as sharded
+         * by `flow_hash()`, so several readers can split a file between them.
+         */
+        void set_shard(std::size_t shard, std::size_t shards) noexcept;
+
+        /**
+         * @brief Gets the next packet that passes the filter.
+         *
+         * @return The next packet, or an empty packet at the end of the file, just
+         * like `Tins::FileSniffer`.
+         */
+        Tins::Packet next_packet();
+
+        /**
+         * @brief Gets the next packet that passes the filter, without handing it to libtins.
+         *
+         * @return The next packet, or nothing at the end of the file.
+         */
+        std::optional<ParsedPacket> next_parsed() noexcept;
+
+        /**
+         * @brief Gets up to @p max of the next packets that pass the filter, without
+         * handing them to libtins.
+         *
+         * @return The packets, which are valid until the next call, or nothing at
+         * the end of the file.
+         */
+        std::span<const ParsedPacket> next_batch(std::size_t max);
+
+        inline const Stats& stats() const noexcept
+        {
+            return stats_;
+        }
+
+        /** @returns Whether the file ended in the middle of a record (see `CaptureFile`). */
+        inline bool truncated() const noexcept
+        {
+            return file_.truncated();
+        }
+
+    private:
+        /** @brief Finds the next packet that passes the filter, without counting it as kept. */
+        std::optional<ParsedPacket> next_match() noexcept;
+
+        CaptureFile file_;
+        Stats stats_;
+
+        std::vector<ParsedPacket> batch_;
+
+        std::size_t shard_ = 0;
+        std::size_t shards_ = 1;
+    };
+}  // namespace gunblade
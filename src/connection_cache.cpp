@@ -0,0 +1,201 @@
+#include "connection_cache.h"
+
+#include <algorithm>  // copy
+#include <cstdint>    // uint32_t, uint64_t
+#include <cstring>    // memcpy
+#include <utility>    // move, swap
+
+#include <spdlog/spdlog.h>  // debug
+
+static void copy_address(const gunblade::IPAddress& addr, std::array<std::uint8_t, 16>& out)
+{
+    if (const auto* v4 = std::get_if<Tins::IPv4Address>(&addr))
+    {
+        // The integer conversion is already in network byte order
+        const auto raw = static_cast<std::uint32_t>(*v4);
+        std::memcpy(out.data(), &raw, sizeof(raw));
+    }
+    else
+    {
+        const auto& v6 = std::get<Tins::IPv6Address>(addr);
+        std::copy(v6.begin(), v6.end(), out.begin());
+    }
+}
+
+namespace gunblade
+{
+    ConnectionKey ConnectionKey::reversed() const noexcept
+    {
+        ConnectionKey key = *this;
+        std::swap(key.local_addr, key.remote_addr);
+        std::swap(key.local_port, key.remote_port);
+
+        return key;
+    }
+
+    ConnectionKey make_connection_key(
+        const IPAddress& local_addr,
+        unsigned short local_port,
+        const IPAddress& remote_addr,
+        unsigned short remote_port)
+    {
+        ConnectionKey key;
+        copy_address(local_addr, key.local_addr);
+        copy_address(remote_addr, key.remote_addr);
+        key.local_port = local_port;
+        key.remote_port = remote_port;
+        key.is_v6 = std::holds_alternative<Tins::IPv6Address>(local_addr);
+
+        return key;
+    }
+
+    ConnectionKey make_connection_key(const ConnectionInfo& info)
+    {
+        return make_connection_key(
+            info.local_addr, info.local_port, info.remote_addr, info.remote_port);
+    }
+
+    std::size_t ConnectionKeyHash::operator()(const ConnectionKey& key) const noexcept
+    {
+        // 64-bit FNV-1a over every field of the key
+        std::uint64_t hash = 0xcbf29ce484222325;
+
+        const auto mix = [&hash](const void* data, std::size_t size) {
+            const auto* bytes = static_cast<const std::uint8_t*>(data);
+
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                hash = (hash ^ bytes[i]) * 0x100000001b3;
+            }
+        };
+
+        mix(key.local_addr.data(), key.is_v6 ? 16 : 4);
+        mix(key.remote_addr.data(), key.is_v6 ? 16 : 4);
+        mix(&key.local_port, sizeof(key.local_port));
+        mix(&key.remote_port, sizeof(key.remote_port));
+
+        return static_cast<std::size_t>(hash);
+    }
+
+    ConnectionCache::ConnectionCache(
+        std::unique_ptr<ConnectionSource> source,
+        std::chrono::milliseconds min_refresh_interval)
+        : source_(std::move(source)), min_refresh_interval_(min_refresh_interval)
+    {
+        // Do nothing
+    }
+
+    ConnectionCache::Lookup ConnectionCache::find(
+        const ConnectionKey& key,
+        clock::time_point first_seen)
+    {
+        std::lock_guard lock(mutex_);
+
+        const auto lookup = [this, &key]() -> const Owner* {
+            auto it = owners_.find(key);
+
+            if (it == owners_.end())
+            {
+                it = owners_.find(key.reversed());
+            }
+
+            return it != owners_.end() ? &it->second : nullptr;
+        };
+
+        const Owner* owner = lookup();
+
+        // Was the connection missing from a snapshot that might predate it?
+        if (owner == nullptr && last_refresh_ < first_seen)
+        {
+            // Yes - re-read the table, unless that was done too recently
+            if (clock::now() - last_refresh_ < min_refresh_interval_)
+            {
+                return Lookup{Status::STALE};
+            }
+
+            refresh();
+            owner = lookup();
+        }
+
+        if (owner == nullptr)
+        {
+            return Lookup{Status::NOT_FOUND};
+        }
+
+        return Lookup{Status::FOUND, owner->pid};
+    }
+
+    std::string ConnectionCache::process_name(unsigned long pid)
+    {
+        std::lock_guard lock(mutex_);
+        return cached_process_name(pid);
+    }
+
+    std::vector<ConnectionKey> ConnectionCache::owned_by(
+        const std::string& name,
+        std::chrono::milliseconds max_age)
+    {
+        std::lock_guard lock(mutex_);
+
+        if (clock::now() - last_refresh_ >= max_age)
+        {
+            refresh();
+        }
+
+        std::vector<ConnectionKey> keys;
+
+        for (const auto& [key, owner] : owners_)
+        {
+            if (cached_process_name(owner.pid) == name)
+            {
+                keys.push_back(key);
+            }
+        }
+
+        return keys;
+    }
+
+    const std::string& ConnectionCache::cached_process_name(unsigned long pid)
+    {
+        auto it = process_names_.find(pid);
+
+        if (it == process_names_.end())
+        {
+            it = process_names_.emplace(pid, ProcessName{source_->process_name(pid), generation_})
+                     .first;
+        }
+
+        return it->second.name;
+    }
+
+    void ConnectionCache::refresh()
+    {
+        // Anything that existed before now is guaranteed to be in the snapshot
+        const auto started = clock::now();
+        const auto connections = source_->connections();
+
+        ++generation_;
+
+        for (const auto& info : connections)
+        {
+            owners_.insert_or_assign(make_connection_key(info), Owner{info.pid, generation_});
+
+            if (const auto it = process_names_.find(info.pid); it != process_names_.end())
+            {
+                it->second.generation = generation_;
+            }
+        }
+
+        // Forget connections that have closed, and processes that no longer own any
+        // connections (their IDs could be reused by other processes later on).
+        std::erase_if(owners_, [this](const auto& entry) {
+            return entry.second.generation != generation_;
+        });
+        std::erase_if(process_names_, [this](const auto& entry) {
+            return entry.second.generation != generation_;
+        });
+
+        last_refresh_ = started;
+        spdlog::debug("Connection table refreshed ({} connections)", owners_.size());
+    }
+}  // namespace gunblade
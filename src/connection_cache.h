@@ -0,0 +1,142 @@
+#pragma once
+
+#include "connection_source.h"
+#include "tcp_table.h"
+
+#include <array>          // array
+#include <chrono>         // milliseconds, steady_clock
+#include <cstddef>        // size_t
+#include <cstdint>        // uint8_t, uint16_t
+#include <memory>         // unique_ptr
+#include <mutex>          // mutex
+#include <string>         // string
+#include <unordered_map>  // unordered_map
+#include <vector>         // vector
+
+namespace gunblade
+{
+    /** @brief Identifies a TCP connection by its 4-tuple, from one side's point of view. */
+    struct ConnectionKey
+    {
+        std::array<std::uint8_t, 16> local_addr{};
+        std::array<std::uint8_t, 16> remote_addr{};
+        std::uint16_t local_port = 0;
+        std::uint16_t remote_port = 0;
+        bool is_v6 = false;
+
+        /** @returns The same connection, from the other side's point of view. */
+        ConnectionKey reversed() const noexcept;
+
+        bool operator==(const ConnectionKey&) const = default;
+    };
+
+    /** @returns The key for the connection between the given endpoints. */
+    ConnectionKey make_connection_key(
+        const IPAddress& local_addr,
+        unsigned short local_port,
+        const IPAddress& remote_addr,
+        unsigned short remote_port);
+
+    /** @returns The key for the connection described by @p info. */
+    ConnectionKey make_connection_key(const ConnectionInfo& info);
+
+    struct ConnectionKeyHash final
+    {
+        std::size_t operator()(const ConnectionKey& key) const noexcept;
+    };
+
+    /**
+     * @brief Caches which process owns each TCP connection, and the names of those processes.
+     *
+     * The connection table is only re-read when a lookup misses, and then at most once
+     * per refresh interval, so a burst of new streams costs a single snapshot. Process
+     * names are cached until their process ID disappears from the connection table.
+     *
+     * All member functions are safe to call from multiple threads.
+     */
+    class ConnectionCache final
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        enum class Status
+        {
+            /** @brief The connection was found in the connection table. */
+            FOUND,
+
+            /** @brief The connection is not in a snapshot taken after it was first seen. */
+            NOT_FOUND,
+
+            /** @brief The connection might not have existed yet when the table was last read. */
+            STALE
+        };
+
+        struct Lookup
+        {
+            Status status;
+
+            /** @brief The ID of the owning process, if the connection was found. */
+            unsigned long pid = 0;
+        };
+
+        explicit ConnectionCache(
+            std::unique_ptr<ConnectionSource> source,
+            std::chrono::milliseconds min_refresh_interval = std::chrono::milliseconds(50));
+
+        /**
+         * @brief Finds the process that owns a connection, from either side's point of view.
+         *
+         * @param key The connection to look up
+         * @param first_seen When the connection was first seen. A miss is only
+         * reported as `Status::NOT_FOUND` once the table has been read after this.
+         */
+        Lookup find(const ConnectionKey& key, clock::time_point first_seen);
+
+        /** @returns The (cached) name of the process identified by @p pid. */
+        std::string process_name(unsigned long pid);
+
+        /**
+         * @brief Lists the connections owned by every process named @p name.
+         *
+         * @param name The process name to match
+         * @param max_age How out of date the connection table may be. It's
+         * re-read first if it was last read longer ago than this.
+         * @return The connections, from the local machine's point of view.
+         */
+        std::vector<ConnectionKey> owned_by(
+            const std::string& name,
+            std::chrono::milliseconds max_age);
+
+    private:
+        /** @brief Re-reads the connection table, updating the cache in place. */
+        void refresh();
+
+        /** @brief Looks up the name of a process. The mutex must already be held. */
+        const std::string& cached_process_name(unsigned long pid);
+
+        std::unique_ptr<ConnectionSource> source_;
+        const std::chrono::milliseconds min_refresh_interval_;
+
+        struct Owner
+        {
+            unsigned long pid;
+
+            /** @brief The refresh that this connection was last seen in. */
+            std::size_t generation;
+        };
+
+        struct ProcessName
+        {
+            std::string name;
+
+            /** @brief The refresh that this process was last seen in. */
+            std::size_t generation;
+        };
+
+        std::mutex mutex_;
+        std::unordered_map<ConnectionKey, Owner, ConnectionKeyHash> owners_;
+        std::unordered_map<unsigned long, ProcessName> process_names_;
+        std::size_t generation_ = 0;
+        clock::time_point last_refresh_;
+    };
+}  // namespace gunblade
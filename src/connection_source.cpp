@@ -0,0 +1,24 @@
+#include "connection_source.h"
+#include "utils.h"
+
+namespace gunblade
+{
+    class SystemConnectionSource final : public ConnectionSource
+    {
+    public:
+        std::vector<ConnectionInfo> connections() override
+        {
+            return get_tcp_table();
+        }
+
+        std::string process_name(unsigned long pid) override
+        {
+            return get_process_name(pid);
+        }
+    };
+
+    std::unique_ptr<ConnectionSource> make_system_connection_source()
+    {
+        return std::make_unique<SystemConnectionSource>();
+    }
+}  // namespace gunblade
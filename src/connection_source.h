@@ -0,0 +1,62 @@
+#pragma once
+
+#include "tcp_table.h"
+
+#include <memory>         // unique_ptr
+#include <string>         // string
+#include <unordered_map>  // unordered_map
+#include <utility>        // move
+#include <vector>         // vector
+
+namespace gunblade
+{
+    /** @brief Somewhere to find out which processes own which TCP connections. */
+    class ConnectionSource
+    {
+    public:
+        virtual ~ConnectionSource() = default;
+
+        /** @returns A snapshot of every TCP connection on the machine. */
+        virtual std::vector<ConnectionInfo> connections() = 0;
+
+        /**
+         * @returns The name of the process identified by @p pid, or an
+         * empty string if the name is unable to be retrieved.
+         */
+        virtual std::string process_name(unsigned long pid) = 0;
+    };
+
+    /** @brief A connection source backed by fixed tables, for replays and tests. */
+    class StaticConnectionSource final : public ConnectionSource
+    {
+    public:
+        explicit StaticConnectionSource(
+            std::vector<ConnectionInfo> connections,
+            std::unordered_map<unsigned long, std::string> process_names)
+            : connections_(std::move(connections)), process_names_(std::move(process_names))
+        {
+            // Do nothing
+        }
+
+        inline std::vector<ConnectionInfo> connections() override
+        {
+            return connections_;
+        }
+
+        inline std::string process_name(unsigned long pid) override
+        {
+            const auto it = process_names_.find(pid);
+            return it != process_names_.end() ? it->second : std::string();
+        }
+
+    private:
+        std::vector<ConnectionInfo> connections_;
+        std::unordered_map<unsigned long, std::string> process_names_;
+    };
+
+    /**
+     * @returns A connection source for the machine Gunblade is running on,
+     * backed by `get_tcp_table()` and `get_process_name()`.
+     */
+    std::unique_ptr<ConnectionSource> make_system_connection_source();
+}  // namespace gunblade
@@ -0,0 +1,64 @@
+#include "ffxiv/binary_format.h"
+#include "utils.h"
+
+#include <cstdio>     // stdin
+#include <exception>  // exception
+#include <fstream>    // ifstream
+#include <iostream>   // cerr, cin, cout
+#include <string>     // string
+
+/**
+ * @brief Converts Gunblade's binary output back into its JSON Lines output.
+ *
+ * Usage: gunblade_convert [file]
+ *
+ * Reads from the given file, or from stdin if there isn't one.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc > 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [file]\n";
+        return 1;
+    }
+
+    std::ifstream file;
+
+    if (argc == 2)
+    {
+        file.open(argv[1], std::ios::binary);
+
+        if (!file)
+        {
+            std::cerr << "Unable to open " << argv[1] << "\n";
+            return 1;
+        }
+    }
+    else
+    {
+        gunblade::set_binary_mode(stdin);
+    }
+
+    std::istream& in = argc == 2 ? file : std::cin;
+
+    try
+    {
+        gunblade::ffxiv::binary::Reader reader(in);
+        gunblade::ffxiv::binary::BundleRecord record;
+        std::string line;
+
+        while (reader.next(record))
+        {
+            line.clear();
+            gunblade::ffxiv::binary::write_json_line(line, record);
+            std::cout.write(line.data(), static_cast<std::streamsize>(line.size()));
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "decode_arena.h"
+
+#include <utility>  // move
+
+/**
+ * @brief The largest buffer that's pooled, rather than going straight to the heap.
+ * Big enough for a flow's decode buffer to grow to a few of the largest bundles.
+ */
+static constexpr std::size_t largest_pooled_block = 4 * gunblade::ffxiv::Bundle::max_length;
+
+namespace gunblade
+{
+    DecodeArena::DecodeArena(std::shared_ptr<Metrics::Shard> metrics)
+        : upstream_(std::move(metrics)),
+          pool_(std::pmr::pool_options{0, largest_pooled_block}, &upstream_)
+    {
+        // Do nothing
+    }
+
+    DecodeArena::Upstream::Upstream(std::shared_ptr<Metrics::Shard> metrics) noexcept
+        : metrics_(std::move(metrics))
+    {
+        // Do nothing
+    }
+
+    void* DecodeArena::Upstream::do_allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (metrics_)
+        {
+            metrics_->count_allocation(bytes);
+        }
+
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void DecodeArena::Upstream::do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool DecodeArena::Upstream::do_is_equal(
+        const std::pmr::memory_resource& other) const noexcept
+    {
+        return this == &other;
+    }
+}  // namespace gunblade
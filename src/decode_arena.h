@@ -0,0 +1,57 @@
+#pragma once
+
+#include "metrics.h"
+
+#include <cstddef>          // size_t
+#include <memory>           // shared_ptr
+#include <memory_resource>  // memory_resource, unsynchronized_pool_resource
+
+namespace gunblade
+{
+    /**
+     * @brief The memory that one follower's flows decode in.
+     *
+     * Buffers that flows give back (as they grow, or when they end) are pooled
+     * rather than freed, so flows that come and go reuse each other's memory
+     * instead of going back to the heap. Only allocations that do reach the heap
+     * are counted, so once every flow's buffers have reached their working size,
+     * decoding a bundle counts none at all.
+     *
+     * Must only be used by one thread, and must outlive everything allocated from it.
+     */
+    class DecodeArena final
+    {
+    public:
+        /** @param metrics What to count heap allocations in. When null, nothing is counted. */
+        explicit DecodeArena(std::shared_ptr<Metrics::Shard> metrics = nullptr);
+
+        DecodeArena(const DecodeArena&) = delete;
+        DecodeArena& operator=(const DecodeArena&) = delete;
+
+        /** @returns The resource to allocate flows' buffers from. */
+        inline std::pmr::memory_resource* resource() noexcept
+        {
+            return &pool_;
+        }
+
+    private:
+        /** @brief Allocates the pool's chunks from the heap, counting each one. */
+        class Upstream final : public std::pmr::memory_resource
+        {
+        public:
+            explicit Upstream(std::shared_ptr<Metrics::Shard> metrics) noexcept;
+
+        private:
+            void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+
+            void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+            std::shared_ptr<Metrics::Shard> metrics_;
+        };
+
+        Upstream upstream_;
+        std::pmr::unsynchronized_pool_resource pool_;
+    };
+}  // namespace gunblade
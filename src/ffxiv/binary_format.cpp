@@ -0,0 +1,200 @@
+#include "binary_format.h"
+
+#include <algorithm>  // equal, min
+#include <bit>        // endian
+#include <cstring>    // memcpy
+#include <stdexcept>  // runtime_error
+
+static_assert(
+    std::endian::native == std::endian::little,
+    "The binary format is written by copying little-endian memory");
+
+template <typename T>
+static void append_raw(std::string& out, const T& value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void append_endpoint(std::string& out, const gunblade::ffxiv::Endpoint& endpoint)
+{
+    const auto length = static_cast<std::uint8_t>(std::min<std::size_t>(endpoint.host.size(), 255));
+
+    append_raw(out, length);
+    out.append(endpoint.host.data(), length);
+    append_raw(out, endpoint.port);
+}
+
+/** @brief Reads fields out of a record, checking that they're all there. */
+class RecordParser final
+{
+public:
+    explicit RecordParser(std::span<const char> data) : data_(data)
+    {
+        // Do nothing
+    }
+
+    template <typename T>
+    T read()
+    {
+        T value;
+        std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::span<const char> take(std::size_t size)
+    {
+        if (data_.size() < size)
+        {
+            throw std::runtime_error("Truncated record in binary stream");
+        }
+
+        const auto taken = data_.first(size);
+        data_ = data_.subspan(size);
+        return taken;
+    }
+
+    gunblade::ffxiv::Endpoint read_endpoint()
+    {
+        const auto length = read<std::uint8_t>();
+        const auto host = take(length);
+        const auto port = read<std::uint16_t>();
+
+        return gunblade::ffxiv::Endpoint{std::string(host.begin(), host.end()), port};
+    }
+
+private:
+    std::span<const char> data_;
+};
+
+namespace gunblade::ffxiv::binary
+{
+    void write_stream_header(std::string& out)
+    {
+        out.append(stream_magic.data(), stream_magic.size());
+        append_raw(out, format_version);
+        append_raw(out, std::uint16_t{0});
+    }
+
+    void write_bundle_record(
+        std::string& out,
+        const Connection& connection,
+        unsigned long process_id,
+        const BundleView& bundle,
+        std::span<const SegmentView> segments)
+    {
+        // Leave room for the length, and fill it in once it's known
+        const auto start = out.size();
+        append_raw(out, std::uint32_t{0});
+        append_raw(out, RecordType::BUNDLE);
+
+        append_raw(out, bundle.header.epoch);
+        append_raw(out, static_cast<std::uint32_t>(process_id));
+        append_endpoint(out, connection.source);
+        append_endpoint(out, connection.destination);
+        append_raw(out, static_cast<std::uint16_t>(segments.size()));
+
+        for (const auto& segment : segments)
+        {
+            // Keep the header consistent with the data that's actually written
+            auto header = segment.header;
+            header.size = static_cast<std::uint32_t>(sizeof(header) + segment.data.size());
+
+            append_raw(out, header);
+            out.append(segment.data.data(), segment.data.size());
+        }
+
+        const auto length = static_cast<std::uint32_t>(out.size() - start - sizeof(std::uint32_t));
+        std::memcpy(out.data() + start, &length, sizeof(length));
+    }
+
+    Reader::Reader(std::istream& in) : in_(in)
+    {
+        std::array<char, 8> header;
+
+        if (!in_.read(header.data(), header.size()) ||
+            !std::equal(stream_magic.begin(), stream_magic.end(), header.begin()))
+        {
+            throw std::runtime_error("Not a Gunblade binary stream");
+        }
+
+        std::uint16_t version;
+        std::memcpy(&version, header.data() + stream_magic.size(), sizeof(version));
+
+        if (version != format_version)
+        {
+            throw std::runtime_error("Unsupported binary stream version");
+        }
+    }
+
+    bool Reader::next(BundleRecord& record)
+    {
+        while (true)
+        {
+            std::uint32_t length;
+
+            if (!in_.read(reinterpret_cast<char*>(&length), sizeof(length)))
+            {
+                // A clean end of stream falls exactly between records
+                if (in_.gcount() != 0)
+                {
+                    throw std::runtime_error("Truncated record in binary stream");
+                }
+
+                return false;
+            }
+
+            // Don't trust the length enough to allocate whatever it says
+            if (length > max_record_length)
+            {
+                throw std::runtime_error("Malformed record in binary stream");
+            }
+
+            buffer_.resize(length);
+
+            if (!in_.read(buffer_.data(), length))
+            {
+                throw std::runtime_error("Truncated record in binary stream");
+            }
+
+            RecordParser parser(buffer_);
+
+            // Skip anything that isn't a bundle
+            if (parser.read<RecordType>() != RecordType::BUNDLE)
+            {
+                continue;
+            }
+
+            record.epoch = parser.read<std::uint64_t>();
+            record.process_id = parser.read<std::uint32_t>();
+            record.connection.source = parser.read_endpoint();
+            record.connection.destination = parser.read_endpoint();
+
+            const auto count = parser.read<std::uint16_t>();
+            record.segments.clear();
+            record.segments.reserve(count);
+
+            for (std::uint16_t i = 0; i < count; ++i)
+            {
+                const auto header = parser.read<Segment::Header>();
+
+                if (header.size < sizeof(header) + header.min_data_size())
+                {
+                    throw std::runtime_error("Malformed segment in binary stream");
+                }
+
+                record.segments.push_back(SegmentView{header, parser.take(header.data_size())});
+            }
+
+            return true;
+        }
+    }
+
+    void write_json_line(std::string& out, const BundleRecord& record)
+    {
+        // Only the epoch of the bundle header is part of the JSON schema
+        BundleView bundle{};
+        bundle.header.epoch = record.epoch;
+
+        ffxiv::write_json_line(out, record.connection, record.process_id, bundle, record.segments);
+    }
+}  // namespace gunblade::ffxiv::binary
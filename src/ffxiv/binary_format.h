@@ -0,0 +1,120 @@
+#pragma once
+
+#include "inflater.h"
+#include "json_writer.h"
+#include "structs.h"
+
+#include <algorithm>  // max
+#include <array>      // array
+#include <cstddef>    // size_t
+#include <cstdint>    // uint8_t, uint16_t, uint32_t, uint64_t
+#include <istream>    // istream
+#include <span>       // span
+#include <string>     // string
+#include <vector>     // vector
+
+/**
+ * @file
+ * @brief A compact, versioned binary alternative to the JSON Lines output.
+ *
+ * A stream starts with a header (the magic "GBLD", then a 16-bit format
+ * version and 16 reserved bits), followed by any number of records. Every
+ * record starts with its 32-bit length (excluding the length itself) and
+ * 16-bit type. Bundle records then contain:
+ *
+ * - 64-bit bundle epoch
+ * - 32-bit process ID
+ * - source host (8-bit length, then that many bytes) and 16-bit port
+ * - destination host (8-bit length, then that many bytes) and 16-bit port
+ * - 16-bit segment count
+ * - each segment's raw `Segment::Header`, followed by its raw data (which,
+ *   for IPC segments, starts with the raw `IPC::Header`)
+ *
+ * Everything is little-endian. Readers must skip records of unknown types,
+ * but no record is longer than `max_record_length`.
+ */
+namespace gunblade::ffxiv::binary
+{
+    inline constexpr std::array<char, 4> stream_magic = {'G', 'B', 'L', 'D'};
+
+    inline constexpr std::uint16_t format_version = 1;
+
+    enum class RecordType : std::uint16_t
+    {
+        BUNDLE = 1
+    };
+
+    /**
+     * @brief The longest that a record can be, excluding its length.
+     *
+     * That's a bundle record with the longest hosts, holding the segments of
+     * the largest payload that a bundle can decompress to.
+     */
+    inline constexpr std::size_t max_record_length =
+        sizeof(RecordType) + sizeof(std::uint64_t) + sizeof(std::uint32_t) +
+        2 * (sizeof(std::uint8_t) + 255 + sizeof(std::uint16_t)) + sizeof(std::uint16_t) +
+        std::max(Bundle::max_length, Inflater::max_output_length);
+
+    /** @brief Appends the header that every binary stream starts with. */
+    void write_stream_header(std::string& out);
+
+    /**
+     * @brief Appends a bundle record.
+     *
+     * @param out The buffer to append to
+     * @param connection The connection that the bundle was sent over
+     * @param process_id The ID of the FFXIV process that owns the connection
+     * @param bundle The bundle to write
+     * @param segments The segments of @p bundle
+     */
+    void write_bundle_record(
+        std::string& out,
+        const Connection& connection,
+        unsigned long process_id,
+        const BundleView& bundle,
+        std::span<const SegmentView> segments);
+
+    /** @brief A bundle record, as read back from a binary stream. */
+    struct BundleRecord
+    {
+        Connection connection;
+        unsigned long process_id = 0;
+        std::uint64_t epoch = 0;
+
+        /** @brief The bundle's segments, pointing into the reader's buffer. */
+        std::vector<SegmentView> segments;
+    };
+
+    /** @brief Reads bundle records back from a binary stream. */
+    class Reader final
+    {
+    public:
+        /**
+         * @brief Starts reading a binary stream, checking its header.
+         *
+         * @throws std::runtime_error If the stream doesn't start with a header
+         * for a format version that this reader understands.
+         */
+        explicit Reader(std::istream& in);
+
+        /**
+         * @brief Reads the next bundle record, skipping records of other types.
+         *
+         * @param record Receives the record. Its segments are only valid
+         * until the next call.
+         * @return Whether a record was read, or the stream has ended.
+         * @throws std::runtime_error If the stream is truncated or malformed.
+         */
+        bool next(BundleRecord& record);
+
+    private:
+        std::istream& in_;
+        std::vector<char> buffer_;
+    };
+
+    /**
+     * @brief Appends a bundle record as a line of JSON, in the same schema
+     * as the JSON Lines output.
+     */
+    void write_json_line(std::string& out, const BundleRecord& record);
+}  // namespace gunblade::ffxiv::binary
@@ -1,26 +1,11 @@
 #include "decoder.h"
+#include "../trace.h"
+#include "magic_scanner.h"
 
-#include <algorithm>  // copy, search
+#include <algorithm>  // copy, max
 #include <array>      // array
 #include <bit>        // bit_cast
-#include <utility>    // move
-#include <iterator>   // distance
-
-// clang-format off
-static constexpr std::array<uint8_t, 16> magic_number {
-    0x52, 0x52, 0xa0, 0x41,  // 0x41a05252
-    0xff, 0x5d, 0x46, 0xe2,  // 0xe2465dff
-    0x7f, 0x2a, 0x64, 0x4d,  // 0x4d642a7f
-    0x7b, 0x99, 0xc4, 0x75   // 0x75c4997b
-};
-
-static constexpr std::array<uint8_t, 16> magic_number_keepalive {
-    0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00
-};
-// clang-format on
+#include <span>       // span
 
 template <typename T, typename InputIterator>
 static T read_struct(InputIterator begin)
@@ -32,67 +17,121 @@ static T read_struct(InputIterator begin)
 
 namespace gunblade
 {
-    std::optional<Bundle> FinalFantasyDecoder::next_bundle()
+    void FinalFantasyDecoder::compact() noexcept
     {
-        // Search for the IPC bundle magic number in the buffer
-        auto iter =
-            std::search(data_.cbegin(), data_.cend(), magic_number.cbegin(), magic_number.cend());
-
-        // Did we find the magic number in the buffer?
-        if (iter == data_.cend())
+        if (head_ == 0)
         {
-            // No - try searching for the keepalive bundle magic number instead
-            iter = std::search(
-                data_.cbegin(),
-                data_.cend(),
-                magic_number_keepalive.cbegin(),
-                magic_number_keepalive.cend());
-
-            // Did we find that instead?
-            if (iter == data_.cend())
-            {
-                // No - just return nothing. Don't trim the buffer because
-                // it might end with the start of a valid bundle.
-                return std::nullopt;
-            }
+            return;
         }
 
-        const auto remaining_length = std::distance(iter, data_.cend());
+        // Only the bytes after the head are still needed, so shift them down
+        data_.erase(data_.cbegin(), data_.cbegin() + head_);
+        scan_ -= head_;
+        head_ = 0;
+    }
 
-        // Is there enough data left to read an entire bundle header?
-        if (remaining_length < sizeof(Bundle::Header))
+    std::size_t FinalFantasyDecoder::resync() noexcept
+    {
+        if (head_ == data_.size())
         {
-            // No - trim everything in the buffer before the magic number,
-            // then return nothing.
-            data_.erase(data_.cbegin(), iter);
-            return std::nullopt;
+            return 0;
         }
 
-        // Read the *entire* header from the buffer
-        const auto bundle_header = read_struct<Bundle::Header>(iter);
+        // Search for the next magic number, skipping the one at the head (if any)
+        const auto from = head_ + 1;
+        const auto found = find_magic(data_.data() + from, data_.size() - from);
+
+        // Without one, only the last few bytes could still start a bundle
+        const auto tail = data_.size() > magic_length - 1 ? data_.size() - (magic_length - 1) : 0;
+        const auto next = found.has_value() ? from + *found : std::max(from, tail);
+
+        const auto dropped = next - head_;
+        head_ = scan_ = next;
 
-        // Is there enough data left to read the entire bundle? (not just its header)
-        if (remaining_length < bundle_header.length)
+        return dropped;
+    }
+
+    std::optional<Bundle> FinalFantasyDecoder::next_bundle()
+    {
+        const auto bundle = next_bundle_view();
+
+        if (!bundle.has_value())
         {
-            // No - trim everything in the buffer before the magic number,
-            // then return nothing.
-            data_.erase(data_.cbegin(), iter);
             return std::nullopt;
         }
 
-        // Get the bounds of the bundle payload
-        const auto payload_begin = iter + sizeof(bundle_header);
-        const auto payload_end = iter + bundle_header.length;
+        return bundle->to_owned();
+    }
+
+    std::optional<BundleView> FinalFantasyDecoder::next_bundle_view()
+    {
+        GUNBLADE_TRACE_SPAN("next_bundle");
+
+        while (true)
+        {
+            // Search for either bundle magic number, picking up where the last search ended
+            const auto found = find_magic(data_.data() + scan_, data_.size() - scan_);
+
+            // Did we find a magic number in the buffer?
+            if (!found.has_value())
+            {
+                // No - just return nothing. The buffer might end with the start
+                // of a valid bundle, but only its last few bytes could, so trim
+                // everything else rather than letting garbage pile up.
+                if (data_.size() - scan_ >= magic_length)
+                {
+                    head_ = scan_ = data_.size() - (magic_length - 1);
+                }
+
+                return std::nullopt;
+            }
+
+            const auto start = scan_ + *found;
+            const auto* bundle_begin = data_.data() + start;
+            const auto remaining_length = data_.size() - start;
+
+            // Is there enough data left to read an entire bundle header?
+            if (remaining_length < sizeof(Bundle::Header))
+            {
+                // No - trim everything in the buffer before the magic number,
+                // then return nothing.
+                head_ = scan_ = start;
+                return std::nullopt;
+            }
+
+            // Read the *entire* header from the buffer
+            const auto bundle_header = read_struct<Bundle::Header>(bundle_begin);
+
+            // Is the bundle long enough to hold its own header?
+            if (bundle_header.length < sizeof(Bundle::Header))
+            {
+                // No - it can't really be a bundle, so keep searching after it
+                scan_ = start + 1;
+                continue;
+            }
+
+            // Is there enough data left to read the entire bundle? (not just its header)
+            if (remaining_length < bundle_header.length)
+            {
+                // No - trim everything in the buffer before the magic number,
+                // then return nothing.
+                head_ = scan_ = start;
+                return std::nullopt;
+            }
 
-        // Create the bundle and set up its header and payload
-        Bundle bundle;
-        bundle.header = std::move(bundle_header);
-        bundle.payload.assign(payload_begin, payload_end);
+            // Get the bounds of the bundle payload
+            const auto* payload_begin =
+                reinterpret_cast<const char*>(bundle_begin + sizeof(bundle_header));
+            const auto payload_length = bundle_header.payload_length();
 
-        // Trim everything in the buffer before the magic number
-        data_.erase(data_.cbegin(), payload_end);
+            // Create a view of the bundle's header and payload
+            const BundleView bundle{bundle_header, std::span(payload_begin, payload_length)};
 
-        // Return the complete bundle
-        return bundle;
+            // Trim everything in the buffer up to the end of the bundle
+            head_ = scan_ = start + bundle_header.length;
+
+            // Return the complete bundle
+            return bundle;
+        }
     }
 }  // namespace gunblade
@@ -2,8 +2,10 @@
 
 #include "structs.h"
 
-#include <deque>
-#include <optional>
+#include <cstddef>          // size_t
+#include <memory_resource>  // get_default_resource, memory_resource
+#include <optional>         // optional
+#include <vector>           // vector
 
 namespace gunblade
 {
@@ -14,25 +16,65 @@ namespace gunblade
         using storage_type = uint8_t;
 
     public:
+        /** @param resource What to allocate the buffer from */
+        explicit FinalFantasyDecoder(
+            std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : data_(resource)
+        {
+            // Do nothing
+        }
+
         template <typename InputIterator>
         inline void feed_data(InputIterator first, InputIterator last)
         {
+            compact();
             data_.insert(data_.end(), first, last);
         }
 
         inline size_t size() const noexcept
         {
-            return data_.size();
+            return data_.size() - head_;
         }
 
         inline void clear() noexcept
         {
             data_.clear();
+            head_ = 0;
+            scan_ = 0;
         }
 
         std::optional<Bundle> next_bundle();
 
+        /**
+         * @brief Drops the buffered bytes up to the next magic number.
+         *
+         * Used to recover when the bundle at the front of the buffer can't be
+         * completed (such as after a burst of garbage that happens to contain a
+         * magic number), without giving up on the rest of the stream.
+         *
+         * @return The number of bytes dropped.
+         */
+        std::size_t resync() noexcept;
+
+        /**
+         * @brief Gets the next complete bundle without copying it out of the buffer.
+         *
+         * @return A view of the next bundle, which is only valid until
+         * more data is fed to the decoder (or it is cleared).
+         */
+        std::optional<BundleView> next_bundle_view();
+
     private:
-        std::deque<storage_type> data_;
+        /** @brief Moves the unconsumed bytes to the front of the buffer. */
+        void compact() noexcept;
+
+        /** @brief The buffered bytes. Only those from `head_` onwards are unconsumed. */
+        std::pmr::vector<storage_type> data_;
+
+        /** @brief The offset of the first unconsumed byte in `data_`. */
+        std::size_t head_ = 0;
+
+        /** @brief The offset in `data_` to resume searching for a magic number from. */
+        std::size_t scan_ = 0;
     };
 }  // namespace gunblade
@@ -0,0 +1,115 @@
+#include "inflater.h"
+
+#include <algorithm>  // copy, max, min
+#include <stdexcept>  // runtime_error
+#include <utility>    // move
+
+#include <zlib.h>
+
+// Accept both zlib and gzip headers (15 window bits, +32 for automatic detection)
+static constexpr int window_bits = 15 + 32;
+
+// Compressed bundles usually inflate to a few times their size, so
+// start there rather than growing the buffer a few times per bundle.
+static constexpr std::size_t expected_ratio = 4;
+static constexpr std::size_t min_capacity = 4096;
+
+static z_stream* new_stream()
+{
+    auto* stream = new z_stream{};
+
+    if (inflateInit2(stream, window_bits) != Z_OK)
+    {
+        delete stream;
+        throw std::runtime_error("inflateInit2 failed");
+    }
+
+    return stream;
+}
+
+namespace gunblade::ffxiv
+{
+    void Inflater::StreamDeleter::operator()(z_stream_s* stream) const noexcept
+    {
+        inflateEnd(stream);
+        delete stream;
+    }
+
+    Inflater::Inflater() : stream_(new_stream())
+    {
+        // Do nothing
+    }
+
+    Inflater::Inflater(const Inflater&) : Inflater()
+    {
+        // Do nothing
+    }
+
+    Inflater& Inflater::operator=(const Inflater&)
+    {
+        // Keep our own stream and buffer, there's nothing worth copying
+        return *this;
+    }
+
+    void Inflater::reserve(std::size_t size)
+    {
+        if (size <= capacity_)
+        {
+            return;
+        }
+
+        buffer_.reset(new char[size]);
+        capacity_ = size;
+    }
+
+    std::span<const char> Inflater::inflate(std::span<const char> input)
+    {
+        if (inflateReset(stream_.get()) != Z_OK)
+        {
+            throw std::runtime_error("inflateReset failed");
+        }
+
+        reserve(std::min(
+            std::max(input.size() * expected_ratio, min_capacity), max_output_length));
+
+        stream_->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream_->avail_in = static_cast<uInt>(input.size());
+
+        std::size_t produced = 0;
+
+        while (true)
+        {
+            stream_->next_out = reinterpret_cast<Bytef*>(buffer_.get() + produced);
+            stream_->avail_out = static_cast<uInt>(capacity_ - produced);
+
+            const auto ret = ::inflate(stream_.get(), Z_FINISH);
+            produced = capacity_ - stream_->avail_out;
+
+            if (ret != Z_STREAM_END && ret != Z_OK && ret != Z_BUF_ERROR)
+            {
+                throw std::runtime_error("Failed to inflate bundle payload");
+            }
+
+            // Stop once the stream ends, or zlib stops for any reason besides running out of room
+            if (ret == Z_STREAM_END || stream_->avail_out != 0)
+            {
+                break;
+            }
+
+            if (capacity_ >= max_output_length)
+            {
+                throw std::runtime_error("Inflated bundle payload is too large");
+            }
+
+            // Out of room - grow the buffer, keeping what was inflated so far
+            const auto new_capacity = std::min(capacity_ * 2, max_output_length);
+            std::unique_ptr<char[]> grown(new char[new_capacity]);
+            std::copy(buffer_.get(), buffer_.get() + produced, grown.get());
+
+            buffer_ = std::move(grown);
+            capacity_ = new_capacity;
+        }
+
+        return std::span<const char>(buffer_.get(), produced);
+    }
+}  // namespace gunblade::ffxiv
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>  // size_t
+#include <memory>   // unique_ptr
+#include <span>     // span
+
+struct z_stream_s;
+
+namespace gunblade::ffxiv
+{
+    /**
+     * @brief A long-lived zlib inflater that decompresses into a reusable buffer.
+     *
+     * The underlying stream is reset (not rebuilt) between payloads, and the
+     * output buffer only ever grows, so decompressing a steady stream of
+     * bundles does not allocate once the buffer has reached its working size.
+     */
+    class Inflater final
+    {
+    public:
+        /** @brief The largest payload that will be decompressed before giving up. */
+        static constexpr std::size_t max_output_length = 16 * 1024 * 1024;
+
+        Inflater();
+
+        /** @brief Creates a new inflater. Nothing but the type is shared with @p other. */
+        Inflater(const Inflater& other);
+
+        Inflater(Inflater&& other) noexcept = default;
+
+        ~Inflater() = default;
+
+        Inflater& operator=(const Inflater& other);
+
+        Inflater& operator=(Inflater&& other) noexcept = default;
+
+        /**
+         * @brief Decompresses a zlib (or gzip) compressed payload.
+         *
+         * @param input The compressed payload
+         * @return The decompressed payload, which is only valid until this
+         * inflater is used again.
+         * @throws std::runtime_error If the payload is corrupt, or
+         * decompresses to more than `max_output_length` bytes.
+         */
+        std::span<const char> inflate(std::span<const char> input);
+
+        /** @returns The size of the output buffer. */
+        inline std::size_t capacity() const noexcept
+        {
+            return capacity_;
+        }
+
+    private:
+        struct StreamDeleter final
+        {
+            void operator()(z_stream_s* stream) const noexcept;
+        };
+
+        /** @brief Grows the output buffer to at least @p size bytes, discarding its contents. */
+        void reserve(std::size_t size);
+
+        std::unique_ptr<z_stream_s, StreamDeleter> stream_;
+        std::unique_ptr<char[]> buffer_;
+        std::size_t capacity_ = 0;
+    };
+}  // namespace gunblade::ffxiv
@@ -0,0 +1,206 @@
+#include "json_writer.h"
+
+#include <array>        // array
+#include <charconv>     // to_chars
+#include <cstddef>      // size_t
+#include <cstdint>      // uint16_t
+#include <string_view>  // string_view
+#include <type_traits>  // is_unsigned_v
+
+static constexpr std::string_view base64_alphabet =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+template <typename Integer>
+static void append_number(std::string& out, Integer value)
+{
+    static_assert(std::is_unsigned_v<Integer>);
+
+    std::array<char, 20> digits;
+    const auto result = std::to_chars(digits.data(), digits.data() + digits.size(), value);
+    out.append(digits.data(), result.ptr);
+}
+
+/** @brief Appends a JSON string, escaped the same way as nlohmann::json. */
+static void append_string(std::string& out, std::string_view value)
+{
+    static constexpr std::string_view hex = "0123456789abcdef";
+
+    out.push_back('"');
+
+    for (const char c : value)
+    {
+        switch (c)
+        {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\b': out.append("\\b"); break;
+            case '\f': out.append("\\f"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    out.append("\\u00");
+                    out.push_back(hex[(c >> 4) & 0xf]);
+                    out.push_back(hex[c & 0xf]);
+                }
+                else
+                {
+                    out.push_back(c);
+                }
+        }
+    }
+
+    out.push_back('"');
+}
+
+static void append_endpoint(std::string& out, const gunblade::ffxiv::Endpoint& endpoint)
+{
+    out.append("{\"host\":");
+    append_string(out, endpoint.host);
+    out.append(",\"port\":");
+    append_number(out, endpoint.port);
+    out.push_back('}');
+}
+
+template <bool IsClient>
+static void append_keepalive(
+    std::string& out,
+    const gunblade::ffxiv::KeepAlive<IsClient>& keep_alive)
+{
+    out.append("{\"epoch\":");
+    append_number(out, keep_alive.epoch);
+    out.append(",\"id\":");
+    append_number(out, keep_alive.id);
+    out.push_back('}');
+}
+
+static void append_segment(std::string& out, const gunblade::ffxiv::SegmentView& segment)
+{
+    using gunblade::ffxiv::SegmentType;
+
+    // Keys are written in sorted order, to match nlohmann::json
+    out.push_back('{');
+
+    switch (segment.header.type)
+    {
+        case SegmentType::IPC:
+        {
+            const auto ipc = segment.ipc();
+
+            out.append("\"payload\":{\"data\":\"");
+            gunblade::ffxiv::append_base64(out, ipc.data);
+            out.append("\",\"epoch\":");
+            append_number(out, ipc.header.epoch);
+            out.append(",\"magic\":");
+            append_number(out, ipc.header.magic);
+            out.append(",\"serverId\":");
+            append_number(out, ipc.header.server_id);
+            out.append(",\"type\":");
+            append_number(out, ipc.header.type);
+            out.append("},");
+            break;
+        }
+
+        case SegmentType::CLIENT_KEEPALIVE:
+            out.append("\"payload\":");
+            append_keepalive(out, segment.keep_alive<gunblade::ffxiv::ClientKeepAlive>());
+            out.push_back(',');
+            break;
+
+        case SegmentType::SERVER_KEEPALIVE:
+            out.append("\"payload\":");
+            append_keepalive(out, segment.keep_alive<gunblade::ffxiv::ServerKeepAlive>());
+            out.push_back(',');
+            break;
+    }
+
+    out.append("\"source\":");
+    append_number(out, segment.header.source);
+    out.append(",\"target\":");
+    append_number(out, segment.header.target);
+    out.append(",\"type\":");
+    append_number(out, static_cast<std::uint16_t>(segment.header.type));
+    out.push_back('}');
+}
+
+namespace gunblade::ffxiv
+{
+    void append_base64(std::string& out, std::span<const char> data)
+    {
+        const auto* in = reinterpret_cast<const unsigned char*>(data.data());
+        const std::size_t size = data.size();
+
+        // Grow the output once, then encode straight into it
+        const auto offset = out.size();
+        out.resize(offset + ((size + 2) / 3) * 4);
+        char* dest = out.data() + offset;
+
+        std::size_t i = 0;
+
+        for (; i + 3 <= size; i += 3)
+        {
+            const unsigned int triple = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+
+            *dest++ = base64_alphabet[(triple >> 18) & 0x3f];
+            *dest++ = base64_alphabet[(triple >> 12) & 0x3f];
+            *dest++ = base64_alphabet[(triple >> 6) & 0x3f];
+            *dest++ = base64_alphabet[triple & 0x3f];
+        }
+
+        // Pad out whatever is left over
+        if (const auto remaining = size - i; remaining > 0)
+        {
+            const unsigned int triple = (in[i] << 16) | (remaining == 2 ? in[i + 1] << 8 : 0);
+
+            *dest++ = base64_alphabet[(triple >> 18) & 0x3f];
+            *dest++ = base64_alphabet[(triple >> 12) & 0x3f];
+            *dest++ = remaining == 2 ? base64_alphabet[(triple >> 6) & 0x3f] : '=';
+            *dest++ = '=';
+        }
+    }
+
+    void write_json_line(
+        std::string& out,
+        const Connection& connection,
+        unsigned long process_id,
+        const BundleView& bundle,
+        std::span<const SegmentView> segments,
+        const Timing* timing)
+    {
+        // Keys are written in sorted order, to match nlohmann::json
+        out.append("{\"bundle\":{\"epoch\":");
+        append_number(out, bundle.header.epoch);
+        out.append(",\"segments\":[");
+
+        for (std::size_t i = 0; i < segments.size(); ++i)
+        {
+            if (i > 0)
+            {
+                out.push_back(',');
+            }
+
+            append_segment(out, segments[i]);
+        }
+
+        out.append("]},\"connection\":{\"destination\":");
+        append_endpoint(out, connection.destination);
+        out.append(",\"source\":");
+        append_endpoint(out, connection.source);
+        out.append("},\"processId\":");
+        append_number(out, process_id);
+
+        if (timing)
+        {
+            out.append(",\"timing\":{\"capturedUs\":");
+            append_number(out, timing->captured_us);
+            out.append(",\"emittedUs\":");
+            append_number(out, timing->emitted_us);
+            out.push_back('}');
+        }
+
+        out.append("}\n");
+    }
+}  // namespace gunblade::ffxiv
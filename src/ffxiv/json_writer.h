@@ -0,0 +1,65 @@
+#pragma once
+
+#include "structs.h"
+
+#include <cstdint>  // uint16_t, uint64_t
+#include <span>     // span
+#include <string>   // string
+
+namespace gunblade::ffxiv
+{
+    /** @brief One end of the connection that a bundle was sent over. */
+    struct Endpoint
+    {
+        std::string host;
+        std::uint16_t port = 0;
+    };
+
+    /** @brief The connection that a bundle was sent over. */
+    struct Connection
+    {
+        Endpoint source;
+        Endpoint destination;
+    };
+
+    /** @brief When a bundle passed through the capture, to measure its latency with. */
+    struct Timing
+    {
+        /** @brief When the packet that completed the bundle was captured, in microseconds. */
+        std::uint64_t captured_us = 0;
+
+        /** @brief When the bundle was serialized, in microseconds. */
+        std::uint64_t emitted_us = 0;
+    };
+
+    /**
+     * @brief Appends the base64 encoding of @p data to @p out, encoding in place.
+     *
+     * Uses the standard alphabet, with padding.
+     */
+    void append_base64(std::string& out, std::span<const char> data);
+
+    /**
+     * @brief Appends a bundle to @p out as a line of JSON (https://jsonlines.org/).
+     *
+     * The output is byte-for-byte what `nlohmann::json::dump()` produces for the
+     * same record built with `to_json`, but is written straight into @p out
+     * without building a DOM, so reusing @p out avoids allocating at all.
+     *
+     * @param out The buffer to append to
+     * @param connection The connection that the bundle was sent over
+     * @param process_id The ID of the FFXIV process that owns the connection
+     * @param bundle The bundle to write
+     * @param segments The segments of @p bundle
+     * @param timing When to say the bundle was captured and serialized (both
+     * since the Unix epoch), as a `timing` object. Left out when null, which
+     * is the only case that matches `to_json`.
+     */
+    void write_json_line(
+        std::string& out,
+        const Connection& connection,
+        unsigned long process_id,
+        const BundleView& bundle,
+        std::span<const SegmentView> segments,
+        const Timing* timing = nullptr);
+}  // namespace gunblade::ffxiv
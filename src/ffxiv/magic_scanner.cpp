@@ -0,0 +1,146 @@
+#include "magic_scanner.h"
+
+#include <cstring>  // memcmp
+
+#if defined(__AVX2__)
+#define GUNBLADE_SCAN_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GUNBLADE_SCAN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// The scanner compares three bytes of each candidate position (first, middle
+// and last) against both magic numbers before falling back to a full compare.
+static constexpr std::size_t mid_index = 8;
+static constexpr std::size_t last_index = gunblade::ffxiv::magic_length - 1;
+
+static bool is_magic_at(const std::uint8_t* p) noexcept
+{
+    using namespace gunblade::ffxiv;
+
+    return std::memcmp(p, magic_number.data(), magic_length) == 0 ||
+           std::memcmp(p, magic_number_keepalive.data(), magic_length) == 0;
+}
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+
+static inline unsigned int count_trailing_zeros(unsigned int mask) noexcept
+{
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned int>(index);
+}
+#else
+static inline unsigned int count_trailing_zeros(unsigned int mask) noexcept
+{
+    return static_cast<unsigned int>(__builtin_ctz(mask));
+}
+#endif
+
+namespace gunblade::ffxiv
+{
+    std::optional<std::size_t> find_magic(const std::uint8_t* data, std::size_t size) noexcept
+    {
+        if (size < magic_length)
+        {
+            return std::nullopt;
+        }
+
+        // The last position at which a magic number could begin
+        const std::size_t last_start = size - magic_length;
+        std::size_t i = 0;
+
+#if defined(GUNBLADE_SCAN_AVX2)
+        constexpr std::size_t width = 32;
+
+        const auto bundle_first = _mm256_set1_epi8(static_cast<char>(magic_number[0]));
+        const auto bundle_mid = _mm256_set1_epi8(static_cast<char>(magic_number[mid_index]));
+        const auto bundle_last = _mm256_set1_epi8(static_cast<char>(magic_number[last_index]));
+        const auto zero = _mm256_setzero_si256();
+
+        for (; i + width - 1 <= last_start; i += width)
+        {
+            const auto first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            const auto mid =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + mid_index));
+            const auto last =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + last_index));
+
+            const auto bundle = _mm256_and_si256(
+                _mm256_and_si256(
+                    _mm256_cmpeq_epi8(first, bundle_first), _mm256_cmpeq_epi8(mid, bundle_mid)),
+                _mm256_cmpeq_epi8(last, bundle_last));
+            const auto keepalive = _mm256_and_si256(
+                _mm256_and_si256(_mm256_cmpeq_epi8(first, zero), _mm256_cmpeq_epi8(mid, zero)),
+                _mm256_cmpeq_epi8(last, zero));
+
+            auto mask = static_cast<unsigned int>(
+                _mm256_movemask_epi8(_mm256_or_si256(bundle, keepalive)));
+
+            while (mask != 0)
+            {
+                const auto offset = i + count_trailing_zeros(mask);
+
+                if (is_magic_at(data + offset))
+                {
+                    return offset;
+                }
+
+                mask &= mask - 1;
+            }
+        }
+#elif defined(GUNBLADE_SCAN_SSE2)
+        constexpr std::size_t width = 16;
+
+        const auto bundle_first = _mm_set1_epi8(static_cast<char>(magic_number[0]));
+        const auto bundle_mid = _mm_set1_epi8(static_cast<char>(magic_number[mid_index]));
+        const auto bundle_last = _mm_set1_epi8(static_cast<char>(magic_number[last_index]));
+        const auto zero = _mm_setzero_si128();
+
+        for (; i + width - 1 <= last_start; i += width)
+        {
+            const auto first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            const auto mid = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + mid_index));
+            const auto last =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + last_index));
+
+            const auto bundle = _mm_and_si128(
+                _mm_and_si128(_mm_cmpeq_epi8(first, bundle_first), _mm_cmpeq_epi8(mid, bundle_mid)),
+                _mm_cmpeq_epi8(last, bundle_last));
+            const auto keepalive = _mm_and_si128(
+                _mm_and_si128(_mm_cmpeq_epi8(first, zero), _mm_cmpeq_epi8(mid, zero)),
+                _mm_cmpeq_epi8(last, zero));
+
+            auto mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_or_si128(bundle, keepalive)));
+
+            while (mask != 0)
+            {
+                const auto offset = i + count_trailing_zeros(mask);
+
+                if (is_magic_at(data + offset))
+                {
+                    return offset;
+                }
+
+                mask &= mask - 1;
+            }
+        }
+#endif
+
+        // Check whatever is left over (or everything, without SIMD support)
+        for (; i <= last_start; ++i)
+        {
+            const auto first = data[i];
+
+            if ((first == magic_number[0] || first == magic_number_keepalive[0]) &&
+                is_magic_at(data + i))
+            {
+                return i;
+            }
+        }
+
+        return std::nullopt;
+    }
+}  // namespace gunblade::ffxiv
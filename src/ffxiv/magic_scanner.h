@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>     // array
+#include <cstddef>   // size_t
+#include <cstdint>   // uint8_t
+#include <optional>  // optional
+
+namespace gunblade::ffxiv
+{
+    // clang-format off
+    /** @brief The magic number at the start of every IPC bundle. */
+    inline constexpr std::array<std::uint8_t, 16> magic_number {
+        0x52, 0x52, 0xa0, 0x41,  // 0x41a05252
+        0xff, 0x5d, 0x46, 0xe2,  // 0xe2465dff
+        0x7f, 0x2a, 0x64, 0x4d,  // 0x4d642a7f
+        0x7b, 0x99, 0xc4, 0x75   // 0x75c4997b
+    };
+
+    /** @brief The magic number at the start of every keepalive bundle. */
+    inline constexpr std::array<std::uint8_t, 16> magic_number_keepalive {
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00
+    };
+    // clang-format on
+
+    /** @brief The length of both bundle magic numbers. */
+    inline constexpr std::size_t magic_length = magic_number.size();
+
+    /**
+     * @brief Finds the first occurrence of either bundle magic number.
+     *
+     * Both magic numbers are searched for in a single pass, using SSE2 or
+     * AVX2 when the target supports them.
+     *
+     * @param data The bytes to search
+     * @param size The number of bytes in @p data
+     * @return The offset of the first magic number in @p data, or nothing
+     * if neither magic number begins anywhere in @p data.
+     */
+    std::optional<std::size_t> find_magic(const std::uint8_t* data, std::size_t size) noexcept;
+}  // namespace gunblade::ffxiv
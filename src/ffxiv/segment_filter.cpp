@@ -0,0 +1,247 @@
+#include "segment_filter.h"
+
+#include <charconv>   // from_chars
+#include <limits>     // numeric_limits
+#include <stdexcept>  // invalid_argument
+#include <string>     // string
+
+#include <nlohmann/json.hpp>
+
+/** @brief Parses an unsigned number, in decimal or in hexadecimal with a "0x" prefix. */
+template <typename Integer>
+static Integer parse_number(std::string_view value, std::string_view what)
+{
+    auto digits = value;
+    auto base = 10;
+
+    if (digits.starts_with("0x") || digits.starts_with("0X"))
+    {
+        digits.remove_prefix(2);
+        base = 16;
+    }
+
+    Integer number = 0;
+    const auto [end, ec] =
+        std::from_chars(digits.data(), digits.data() + digits.size(), number, base);
+
+    if (digits.empty() || ec != std::errc() || end != digits.data() + digits.size())
+    {
+        throw std::invalid_argument(
+            std::string("Invalid ") + std::string(what) + ": \"" + std::string(value) + "\"");
+    }
+
+    return number;
+}
+
+/** @brief Reads a JSON number, or a string holding one. */
+template <typename Integer>
+static Integer read_number(const nlohmann::json& value, std::string_view what)
+{
+    if (value.is_string())
+    {
+        return parse_number<Integer>(value.get<std::string>(), what);
+    }
+
+    if (!value.is_number_unsigned() ||
+        value.get<std::uint64_t>() > std::numeric_limits<Integer>::max())
+    {
+        throw std::invalid_argument("Invalid " + std::string(what) + ": " + value.dump());
+    }
+
+    return value.get<Integer>();
+}
+
+/** @brief Calls @p read on each element of the array @p config[key], if there is one. */
+template <typename Read>
+static void for_each_element(const nlohmann::json& config, const char* key, Read read)
+{
+    const auto it = config.find(key);
+
+    if (it == config.end())
+    {
+        return;
+    }
+
+    if (!it->is_array())
+    {
+        throw std::invalid_argument(std::string("\"") + key + "\" must be an array");
+    }
+
+    for (const auto& element : *it)
+    {
+        read(element);
+    }
+}
+
+namespace gunblade::ffxiv
+{
+    bool FilterRules::empty() const noexcept
+    {
+        return segment_types.empty() && opcodes.empty() && !direction.has_value() &&
+               source_actors.empty() && target_actors.empty();
+    }
+
+    FilterRules read_filter_rules(std::istream& config)
+    {
+        const auto json = nlohmann::json::parse(config, nullptr, false);
+
+        if (!json.is_object())
+        {
+            throw std::invalid_argument("Filter config must be a JSON object");
+        }
+
+        FilterRules rules;
+
+        for_each_element(json, "segmentTypes", [&rules](const nlohmann::json& value) {
+            rules.segment_types.push_back(
+                value.is_string() ? parse_segment_type(value.get<std::string>())
+                                  : SegmentType(read_number<std::uint16_t>(value, "segment type")));
+        });
+
+        for_each_element(json, "opcodes", [&rules](const nlohmann::json& value) {
+            rules.opcodes.push_back(read_number<std::uint16_t>(value, "opcode"));
+        });
+
+        for_each_element(json, "sourceActors", [&rules](const nlohmann::json& value) {
+            rules.source_actors.push_back(read_number<std::uint32_t>(value, "actor ID"));
+        });
+
+        for_each_element(json, "targetActors", [&rules](const nlohmann::json& value) {
+            rules.target_actors.push_back(read_number<std::uint32_t>(value, "actor ID"));
+        });
+
+        if (const auto it = json.find("direction"); it != json.end())
+        {
+            if (!it->is_string())
+            {
+                throw std::invalid_argument("\"direction\" must be a string");
+            }
+
+            rules.direction = parse_direction(it->get<std::string>());
+        }
+
+        return rules;
+    }
+
+    SegmentType parse_segment_type(std::string_view value)
+    {
+        if (value == "ipc")
+        {
+            return SegmentType::IPC;
+        }
+        else if (value == "client-keepalive")
+        {
+            return SegmentType::CLIENT_KEEPALIVE;
+        }
+        else if (value == "server-keepalive")
+        {
+            return SegmentType::SERVER_KEEPALIVE;
+        }
+
+        return SegmentType(parse_number<std::uint16_t>(value, "segment type"));
+    }
+
+    Direction parse_direction(std::string_view value)
+    {
+        if (value == "client-to-server")
+        {
+            return Direction::CLIENT_TO_SERVER;
+        }
+        else if (value == "server-to-client")
+        {
+            return Direction::SERVER_TO_CLIENT;
+        }
+
+        throw std::invalid_argument(
+            "Direction must be \"client-to-server\" or \"server-to-client\", not \"" +
+            std::string(value) + "\"");
+    }
+
+    std::uint16_t parse_opcode(std::string_view value)
+    {
+        return parse_number<std::uint16_t>(value, "opcode");
+    }
+
+    std::uint32_t parse_actor_id(std::string_view value)
+    {
+        return parse_number<std::uint32_t>(value, "actor ID");
+    }
+
+    SegmentFilter::SegmentFilter(const FilterRules& rules) : direction_(rules.direction)
+    {
+        if (!rules.segment_types.empty())
+        {
+            segment_types_.emplace();
+
+            for (const auto type : rules.segment_types)
+            {
+                segment_types_->insert(static_cast<std::uint16_t>(type));
+            }
+        }
+
+        if (!rules.opcodes.empty())
+        {
+            opcodes_.emplace();
+
+            for (const auto opcode : rules.opcodes)
+            {
+                opcodes_->set(opcode);
+            }
+
+            // Only IPCs have opcodes, so don't keep anything else unless asked to
+            if (!segment_types_.has_value())
+            {
+                segment_types_.emplace({static_cast<std::uint16_t>(SegmentType::IPC)});
+            }
+        }
+
+        if (!rules.source_actors.empty())
+        {
+            source_actors_.emplace(rules.source_actors.begin(), rules.source_actors.end());
+        }
+
+        if (!rules.target_actors.empty())
+        {
+            target_actors_.emplace(rules.target_actors.begin(), rules.target_actors.end());
+        }
+    }
+
+    bool SegmentFilter::accepts(Direction direction) const noexcept
+    {
+        return !direction_.has_value() || *direction_ == direction;
+    }
+
+    bool SegmentFilter::accepts(const SegmentView& segment) const noexcept
+    {
+        const auto& header = segment.header;
+
+        if (segment_types_.has_value() &&
+            !segment_types_->contains(static_cast<std::uint16_t>(header.type)))
+        {
+            return false;
+        }
+
+        if (source_actors_.has_value() && !source_actors_->contains(header.source))
+        {
+            return false;
+        }
+
+        if (target_actors_.has_value() && !target_actors_->contains(header.target))
+        {
+            return false;
+        }
+
+        if (opcodes_.has_value() && header.type == SegmentType::IPC)
+        {
+            // Only the IPC header is needed, so don't bother if it isn't all there
+            if (segment.data.size() < sizeof(IPC::Header))
+            {
+                return false;
+            }
+
+            return opcodes_->test(segment.ipc().header.type);
+        }
+
+        return true;
+    }
+}  // namespace gunblade::ffxiv
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "structs.h"
+
+#include <bitset>         // bitset
+#include <cstdint>        // uint16_t, uint32_t
+#include <istream>        // istream
+#include <optional>       // optional
+#include <string_view>    // string_view
+#include <unordered_set>  // unordered_set
+#include <vector>         // vector
+
+namespace gunblade::ffxiv
+{
+    /** @brief Which way a flow's data is sent. */
+    enum class Direction
+    {
+        /** @brief Sent by the FFXIV client, to the server. */
+        CLIENT_TO_SERVER,
+
+        /** @brief Sent by the server, to the FFXIV client. */
+        SERVER_TO_CLIENT
+    };
+
+    /**
+     * @brief Describes which segments to decode.
+     *
+     * A segment is kept only if it passes every rule that is set, and an empty
+     * list (or no direction) places no restriction at all.
+     */
+    struct FilterRules
+    {
+        /** @brief The types of segment to keep. */
+        std::vector<SegmentType> segment_types;
+
+        /**
+         * @brief The IPC types (opcodes) to keep.
+         *
+         * When set, only IPC segments of these types are kept, so segments of
+         * any other type are dropped unless `segment_types` names them.
+         */
+        std::vector<std::uint16_t> opcodes;
+
+        /** @brief The direction of the flows to keep. */
+        std::optional<Direction> direction;
+
+        /** @brief The actor IDs that kept segments must be sent by. */
+        std::vector<std::uint32_t> source_actors;
+
+        /** @brief The actor IDs that kept segments must be sent to. */
+        std::vector<std::uint32_t> target_actors;
+
+        /** @returns Whether no rules are set, so that every segment is kept. */
+        bool empty() const noexcept;
+    };
+
+    /**
+     * @brief Reads filter rules from a JSON config file, such as:
+     *
+     *     {
+     *         "segmentTypes": ["ipc"],
+     *         "opcodes": [322, "0x1a4"],
+     *         "direction": "server-to-client",
+     *         "sourceActors": [],
+     *         "targetActors": []
+     *     }
+     *
+     * Every key is optional. Numbers may also be given as strings, in decimal
+     * or in hexadecimal with a "0x" prefix.
+     *
+     * @throws std::invalid_argument If the config is invalid.
+     */
+    FilterRules read_filter_rules(std::istream& config);
+
+    /**
+     * @returns The segment type named by @p value: "ipc", "client-keepalive",
+     * "server-keepalive" or a number.
+     * @throws std::invalid_argument If @p value is not a segment type.
+     */
+    SegmentType parse_segment_type(std::string_view value);
+
+    /**
+     * @returns The direction named by @p value: "client-to-server" or "server-to-client".
+     * @throws std::invalid_argument If @p value is not a direction.
+     */
+    Direction parse_direction(std::string_view value);
+
+    /**
+     * @returns The opcode in @p value, in decimal or in hexadecimal with a "0x" prefix.
+     * @throws std::invalid_argument If @p value is not a 16-bit number.
+     */
+    std::uint16_t parse_opcode(std::string_view value);
+
+    /**
+     * @returns The actor ID in @p value, in decimal or in hexadecimal with a "0x" prefix.
+     * @throws std::invalid_argument If @p value is not a 32-bit number.
+     */
+    std::uint32_t parse_actor_id(std::string_view value);
+
+    /**
+     * @brief Filter rules, compiled into lookup tables so that each segment is
+     * checked in constant time, before any of it is serialized.
+     */
+    class SegmentFilter final
+    {
+    public:
+        explicit SegmentFilter(const FilterRules& rules);
+
+        /**
+         * @returns Whether any of the data sent in @p direction could be kept.
+         * When it can't, the whole flow can be skipped without decoding it.
+         */
+        bool accepts(Direction direction) const noexcept;
+
+        /** @returns Whether @p segment should be kept. */
+        bool accepts(const SegmentView& segment) const noexcept;
+
+    private:
+        std::optional<Direction> direction_;
+
+        /** @brief Whether each segment type is kept, or nothing if they all are. */
+        std::optional<std::unordered_set<std::uint16_t>> segment_types_;
+
+        /** @brief Whether each IPC type is kept, or nothing if they all are. */
+        std::optional<std::bitset<65536>> opcodes_;
+
+        std::optional<std::unordered_set<std::uint32_t>> source_actors_;
+        std::optional<std::unordered_set<std::uint32_t>> target_actors_;
+    };
+}  // namespace gunblade::ffxiv
@@ -0,0 +1,57 @@
+#include "stream_decoder.h"
+
+namespace gunblade::ffxiv
+{
+    void StreamDecoder::push(std::span<const std::uint8_t> bytes)
+    {
+        decoder_.feed_data(bytes.begin(), bytes.end());
+    }
+
+    std::optional<DecodedBundle> StreamDecoder::pull()
+    {
+        using clock = std::chrono::steady_clock;
+
+        inflate_time_ = std::chrono::nanoseconds(0);
+
+        std::optional<BundleView> bundle;
+        while ((bundle = decoder_.next_bundle_view()).has_value())
+        {
+            // Only uncompressed payloads are free to get at, so only time the others
+            auto payload = bundle->payload;
+
+            if (bundle->header.is_compressed())
+            {
+                const auto started = clock::now();
+                payload = bundle->decompressed_payload(inflater_);
+                inflate_time_ += clock::now() - started;
+            }
+
+            // Reuse the segment buffer, rather than allocating a new one for every bundle
+            const auto segments = bundle->segments_view(payload);
+
+            if (!filter_)
+            {
+                segments_.assign(segments.begin(), segments.end());
+                return DecodedBundle{*bundle, segments_};
+            }
+
+            segments_.clear();
+
+            for (const auto& segment : segments)
+            {
+                if (filter_->accepts(segment))
+                {
+                    segments_.push_back(segment);
+                }
+            }
+
+            // Skip bundles that have nothing left to consume
+            if (!segments_.empty())
+            {
+                return DecodedBundle{*bundle, segments_};
+            }
+        }
+
+        return std::nullopt;
+    }
+}  // namespace gunblade::ffxiv
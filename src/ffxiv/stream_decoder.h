@@ -0,0 +1,116 @@
+#pragma once
+
+#include "decoder.h"
+#include "inflater.h"
+#include "segment_filter.h"
+#include "structs.h"
+
+#include <chrono>           // nanoseconds
+#include <cstddef>          // size_t
+#include <cstdint>          // uint8_t
+#include <memory>           // shared_ptr
+#include <memory_resource>  // get_default_resource, memory_resource
+#include <optional>         // optional
+#include <span>             // span
+#include <utility>          // move
+#include <vector>           // vector
+
+namespace gunblade::ffxiv
+{
+    /** @brief A bundle pulled from a `StreamDecoder`, ready to be consumed. */
+    struct DecodedBundle final
+    {
+        /** @brief The bundle, with its payload as it was received. */
+        BundleView bundle;
+
+        /** @brief The segments of the bundle, split from its decompressed payload. */
+        std::span<const SegmentView> segments;
+    };
+
+    /**
+     * @brief Decodes the bundles sent in one direction of a TCP stream.
+     *
+     * Bytes are pushed in as they arrive, in any fragments, and complete bundles
+     * are pulled out already decompressed and split into segments. This is the
+     * whole decoding pipeline for a flow, without any capture or output, so it
+     * can be embedded in other programs.
+     *
+     * Everything pulled out points into buffers owned by the decoder, which are
+     * reused rather than reallocated from one bundle to the next.
+     */
+    class StreamDecoder final
+    {
+    public:
+        /**
+         * @param filter Which segments to keep. Bundles left without any
+         * segments are skipped entirely. When null, every segment is kept.
+         * @param resource What to allocate the decoder's buffers from
+         */
+        explicit StreamDecoder(
+            std::shared_ptr<const SegmentFilter> filter = nullptr,
+            std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : filter_(std::move(filter)), decoder_(resource), segments_(resource)
+        {
+            // Do nothing
+        }
+
+        /**
+         * @brief Appends the next bytes of the stream.
+         *
+         * Invalidates the last bundle pulled out of this decoder.
+         */
+        void push(std::span<const std::uint8_t> bytes);
+
+        /**
+         * @brief Gets the next complete bundle in the stream that has any segments
+         * passing the filter.
+         *
+         * @return The next bundle, which is only valid until this decoder is used
+         * again, or nothing if more bytes need to be pushed first.
+         * @throws std::runtime_error If the bundle's payload is unable to be decompressed,
+         * or its segments don't fit in it. The bundle is skipped either way, so pulling
+         * again carries on with the next one.
+         */
+        std::optional<DecodedBundle> pull();
+
+        /**
+         * @returns How long the last call to `pull()` spent decompressing payloads,
+         * including those of any bundles that it skipped.
+         */
+        inline std::chrono::nanoseconds inflate_time() const noexcept
+        {
+            return inflate_time_;
+        }
+
+        /** @returns The number of bytes buffered, but not yet pulled out as bundles. */
+        inline std::size_t buffered() const noexcept
+        {
+            return decoder_.size();
+        }
+
+        /**
+         * @brief Drops the buffered bytes up to the next magic number, skipping
+         * whatever bundle was at the front of the buffer.
+         *
+         * @return The number of bytes dropped.
+         */
+        inline std::size_t resync() noexcept
+        {
+            return decoder_.resync();
+        }
+
+        /** @brief Discards all buffered bytes. */
+        inline void reset() noexcept
+        {
+            decoder_.clear();
+            segments_.clear();
+        }
+
+    private:
+        std::shared_ptr<const SegmentFilter> filter_;
+        FinalFantasyDecoder decoder_;
+        Inflater inflater_;
+        std::pmr::vector<SegmentView> segments_;
+        std::chrono::nanoseconds inflate_time_{0};
+    };
+}  // namespace gunblade::ffxiv
@@ -1,22 +1,37 @@
-#include "../tcp_table.h"
-#include "../utils.h"
-#include "decoder.h"
+#include "../connection_cache.h"
+#include "../tcp_reassembler.h"
+#include "../trace.h"
+#include "binary_format.h"
+#include "json_writer.h"
+#include "stream_decoder.h"
 #include "stream_handler.h"
 
-#include <iostream>
-
-#include <fmt/format.h>     // formatter
+#include <algorithm>        // any_of
+#include <array>            // array
+#include <chrono>           // duration_cast, microseconds, milliseconds, steady_clock, system_clock
+#include <cstddef>          // size_t
+#include <cstdint>          // int64_t, uint8_t, uint32_t, uint64_t
+#include <cstring>          // memcpy
+#include <memory>           // make_shared, make_unique, shared_ptr, unique_ptr
+#include <memory_resource>  // get_default_resource
+#include <optional>         // optional
+#include <span>             // span
+#include <stdexcept>        // runtime_error
+
+#include <fmt/format.h>     // format, formatter
 #include <spdlog/spdlog.h>  // info, warn
 
-#include <nlohmann/json.hpp>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
 
 using Tins::TCPIP::Flow;
 using Tins::TCPIP::Stream;
 using Tins::TCPIP::StreamFollower;
 
-using json = nlohmann::json;
+using gunblade::ffxiv::ffxiv_process_name;
+
 using TerminationReason = Tins::TCPIP::StreamFollower::TerminationReason;
-using pid_t = unsigned long;
+using process_id_t = unsigned long;
 
 template <>
 struct fmt::formatter<Tins::TCPIP::Stream> final
@@ -58,61 +73,124 @@ struct fmt::formatter<Tins::TCPIP::Stream> final
     }
 };
 
-static bool stream_matches(const gunblade::ConnectionInfo& info, const Stream& stream)
+static gunblade::ConnectionKey stream_key(const Stream& stream)
 {
-    // Are they even the same address family?
-    if (stream.is_v6() != info.is_v6())
+    if (stream.is_v6())
     {
-        return false;
+        return gunblade::make_connection_key(
+            stream.client_addr_v6(),
+            stream.client_port(),
+            stream.server_addr_v6(),
+            stream.server_port());
     }
+    else
+    {
+        return gunblade::make_connection_key(
+            stream.client_addr_v4(),
+            stream.client_port(),
+            stream.server_addr_v4(),
+            stream.server_port());
+    }
+}
 
-    bool local_port_is_client =
-        info.local_port == stream.client_port() && info.remote_port == stream.server_port();
-    bool local_port_is_server =
-        info.local_port == stream.server_port() && info.remote_port == stream.client_port();
+/**
+ * @brief Works out which FFXIV process (if any) owns a stream.
+ *
+ * Shared by the callbacks of both of the stream's flows, so that the
+ * connection table is only consulted once per stream.
+ */
+class StreamOwner final
+{
+public:
+    /** @brief Creates an owner that is already known to be the FFXIV process @p pid. */
+    explicit StreamOwner(process_id_t pid) : state_(State::FFXIV), pid_(pid)
+    {
+        // Do nothing
+    }
 
-    // Do the port numbers even match?
-    if (!local_port_is_client && !local_port_is_server)
+    /** @brief Creates an owner that is looked up in @p connections, by @p key. */
+    explicit StreamOwner(
+        std::shared_ptr<gunblade::ConnectionCache> connections,
+        const gunblade::ConnectionKey& key)
+        : state_(State::PENDING),
+          connections_(std::move(connections)),
+          key_(key),
+          first_seen_(gunblade::ConnectionCache::clock::now())
     {
-        return false;
+        // Do nothing
     }
 
-    if (info.is_v6())
+    /**
+     * @brief Looks up the owner of the stream, unless it is already known.
+     *
+     * @return Whether the owner is known now.
+     */
+    bool resolve()
     {
-        // Compare IPv6 addresses
-        return (local_port_is_client && info.local_addr_v6() == stream.client_addr_v6() &&
-                info.remote_addr_v6() == stream.server_addr_v6()) ||
-               (local_port_is_server && info.local_addr_v6() == stream.server_addr_v6() &&
-                info.remote_addr_v6() == stream.client_addr_v6());
+        using Status = gunblade::ConnectionCache::Status;
+
+        if (state_ != State::PENDING)
+        {
+            return true;
+        }
+
+        const auto lookup = connections_->find(key_, first_seen_);
+
+        switch (lookup.status)
+        {
+            case Status::FOUND:
+                pid_ = lookup.pid;
+                state_ = connections_->process_name(lookup.pid) == ffxiv_process_name
+                             ? State::FFXIV
+                             : State::OTHER;
+                return true;
+
+            case Status::NOT_FOUND:
+                state_ = State::OTHER;
+                return true;
+
+            case Status::STALE:
+            default:
+                return false;
+        }
     }
-    else
+
+    inline bool is_pending() const noexcept
     {
-        // Compare IPv4 addresses
-        return (local_port_is_client && info.local_addr_v4() == stream.client_addr_v4() &&
-                info.remote_addr_v4() == stream.server_addr_v4()) ||
-               (local_port_is_server && info.local_addr_v4() == stream.server_addr_v4() &&
-                info.remote_addr_v4() == stream.client_addr_v4());
+        return state_ == State::PENDING;
     }
-}
 
-static inline bool is_ffxiv_pid(pid_t pid)
-{
-    return gunblade::get_process_name(pid) == "ffxiv_dx11.exe";
-}
+    inline bool is_ffxiv() const noexcept
+    {
+        return state_ == State::FFXIV;
+    }
 
-static std::optional<pid_t> get_ffxiv_pid(const Stream& stream)
-{
-    // Look through all TCP connections
-    for (const auto& info : gunblade::get_tcp_table())
+    inline process_id_t pid() const noexcept
     {
-        if (stream_matches(info, stream) && is_ffxiv_pid(info.pid))
-        {
-            return info.pid;
-        }
+        return pid_;
     }
 
-    // Didn't find a connection that both matches and is from an FFXIV process
-    return std::nullopt;
+private:
+    enum class State
+    {
+        PENDING,
+        FFXIV,
+        OTHER
+    };
+
+    State state_;
+    process_id_t pid_ = 0;
+
+    std::shared_ptr<gunblade::ConnectionCache> connections_;
+    gunblade::ConnectionKey key_;
+    gunblade::ConnectionCache::clock::time_point first_seen_;
+};
+
+/** @returns The time since the Unix epoch, to compare with when packets were captured. */
+static std::chrono::microseconds wall_clock_now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch());
 }
 
 template <typename T>
@@ -133,85 +211,516 @@ static std::string addr_to_string(const Flow& flow)
     }
 }
 
-class DataCallback final
+/** @returns @p addr as a string, formatted just like libtins formats addresses. */
+static std::string addr_to_string(const std::array<std::uint8_t, 16>& addr, bool is_v6)
+{
+    if (is_v6)
+    {
+        return Tins::IPv6Address(addr.data()).to_string();
+    }
+    else
+    {
+        // libtins keeps IPv4 addresses as integers made straight from their bytes
+        std::uint32_t raw;
+        std::memcpy(&raw, addr.data(), sizeof(raw));
+        return Tins::IPv4Address(raw).to_string();
+    }
+}
+
+/** @returns The connection that @p flow's data is sent over. */
+static gunblade::ffxiv::Connection flow_connection(Stream& stream, const Flow& flow)
+{
+    const auto& source_flow =
+        is_same(flow, stream.client_flow()) ? stream.server_flow() : stream.client_flow();
+
+    return gunblade::ffxiv::Connection{
+        {addr_to_string(source_flow), source_flow.dport()},
+        {addr_to_string(flow), flow.dport()}};
+}
+
+/**
+ * @brief Decodes the bundles sent over one direction of a stream, and writes them out.
+ *
+ * Knows nothing about how the stream was reassembled, so that it can be fed by
+ * either libtins' stream follower or `TcpReassembler`. Data can be decoded as
+ * soon as it arrives, or buffered and decoded once per batch of packets.
+ */
+class FlowDecoder final
 {
 public:
-    explicit DataCallback(Flow& flow, std::string name, pid_t pid)
-        : flow_(flow), name_(std::move(name)), pid_(pid)
+    /**
+     * @param connection The connection that the flow's data is sent over
+     * @param name The name of the flow, to log
+     * @param stream The stream that the flow is part of, to log
+     * @param owner The owner of the stream, shared with the stream's other flow
+     * @param options How to decode the flow, and where to write it to
+     */
+    explicit FlowDecoder(
+        gunblade::ffxiv::Connection connection,
+        std::string name,
+        std::string stream,
+        std::shared_ptr<StreamOwner> owner,
+        const gunblade::ffxiv::FollowerOptions& options)
+        : arena_(options.arena),
+          decoder_(
+              options.filter,
+              arena_ ? arena_->resource() : std::pmr::get_default_resource()),
+          memory_(
+              options.memory ? std::make_shared<gunblade::MemoryBudget::Flow>(options.memory)
+                             : nullptr),
+          metrics_(options.metrics),
+          connection_(std::move(connection)),
+          name_(std::move(name)),
+          stream_(std::move(stream)),
+          owner_(std::move(owner)),
+          priority_(options.priority),
+          output_(*options.output),
+          format_(options.format),
+          write_timestamps_(options.write_timestamps),
+          measure_latency_(options.measure_latency),
+          max_buffer_(options.max_flow_buffer)
     {
         // Do nothing
     }
 
-    void operator()(Stream& stream)
+    // A copy would allocate from the default resource rather than the arena, and account
+    // for the same buffered bytes twice
+    FlowDecoder(const FlowDecoder&) = delete;
+    FlowDecoder& operator=(const FlowDecoder&) = delete;
+
+    /**
+     * @brief Decodes and writes every bundle that @p payload completes.
+     *
+     * @return Whether to keep decoding the stream. Once it turns out that the
+     * stream doesn't belong to FFXIV, this returns false.
+     */
+    bool push(std::span<const std::uint8_t> payload)
     {
-        const auto& payload = flow_.payload();
-        decoder_.feed_data(payload.cbegin(), payload.cend());
+        if (!buffer(payload))
+        {
+            return false;
+        }
+
+        decode();
+        return true;
+    }
 
-        // Handle all bundles using the decoder
-        std::optional<gunblade::Bundle> bundle;
-        while ((bundle = decoder_.next_bundle()).has_value())
+    /**
+     * @brief Buffers @p payload, to be decoded by the next `decode()`.
+     *
+     * @return Whether to keep decoding the stream, just like `push()`.
+     */
+    bool buffer(std::span<const std::uint8_t> payload)
+    {
+        GUNBLADE_TRACE_SPAN("buffer_flow");
+
+        decoder_.push(payload);
+
+        if (metrics_)
         {
-            const auto& source_flow =
-                is_same(flow_, stream.client_flow()) ? stream.server_flow() : stream.client_flow();
+            metrics_->add_reassembled(payload.size());
+        }
 
-            // clang-format off
-            json obj = {
-                {"connection", {
-                    {"source", {
-                        {"host", addr_to_string(source_flow)},
-                        {"port", source_flow.dport()}
-                    }},
-                    {"destination", {
-                        {"host", addr_to_string(flow_)},
-                        {"port", flow_.dport()}
-                    }},
-                }},
-                {"processId", pid_},
-                {"bundle", *bundle}
-            };
-            // clang-format on
+        // Keep buffering data until it's known whether the stream belongs to FFXIV
+        const bool was_pending = owner_->is_pending();
 
-            // Write the JSON object to stdout - https://jsonlines.org/
-            std::cout << obj.dump() << std::endl;
+        if (owner_->resolve())
+        {
+            if (!owner_->is_ffxiv())
+            {
+                spdlog::debug("Stream {} is not an FFXIV stream, ignoring it", stream_);
+
+                decoder_.reset();
+
+                if (memory_)
+                {
+                    memory_->set_buffered(0);
+                }
+
+                return false;
+            }
+
+            if (was_pending)
+            {
+                spdlog::info("FFXIV stream detected: {} (pid = {})", stream_, owner_->pid());
+            }
         }
 
-        // Don't let the decoder buffer data forever, stop it once
-        // it reaches a critical length of 2 max-sized bundles.
-        if (decoder_.size() > (2 * gunblade::ffxiv::Bundle::max_length))
+        return true;
+    }
+
+    /** @brief Decodes and writes every bundle that's been buffered. */
+    void decode()
+    {
+        GUNBLADE_TRACE_SPAN("decode_flow");
+
+        if (owner_->is_ffxiv())
+        {
+            decode_bundles();
+        }
+
+        // Don't let the decoder buffer data forever. Rather than giving up on the
+        // flow, drop bytes up to the next magic number and carry on from there.
+        std::size_t dropped = 0;
+
+        while (decoder_.buffered() > 0 && is_over_limit())
         {
-            spdlog::warn("Flow {} buffered too much data without a bundle, ignoring it", name_);
+            dropped += decoder_.resync();
+
+            if (memory_)
+            {
+                memory_->count_resync();
+            }
+
+            if (owner_->is_ffxiv())
+            {
+                decode_bundles();
+            }
+        }
 
-            flow_.ignore_data_packets();
-            decoder_.clear();
+        if (dropped > 0)
+        {
+            spdlog::warn("Flow {} buffered too much data, dropped {} bytes to resync", name_, dropped);
         }
     }
 
 private:
-    gunblade::FinalFantasyDecoder decoder_;
-    Flow& flow_;
+    void decode_bundles()
+    {
+        using clock = std::chrono::steady_clock;
+
+        // Handle all bundles using the decoder, without copying them out of its buffers
+        std::optional<gunblade::ffxiv::DecodedBundle> decoded;
+        while ((decoded = pull_bundle()).has_value())
+        {
+            const auto started = metrics_ ? clock::now() : clock::time_point();
+            serialize(*decoded);
+
+            if (metrics_)
+            {
+                metrics_->count_bundle(decoded->bundle, decoded->segments);
+                metrics_->record_output(records_.size(), clock::now() - started);
+                record_timing(decoded->bundle);
+            }
+
+            // Write each bundle on its own, with its timestamp, so it can be put in order
+            output_.write(records_, decoded->bundle.header.epoch, is_priority(decoded->segments));
+            records_.clear();
+        }
+    }
+
+    /** @brief Appends @p decoded to the records to write, in the output format. */
+    void serialize(const gunblade::ffxiv::DecodedBundle& decoded)
+    {
+        GUNBLADE_TRACE_SPAN("serialize");
+
+        switch (format_)
+        {
+            case gunblade::OutputFormat::JSON_LINES:
+            {
+                gunblade::ffxiv::Timing timing;
+
+                if (write_timestamps_)
+                {
+                    timing.captured_us = static_cast<std::uint64_t>(output_.capture_time().count());
+                    timing.emitted_us = static_cast<std::uint64_t>(wall_clock_now().count());
+                }
+
+                // Serialize each bundle as a line of JSON - https://jsonlines.org/
+                gunblade::ffxiv::write_json_line(
+                    records_,
+                    connection_,
+                    owner_->pid(),
+                    decoded.bundle,
+                    decoded.segments,
+                    write_timestamps_ ? &timing : nullptr);
+                break;
+            }
+
+            case gunblade::OutputFormat::BINARY:
+                gunblade::ffxiv::binary::write_bundle_record(
+                    records_,
+                    connection_,
+                    owner_->pid(),
+                    decoded.bundle,
+                    decoded.segments);
+                break;
+        }
+    }
+
+    /** @brief Records how long ago the packet that completed @p bundle was captured and sent. */
+    void record_timing(const gunblade::ffxiv::BundleView& bundle)
+    {
+        const auto captured = output_.capture_time();
+
+        if (captured.count() <= 0)
+        {
+            return;
+        }
+
+        // The epoch is from the sender's clock, so this includes any skew between the clocks
+        const auto sent = std::chrono::milliseconds(static_cast<std::int64_t>(bundle.header.epoch));
+        metrics_->record_transit(captured - sent);
+
+        if (measure_latency_)
+        {
+            metrics_->record_latency(wall_clock_now() - captured);
+        }
+    }
+
+    /** @returns Whether any of @p segments makes their record worth keeping over others. */
+    bool is_priority(std::span<const gunblade::ffxiv::SegmentView> segments) const noexcept
+    {
+        return priority_ &&
+               std::any_of(segments.begin(), segments.end(), [this](const auto& segment) {
+                   return priority_->accepts(segment);
+               });
+    }
 
+    /** @returns Whether this flow is buffering more than it's allowed to. */
+    bool is_over_limit()
+    {
+        const auto buffered = decoder_.buffered();
+        const bool over_budget = memory_ && memory_->set_buffered(buffered);
+
+        return over_budget || buffered > max_buffer_;
+    }
+
+    /** @returns The next bundle that can be decoded, skipping any malformed ones. */
+    std::optional<gunblade::ffxiv::DecodedBundle> pull_bundle()
+    {
+        while (true)
+        {
+            try
+            {
+                auto decoded = decoder_.pull();
+
+                if (metrics_ && decoder_.inflate_time().count() > 0)
+                {
+                    metrics_->record_inflate(decoder_.inflate_time());
+                }
+
+                return decoded;
+            }
+            catch (const std::runtime_error& e)
+            {
+                spdlog::warn("Flow {} sent a malformed bundle, skipping it: {}", name_, e.what());
+
+                if (metrics_)
+                {
+                    metrics_->count_malformed();
+                }
+            }
+        }
+    }
+
+    /** @brief Where the decoder's buffers come from, which must outlive them. */
+    std::shared_ptr<gunblade::DecodeArena> arena_;
+
+    gunblade::ffxiv::StreamDecoder decoder_;
+    std::shared_ptr<gunblade::MemoryBudget::Flow> memory_;
+    std::shared_ptr<gunblade::Metrics::Shard> metrics_;
+    std::string records_;
+
+    const gunblade::ffxiv::Connection connection_;
     const std::string name_;
-    const pid_t pid_;
+    const std::string stream_;
+    const std::shared_ptr<StreamOwner> owner_;
+    const std::shared_ptr<const gunblade::ffxiv::SegmentFilter> priority_;
+    gunblade::RecordWriter& output_;
+    const gunblade::OutputFormat format_;
+    const bool write_timestamps_;
+    const bool measure_latency_;
+    const std::size_t max_buffer_;
+};
+
+/**
+ * @brief Decodes one of the flows of a stream followed by libtins.
+ *
+ * libtins stores a copy of the callback, so every copy shares the one decoder,
+ * which keeps allocating from the arena it was made with.
+ */
+class DataCallback final
+{
+public:
+    explicit DataCallback(
+        Stream& stream,
+        Flow& flow,
+        std::string name,
+        std::shared_ptr<StreamOwner> owner,
+        const gunblade::ffxiv::FollowerOptions& options)
+        : decoder_(std::make_shared<FlowDecoder>(
+              flow_connection(stream, flow),
+              std::move(name),
+              fmt::format("{}", stream),
+              std::move(owner),
+              options)),
+          flow_(flow)
+    {
+        // Do nothing
+    }
+
+    void operator()(Stream& stream)
+    {
+        if (!decoder_->push(flow_.payload()))
+        {
+            stream.ignore_client_data();
+            stream.ignore_server_data();
+        }
+    }
+
+private:
+    std::shared_ptr<FlowDecoder> decoder_;
+    Flow& flow_;
+};
+
+/** @brief Decodes both flows of a stream reassembled by `TcpReassembler`. */
+class ReassembledStream final : public gunblade::TcpStreamHandler
+{
+public:
+    /**
+     * @param endpoints The two ends of the stream
+     * @param stream The stream, to log
+     * @param owner The owner of the stream
+     * @param options How to decode the stream, and where to write it to
+     * @param client Whether to decode the data that the client sends
+     * @param server Whether to decode the data that the server sends
+     */
+    explicit ReassembledStream(
+        const gunblade::TcpEndpoints& endpoints,
+        const std::string& stream,
+        const std::shared_ptr<StreamOwner>& owner,
+        const gunblade::ffxiv::FollowerOptions& options,
+        bool client,
+        bool server)
+    {
+        const gunblade::ffxiv::Endpoint client_end{
+            addr_to_string(endpoints.client_addr, endpoints.is_v6),
+            endpoints.client_port};
+        const gunblade::ffxiv::Endpoint server_end{
+            addr_to_string(endpoints.server_addr, endpoints.is_v6),
+            endpoints.server_port};
+
+        if (client)
+        {
+            client_.emplace(
+                gunblade::ffxiv::Connection{client_end, server_end},
+                "client",
+                stream,
+                owner,
+                options);
+        }
+
+        if (server)
+        {
+            server_.emplace(
+                gunblade::ffxiv::Connection{server_end, client_end},
+                "server",
+                stream,
+                owner,
+                options);
+        }
+    }
+
+    bool on_data(bool from_client, std::span<const std::uint8_t> data) override
+    {
+        // Data sent the way that isn't being decoded is still reassembled, and dropped here
+        auto& decoder = from_client ? client_ : server_;
+        return !decoder.has_value() || decoder->buffer(data);
+    }
+
+    void on_batch_end() override
+    {
+        // Everything the batch completed is decoded and written out in one go
+        if (client_)
+        {
+            client_->decode();
+        }
+
+        if (server_)
+        {
+            server_->decode();
+        }
+    }
+
+private:
+    std::optional<FlowDecoder> client_;
+    std::optional<FlowDecoder> server_;
 };
 
+/** @returns The key to look up the owner of the connection between @p endpoints with. */
+static gunblade::ConnectionKey endpoints_key(const gunblade::TcpEndpoints& endpoints)
+{
+    gunblade::ConnectionKey key;
+    key.local_addr = endpoints.client_addr;
+    key.remote_addr = endpoints.server_addr;
+    key.local_port = endpoints.client_port;
+    key.remote_port = endpoints.server_port;
+    key.is_v6 = endpoints.is_v6;
+
+    return key;
+}
+
 namespace gunblade::ffxiv
 {
-    static void on_new_stream(Stream& stream)
+    /** @returns Whether any data sent in @p direction would be kept by the filter. */
+    static bool accepts(const FollowerOptions& options, Direction direction)
+    {
+        return !options.filter || options.filter->accepts(direction);
+    }
+
+    /** @returns The owner of a new stream, to be looked up by @p key if there are connections. */
+    static std::shared_ptr<StreamOwner> make_owner(
+        const FollowerOptions& options,
+        const ConnectionKey& key)
+    {
+        // Without a connection table to match against, the process ID is reported as 0
+        return options.connections ? std::make_shared<StreamOwner>(options.connections, key)
+                                   : std::make_shared<StreamOwner>(0);
+    }
+
+    static void on_new_stream(Stream& stream, const FollowerOptions& options)
     {
-        auto pid = get_ffxiv_pid(stream);
+        const auto owner = make_owner(options, stream_key(stream));
 
-        if (!pid.has_value())
+        if (!owner->resolve())
+        {
+            // The connection table was read too recently to look at it again,
+            // so try again once the stream has some data.
+            spdlog::debug("Owner of stream {} is not known yet", stream);
+        }
+        else if (!owner->is_ffxiv())
         {
             // The stream doesn't refer to a connection opened by an FFXIV client
             stream.ignore_client_data();
             stream.ignore_server_data();
             return;
         }
+        else
+        {
+            spdlog::info("FFXIV stream detected: {} (pid = {})", stream, owner->pid());
+        }
 
-        spdlog::info("FFXIV stream detected: {} (pid = {})", stream, *pid);
+        // Don't decode either direction at all if none of its segments would be kept
+        if (accepts(options, Direction::CLIENT_TO_SERVER))
+        {
+            stream.client_data_callback(
+                DataCallback(stream, stream.client_flow(), "client", owner, options));
+        }
+        else
+        {
+            stream.ignore_client_data();
+        }
 
-        stream.client_data_callback(DataCallback(stream.client_flow(), "client", *pid));
-        stream.server_data_callback(DataCallback(stream.server_flow(), "server", *pid));
+        if (accepts(options, Direction::SERVER_TO_CLIENT))
+        {
+            stream.server_data_callback(
+                DataCallback(stream, stream.server_flow(), "server", owner, options));
+        }
+        else
+        {
+            stream.ignore_server_data();
+        }
     }
 
     static void on_stream_termination(Stream& stream, TerminationReason reason)
@@ -220,10 +729,60 @@ namespace gunblade::ffxiv
         spdlog::warn("Stream terminated: {} (why: {})", stream, reason);
     }
 
-    void setup_follower(StreamFollower& follower)
+    static std::unique_ptr<TcpStreamHandler> on_new_reassembled_stream(
+        const TcpEndpoints& endpoints,
+        const FollowerOptions& options)
+    {
+        const auto stream = fmt::format(
+            "{}:{} <-> {}:{}",
+            addr_to_string(endpoints.client_addr, endpoints.is_v6),
+            endpoints.client_port,
+            addr_to_string(endpoints.server_addr, endpoints.is_v6),
+            endpoints.server_port);
+
+        const auto owner = make_owner(options, endpoints_key(endpoints));
+
+        if (!owner->resolve())
+        {
+            spdlog::debug("Owner of stream {} is not known yet", stream);
+        }
+        else if (!owner->is_ffxiv())
+        {
+            return nullptr;
+        }
+        else
+        {
+            spdlog::info("FFXIV stream detected: {} (pid = {})", stream, owner->pid());
+        }
+
+        const bool client = accepts(options, Direction::CLIENT_TO_SERVER);
+        const bool server = accepts(options, Direction::SERVER_TO_CLIENT);
+
+        if (!client && !server)
+        {
+            return nullptr;
+        }
+
+        return std::make_unique<ReassembledStream>(
+            endpoints,
+            stream,
+            owner,
+            options,
+            client,
+            server);
+    }
+
+    void setup_follower(StreamFollower& follower, const FollowerOptions& options)
     {
         follower.follow_partial_streams(true);
-        follower.new_stream_callback(on_new_stream);
+        follower.new_stream_callback([options](Stream& stream) { on_new_stream(stream, options); });
         follower.stream_termination_callback(on_stream_termination);
     }
+
+    void setup_reassembler(TcpReassembler& reassembler, const FollowerOptions& options)
+    {
+        reassembler.new_stream_callback([options](const TcpEndpoints& endpoints) {
+            return on_new_reassembled_stream(endpoints, options);
+        });
+    }
 }  // namespace gunblade::ffxiv
@@ -1,8 +1,98 @@
 #pragma once
 
+#include "../connection_cache.h"
+#include "../decode_arena.h"
+#include "../memory_budget.h"
+#include "../metrics.h"
+#include "../output.h"
+#include "../tcp_reassembler.h"
+#include "segment_filter.h"
+#include "structs.h"
+
+#include <cstddef>  // size_t
+#include <memory>   // shared_ptr
+
 #include <tins/tcp_ip/stream_follower.h>
 
 namespace gunblade::ffxiv
 {
-    void setup_follower(Tins::TCPIP::StreamFollower& follower);
+    /** @brief The name of the FFXIV client process, which owns every stream worth decoding. */
+    inline constexpr auto ffxiv_process_name = "ffxiv_dx11.exe";
+
+    /** @brief Controls which streams a follower decodes. */
+    struct FollowerOptions
+    {
+        /**
+         * @brief The connections to look up the owners of streams in, so that only
+         * those owned by an FFXIV process are decoded.
+         *
+         * When null (such as when replaying a capture, which has no connection
+         * table to look streams up in), every stream is decoded.
+         */
+        std::shared_ptr<ConnectionCache> connections;
+
+        /** @brief Where to write decoded bundles to. Must outlive the follower. */
+        RecordWriter* output = nullptr;
+
+        /** @brief The format to write decoded bundles in. */
+        OutputFormat format = OutputFormat::JSON_LINES;
+
+        /**
+         * @brief Whether to write when each bundle was captured and serialized
+         * along with it. Only JSON Lines records have room for the timestamps.
+         */
+        bool write_timestamps = false;
+
+        /**
+         * @brief Whether to measure how long after its packet was captured each
+         * bundle was serialized, in `metrics`. Only meaningful for live captures.
+         */
+        bool measure_latency = false;
+
+        /** @brief Which segments to write. When null, every segment is written. */
+        std::shared_ptr<const SegmentFilter> filter;
+
+        /**
+         * @brief Which segments make a record worth keeping over others, when
+         * output has to be dropped. When null, no records are.
+         */
+        std::shared_ptr<const SegmentFilter> priority;
+
+        /**
+         * @brief The budget that every flow's buffered bytes count against. Flows
+         * drop bytes to resynchronize while it's exceeded. When null, only
+         * `max_flow_buffer` applies.
+         */
+        std::shared_ptr<MemoryBudget> memory;
+
+        /**
+         * @brief The arena that the follower's flows allocate their buffers from.
+         * Must only be used by this follower. When null, they use the heap.
+         */
+        std::shared_ptr<DecodeArena> arena;
+
+        /**
+         * @brief What to count the follower's work in. Must only be used by this
+         * follower. When null, nothing is counted.
+         */
+        std::shared_ptr<Metrics::Shard> metrics;
+
+        /**
+         * @brief The most bytes that one flow may buffer without completing a
+         * bundle, before dropping bytes to resynchronize.
+         */
+        std::size_t max_flow_buffer = 2 * Bundle::max_length;
+    };
+
+    void setup_follower(
+        Tins::TCPIP::StreamFollower& follower,
+        const FollowerOptions& options = FollowerOptions());
+
+    /**
+     * @brief Sets up @p reassembler to decode streams just like `setup_follower()`
+     * sets up a stream follower to, for replays that skip libtins.
+     */
+    void setup_reassembler(
+        TcpReassembler& reassembler,
+        const FollowerOptions& options = FollowerOptions());
 }  // namespace gunblade::ffxiv
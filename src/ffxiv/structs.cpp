@@ -1,16 +1,17 @@
 #include "structs.h"
+#include "../trace.h"
+#include "inflater.h"
+#include "json_writer.h"
 
 #include <array>        // array
+#include <bit>          // bit_cast
+#include <iterator>     // forward_iterator
+#include <ranges>       // forward_range
 #include <stdexcept>    // runtime_error
+#include <string>       // string
 #include <type_traits>  // is_standard_layout_v
 #include <utility>      // copy
 
-#include <cpp-base64/base64.h>  // base64_encode
-
-#pragma warning(push)
-#pragma warning(disable : 4068)
-#include <gzip/decompress.hpp>
-#pragma warning(pop)
 
 template <typename T, typename InputIterator>
 static T read_struct(InputIterator begin)  // TODO: Deduplicate
@@ -20,6 +21,13 @@ static T read_struct(InputIterator begin)  // TODO: Deduplicate
     return std::bit_cast<T>(buffer);
 }
 
+/** @returns The inflater used by the owning (copying) bundle API on this thread. */
+static gunblade::ffxiv::Inflater& thread_inflater()
+{
+    thread_local gunblade::ffxiv::Inflater inflater;
+    return inflater;
+}
+
 template <typename Enum>
 static constexpr auto underlying_cast(Enum value) noexcept
 {
@@ -29,6 +37,81 @@ static constexpr auto underlying_cast(Enum value) noexcept
 namespace gunblade::ffxiv
 {
     std::vector<char> Bundle::decompressed_payload() const
+    {
+        if (!header.is_compressed())
+        {
+            return payload;
+        }
+
+        const auto inflated = view().decompressed_payload(thread_inflater());
+        return std::vector(inflated.begin(), inflated.end());
+    }
+
+    std::vector<Segment> Bundle::segments() const
+    {
+        std::vector<Segment> segs;
+        segs.reserve(header.message_count);
+
+        for (const auto& seg : segments_view(thread_inflater()))
+        {
+            segs.emplace_back(seg.to_owned());
+        }
+
+        return segs;
+    }
+
+    SegmentRange Bundle::segments_view(Inflater& inflater) const
+    {
+        const auto bundle = view();
+        return bundle.segments_view(bundle.decompressed_payload(inflater));
+    }
+
+    BundleView Bundle::view() const noexcept
+    {
+        return BundleView{header, payload};
+    }
+
+    SegmentView Segment::view() const noexcept
+    {
+        return SegmentView{header, data};
+    }
+
+    IPC IPCView::to_owned() const
+    {
+        return IPC{header, std::vector(data.begin(), data.end())};
+    }
+
+    IPCView SegmentView::ipc() const
+    {
+        if (data.size() < sizeof(IPC::Header))
+        {
+            throw std::runtime_error("Segment is too short to hold an IPC");
+        }
+
+        const auto header = read_struct<IPC::Header>(data.begin());
+        return IPCView{header, data.subspan(sizeof(header))};
+    }
+
+    template <typename KeepAliveType>
+    KeepAliveType SegmentView::keep_alive() const
+    {
+        if (data.size() < sizeof(KeepAliveType))
+        {
+            throw std::runtime_error("Segment is too short to hold a keep-alive");
+        }
+
+        return read_struct<KeepAliveType>(data.begin());
+    }
+
+    template ClientKeepAlive SegmentView::keep_alive<ClientKeepAlive>() const;
+    template ServerKeepAlive SegmentView::keep_alive<ServerKeepAlive>() const;
+
+    Segment SegmentView::to_owned() const
+    {
+        return Segment{header, std::vector(data.begin(), data.end())};
+    }
+
+    std::span<const char> BundleView::decompressed_payload(Inflater& inflater) const
     {
         switch (header.compression)
         {
@@ -37,8 +120,8 @@ namespace gunblade::ffxiv
 
             case Compression::ZLIB:
             {
-                const auto inflated = gzip::decompress(payload.data(), payload.size());
-                return std::vector(inflated.cbegin(), inflated.cend());
+                GUNBLADE_TRACE_SPAN("inflate");
+                return inflater.inflate(payload);
             }
 
             default:
@@ -46,32 +129,78 @@ namespace gunblade::ffxiv
         }
     }
 
-    std::vector<Segment> Bundle::segments() const
+    std::vector<SegmentView> BundleView::segments(std::span<const char> decompressed) const
     {
-        const auto decompressed = decompressed_payload();
-        auto iter = decompressed.cbegin();
-
-        std::vector<Segment> segs;
+        std::vector<SegmentView> segs;
         segs.reserve(header.message_count);
 
-        for (auto i = 0; i < header.message_count; ++i)
+        for (const auto& seg : segments_view(decompressed))
         {
-            const auto seg_header = read_struct<Segment::Header>(iter);
-            const auto seg_payload_begin = iter + sizeof(seg_header);
-            const auto seg_payload_end = iter + seg_header.size;
-            std::vector<char> seg_payload(seg_payload_begin, seg_payload_end);
-
-            iter = seg_payload_end;
-            segs.emplace_back(seg_header, seg_payload);
+            segs.push_back(seg);
         }
 
         return segs;
     }
 
-    static void to_json(nlohmann::json& j, const IPC& ipc)
+    SegmentRange BundleView::segments_view(std::span<const char> decompressed) const noexcept
+    {
+        return SegmentRange(decompressed, header.message_count);
+    }
+
+    SegmentRange::iterator::iterator(std::span<const char> payload, std::size_t count)
+        : rest_(payload), remaining_(count)
+    {
+        read();
+    }
+
+    SegmentRange::iterator& SegmentRange::iterator::operator++()
+    {
+        --remaining_;
+        read();
+        return *this;
+    }
+
+    SegmentRange::iterator SegmentRange::iterator::operator++(int)
+    {
+        auto previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    void SegmentRange::iterator::read()
+    {
+        if (remaining_ == 0)
+        {
+            return;
+        }
+
+        // Is there enough of the payload left to read an entire segment header?
+        if (rest_.size() < sizeof(Segment::Header))
+        {
+            throw std::runtime_error("Truncated segment in bundle payload");
+        }
+
+        const auto header = read_struct<Segment::Header>(rest_.begin());
+
+        // Does the segment fit in the rest of the payload, and is it big enough for its type?
+        if (header.size > rest_.size() || header.size < sizeof(header) + header.min_data_size())
+        {
+            throw std::runtime_error("Malformed segment in bundle payload");
+        }
+
+        current_ = SegmentView{header, rest_.subspan(sizeof(header), header.data_size())};
+        rest_ = rest_.subspan(header.size);
+    }
+
+    Bundle BundleView::to_owned() const
+    {
+        return Bundle{header, std::vector(payload.begin(), payload.end())};
+    }
+
+    static void to_json(nlohmann::json& j, const IPCView& ipc)
     {
-        const auto pData = reinterpret_cast<const unsigned char*>(ipc.data.data());
-        const auto length = static_cast<unsigned int>(ipc.data.size());
+        std::string data;
+        append_base64(data, ipc.data);
 
         // clang-format off
         j = nlohmann::json{
@@ -79,7 +208,7 @@ namespace gunblade::ffxiv
             {"type", ipc.header.type},
             {"serverId", ipc.header.server_id},
             {"epoch", ipc.header.epoch},
-            {"data", base64_encode(pData, length)}
+            {"data", data}
         };
         // clang-format on
     }
@@ -106,6 +235,11 @@ namespace gunblade::ffxiv
     }
 
     void to_json(nlohmann::json& j, const Segment& segment)
+    {
+        to_json(j, segment.view());
+    }
+
+    void to_json(nlohmann::json& j, const SegmentView& segment)
     {
         // clang-format off
         j = nlohmann::json{
@@ -118,25 +252,22 @@ namespace gunblade::ffxiv
         switch (segment.header.type)
         {
             case SegmentType::IPC:
-            {
-                const auto it = segment.data.cbegin();
-                const auto header = read_struct<IPC::Header>(it);
-                std::vector<char> data(it + sizeof(header), segment.data.cend());
-
-                j["payload"] = IPC{header, data};
+                j["payload"] = segment.ipc();
                 break;
-            }
 
             case SegmentType::CLIENT_KEEPALIVE:
-                j["payload"] = read_struct<ClientKeepAlive>(segment.data.cbegin());
+                j["payload"] = segment.keep_alive<ClientKeepAlive>();
                 break;
 
             case SegmentType::SERVER_KEEPALIVE:
-                j["payload"] = read_struct<ServerKeepAlive>(segment.data.cbegin());
+                j["payload"] = segment.keep_alive<ServerKeepAlive>();
                 break;
         }
     }
 
+    static_assert(std::forward_iterator<SegmentRange::iterator>);
+    static_assert(std::ranges::forward_range<SegmentRange>);
+
     static_assert(std::is_standard_layout_v<Bundle::Header>);
     static_assert(std::is_standard_layout_v<Segment::Header>);
     static_assert(std::is_standard_layout_v<IPC::Header>);
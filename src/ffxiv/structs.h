@@ -1,15 +1,19 @@
 #pragma once
 
-#include <cstddef>  // size_t
-#include <cstdint>  // uint8_t, uint16_t, uint32_t, uint64_t
-#include <limits>   // numeric_limits
-#include <variant>  // variant
-#include <vector>   // vector
+#include <cstddef>   // ptrdiff_t, size_t
+#include <cstdint>   // uint8_t, uint16_t, uint32_t, uint64_t
+#include <iterator>  // forward_iterator_tag
+#include <limits>    // numeric_limits
+#include <span>      // span
+#include <variant>   // variant
+#include <vector>    // vector
 
 #include <nlohmann/json.hpp>
 
 namespace gunblade::ffxiv
 {
+    class Inflater;
+
     enum class Compression : std::uint8_t
     {
         /** @brief Specifies that a bundle payload is not compressed. */
@@ -103,6 +107,18 @@ namespace gunblade::ffxiv
         std::vector<char> decompressed_payload() const;
 
         std::vector<struct Segment> segments() const;
+
+        /**
+         * @brief Lazily iterates over the segments of the bundle.
+         *
+         * @param inflater The inflater to decompress the payload with
+         * @return The segments, which are valid for as long as this bundle is and
+         * until @p inflater is used again.
+         */
+        class SegmentRange segments_view(Inflater& inflater) const;
+
+        /** @returns A view of this bundle, valid for as long as this bundle is. */
+        struct BundleView view() const noexcept;
     };
 
     struct IPC final
@@ -140,6 +156,18 @@ namespace gunblade::ffxiv
         std::vector<char> data;
     };
 
+    /** @brief A non-owning view of an IPC. */
+    struct IPCView final
+    {
+        IPC::Header header;
+
+        /** @brief The IPC data, following its header. */
+        std::span<const char> data;
+
+        /** @returns A copy of the viewed IPC. */
+        IPC to_owned() const;
+    };
+
 #pragma pack(push, 1)
     template <bool IsClient>
     struct KeepAlive final
@@ -184,6 +212,25 @@ namespace gunblade::ffxiv
             {
                 return size - sizeof(*this);
             }
+
+            /** @return The smallest amount of data that a segment of this type can carry. */
+            inline std::size_t min_data_size() const noexcept
+            {
+                switch (type)
+                {
+                    case SegmentType::IPC:
+                        return sizeof(IPC::Header);
+
+                    case SegmentType::CLIENT_KEEPALIVE:
+                        return sizeof(ClientKeepAlive);
+
+                    case SegmentType::SERVER_KEEPALIVE:
+                        return sizeof(ServerKeepAlive);
+
+                    default:
+                        return 0;
+                }
+            }
         };
 #pragma pack(pop)
 
@@ -192,9 +239,174 @@ namespace gunblade::ffxiv
 
         /** @brief The uncompressed segment payload. */
         std::vector<char> data;
+
+        /** @returns A view of this segment, valid for as long as this segment is. */
+        struct SegmentView view() const noexcept;
+    };
+
+    /** @brief A non-owning view of a segment. */
+    struct SegmentView final
+    {
+        /** @brief The segment header (metadata). */
+        Segment::Header header;
+
+        /** @brief The uncompressed segment payload. */
+        std::span<const char> data;
+
+        /**
+         * @returns A view of the IPC carried by this segment.
+         * @pre The segment type is `SegmentType::IPC`.
+         * @throws std::runtime_error If the segment is too short to hold an IPC header.
+         */
+        IPCView ipc() const;
+
+        /**
+         * @returns The keep-alive carried by this segment.
+         * @pre The segment type is the keep-alive type of @p KeepAliveType.
+         * @throws std::runtime_error If the segment is too short to hold a keep-alive.
+         */
+        template <typename KeepAliveType>
+        KeepAliveType keep_alive() const;
+
+        /** @returns A copy of the viewed segment. */
+        Segment to_owned() const;
+    };
+
+    /**
+     * @brief The segments of a decompressed bundle payload, read one at a time.
+     *
+     * Nothing is copied or allocated: each segment header is only read (and
+     * checked against the bounds of the payload) when the iterator reaches it,
+     * so consumers that stop early or skip segments don't pay for the rest.
+     */
+    class SegmentRange final
+    {
+    public:
+        class iterator final
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = SegmentView;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const SegmentView*;
+            using reference = const SegmentView&;
+
+            /** @brief Creates an end iterator. */
+            iterator() = default;
+
+            inline reference operator*() const noexcept
+            {
+                return current_;
+            }
+
+            inline pointer operator->() const noexcept
+            {
+                return &current_;
+            }
+
+            /** @throws std::runtime_error If the next segment doesn't fit in the payload. */
+            iterator& operator++();
+
+            /** @throws std::runtime_error If the next segment doesn't fit in the payload. */
+            iterator operator++(int);
+
+            /** @brief Iterators over the same payload are equal if they're at the same segment. */
+            inline bool operator==(const iterator& other) const noexcept
+            {
+                return remaining_ == other.remaining_;
+            }
+
+        private:
+            friend class SegmentRange;
+
+            iterator(std::span<const char> payload, std::size_t count);
+
+            /** @brief Reads the segment at the front of `rest_`, unless there are none left. */
+            void read();
+
+            /** @brief The bytes following the current segment. */
+            std::span<const char> rest_;
+
+            /** @brief The number of segments left, including the current one. 0 at the end. */
+            std::size_t remaining_ = 0;
+
+            SegmentView current_{};
+        };
+
+        /**
+         * @param payload A decompressed bundle payload
+         * @param count The number of segments that the bundle says it holds
+         */
+        explicit SegmentRange(std::span<const char> payload, std::size_t count) noexcept
+            : payload_(payload), count_(count)
+        {
+            // Do nothing
+        }
+
+        /** @throws std::runtime_error If the first segment doesn't fit in the payload. */
+        inline iterator begin() const
+        {
+            return iterator(payload_, count_);
+        }
+
+        inline iterator end() const noexcept
+        {
+            return iterator();
+        }
+
+    private:
+        std::span<const char> payload_;
+        std::size_t count_;
+    };
+
+    /**
+     * @brief A non-owning view of a bundle.
+     *
+     * Views handed out by `FinalFantasyDecoder` point into its buffer, and are
+     * only valid until more data is fed to it (or it is cleared).
+     */
+    struct BundleView final
+    {
+        /** @brief The bundle header (metadata). */
+        Bundle::Header header;
+
+        /** @brief The (possibly compressed) bundle payload. */
+        std::span<const char> payload;
+
+        /**
+         * @brief Decompresses the bundle payload, if necessary.
+         *
+         * @param inflater The inflater to decompress with. Reusing the same one
+         * for every bundle of a flow avoids reallocating its buffer.
+         * @return The decompressed payload. This is either @p payload itself
+         * (for uncompressed bundles) or a view of the inflater's buffer.
+         */
+        std::span<const char> decompressed_payload(Inflater& inflater) const;
+
+        /**
+         * @brief Splits a decompressed bundle payload into its segments.
+         *
+         * @param decompressed The result of `decompressed_payload()`
+         * @return Views of each segment, pointing into @p decompressed.
+         * @throws std::runtime_error If a segment doesn't fit in the payload.
+         */
+        std::vector<SegmentView> segments(std::span<const char> decompressed) const;
+
+        /**
+         * @brief Lazily iterates over the segments of a decompressed bundle payload.
+         *
+         * @param decompressed The result of `decompressed_payload()`
+         * @return The segments, pointing into @p decompressed.
+         */
+        SegmentRange segments_view(std::span<const char> decompressed) const noexcept;
+
+        /** @returns A copy of the viewed bundle. */
+        Bundle to_owned() const;
     };
 
     void to_json(nlohmann::json& j, const Bundle& bundle);
 
     void to_json(nlohmann::json& j, const Segment& segment);
+
+    void to_json(nlohmann::json& j, const SegmentView& segment);
 }  // namespace gunblade::ffxiv
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "packet_parser.h"
+
+#include <array>    // array
+#include <cstdint>  // uint64_t
+#include <cstring>  // memcpy
+
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/pdu.h>
+#include <tins/tcp.h>
+
+namespace gunblade
+{
+    /** @brief Mixes the bits of @p value, with the splitmix64 finalizer. */
+    inline std::uint64_t mix(std::uint64_t value) noexcept
+    {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+        return value ^ (value >> 31);
+    }
+
+    /**
+     * @brief Hashes the TCP flow that a packet belongs to, or returns 0 if it isn't TCP.
+     *
+     * Both directions of a connection hash the same, so sharding by this hash
+     * keeps a whole connection on one shard.
+     */
+    inline std::uint64_t flow_hash(const Tins::PDU& pdu)
+    {
+        const auto* tcp = pdu.find_pdu<Tins::TCP>();
+
+        if (tcp == nullptr)
+        {
+            return 0;
+        }
+
+        if (const auto* ip = pdu.find_pdu<Tins::IP>())
+        {
+            const auto src = static_cast<std::uint32_t>(ip->src_addr());
+            const auto dst = static_cast<std::uint32_t>(ip->dst_addr());
+
+            return mix((std::uint64_t{src} << 16) | tcp->sport()) ^
+                   mix((std::uint64_t{dst} << 16) | tcp->dport());
+        }
+
+        if (const auto* ipv6 = pdu.find_pdu<Tins::IPv6>())
+        {
+            const auto fold = [](const Tins::IPv6Address& addr, std::uint16_t port) {
+                std::uint64_t halves[2];
+                std::memcpy(halves, addr.begin(), sizeof(halves));
+                return mix(mix(halves[0] ^ port) ^ halves[1]);
+            };
+
+            return fold(ipv6->src_addr(), tcp->sport()) ^ fold(ipv6->dst_addr(), tcp->dport());
+        }
+
+        return 0;
+    }
+
+    /** @brief Hashes the TCP flow of a parsed packet, exactly like the libtins overload. */
+    inline std::uint64_t flow_hash(const TcpPacketView& packet) noexcept
+    {
+        if (!packet.is_v6)
+        {
+            // libtins converts addresses to integers straight from their bytes, so do the same
+            std::uint32_t src;
+            std::uint32_t dst;
+            std::memcpy(&src, packet.src_addr.data(), sizeof(src));
+            std::memcpy(&dst, packet.dst_addr.data(), sizeof(dst));
+
+            return mix((std::uint64_t{src} << 16) | packet.src_port) ^
+                   mix((std::uint64_t{dst} << 16) | packet.dst_port);
+        }
+
+        const auto fold = [](const std::array<std::uint8_t, 16>& addr, std::uint16_t port) {
+            std::uint64_t halves[2];
+            std::memcpy(halves, addr.data(), sizeof(halves));
+            return mix(mix(halves[0] ^ port) ^ halves[1]);
+        };
+
+        return fold(packet.src_addr, packet.src_port) ^ fold(packet.dst_addr, packet.dst_port);
+    }
+}  // namespace gunblade
@@ -0,0 +1,95 @@
+#include "histogram.h"
+
+#include <algorithm>  // max, min
+#include <bit>        // bit_width
+
+namespace gunblade
+{
+    void Histogram::Snapshot::merge(const Snapshot& other) noexcept
+    {
+        for (std::size_t i = 0; i < bucket_count; ++i)
+        {
+            buckets[i] += other.buckets[i];
+        }
+
+        count += other.count;
+        sum += other.sum;
+        max = std::max(max, other.max);
+        negative += other.negative;
+    }
+
+    std::chrono::nanoseconds Histogram::Snapshot::percentile(double fraction) const noexcept
+    {
+        const auto rank = fraction * static_cast<double>(count);
+        std::uint64_t below = 0;
+
+        for (std::size_t i = 0; i < bucket_count; ++i)
+        {
+            if (buckets[i] == 0 || static_cast<double>(below + buckets[i]) < rank)
+            {
+                below += buckets[i];
+                continue;
+            }
+
+            // Nothing recorded went past the max, so the last bucket ends there
+            const auto lower = i == 0 ? std::chrono::nanoseconds(0) : upper_bound(i - 1);
+            const auto upper = i + 1 == bucket_count ? max : std::min(upper_bound(i), max);
+
+            // Everything recorded was zero, or the max lagged behind the buckets when read
+            if (upper <= lower)
+            {
+                return lower;
+            }
+
+            // Assume the durations are spread evenly across the bucket
+            const auto in_bucket = static_cast<double>(buckets[i]);
+            const auto within = (rank - static_cast<double>(below)) / in_bucket;
+            const auto width = static_cast<double>((upper - lower).count());
+
+            return lower + std::chrono::nanoseconds(static_cast<std::int64_t>(within * width));
+        }
+
+        return std::chrono::nanoseconds(0);
+    }
+
+    void Histogram::record(std::chrono::nanoseconds duration) noexcept
+    {
+        // Counting these as zero would drag the percentiles down without saying why
+        if (duration.count() < 0)
+        {
+            add_relaxed(negative_, 1);
+            return;
+        }
+
+        const auto ns = static_cast<std::uint64_t>(duration.count());
+
+        // Bucket i holds durations up to 2^i microseconds
+        const auto bucket = ns <= 1000 ? 0 : std::bit_width((ns - 1) / 1000);
+
+        add_relaxed(buckets_[std::min<std::size_t>(bucket, bucket_count - 1)], 1);
+        add_relaxed(count_, 1);
+        add_relaxed(sum_, ns);
+
+        if (ns > max_.load(std::memory_order_relaxed))
+        {
+            max_.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    Histogram::Snapshot Histogram::snapshot() const noexcept
+    {
+        Snapshot snapshot;
+
+        for (std::size_t i = 0; i < bucket_count; ++i)
+        {
+            snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        }
+
+        snapshot.count = count_.load(std::memory_order_relaxed);
+        snapshot.sum = std::chrono::nanoseconds(sum_.load(std::memory_order_relaxed));
+        snapshot.max = std::chrono::nanoseconds(max_.load(std::memory_order_relaxed));
+        snapshot.negative = negative_.load(std::memory_order_relaxed);
+
+        return snapshot;
+    }
+}  // namespace gunblade
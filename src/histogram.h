@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>    // array
+#include <atomic>   // atomic
+#include <chrono>   // nanoseconds
+#include <cstddef>  // size_t
+#include <cstdint>  // int64_t, uint64_t
+
+namespace gunblade
+{
+    /**
+     * @brief Adds @p value to a counter that only one thread ever updates.
+     *
+     * A plain load and store is enough, and much cheaper than a locked add.
+     */
+    inline void add_relaxed(std::atomic<std::uint64_t>& counter, std::uint64_t value) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Counts durations into buckets whose bounds double, from 1 microsecond
+     * up to a little over a minute.
+     *
+     * Must only be recorded to by one thread, but can be read from any.
+     */
+    class Histogram final
+    {
+    public:
+        /**
+         * @brief The number of buckets, including the last one, which has no upper
+         * bound. The one before it ends at 2^26 microseconds (about 67 seconds).
+         */
+        static constexpr std::size_t bucket_count = 28;
+
+        struct Snapshot
+        {
+            /** @brief How many durations fell into each bucket. */
+            std::array<std::uint64_t, bucket_count> buckets{};
+
+            /** @brief How many durations were recorded. */
+            std::uint64_t count = 0;
+
+            /** @brief The sum of every duration recorded. */
+            std::chrono::nanoseconds sum{0};
+
+            /** @brief The longest duration recorded. */
+            std::chrono::nanoseconds max{0};
+
+            /**
+             * @brief How many negative durations were left out. These only come
+             * from clocks that disagree, such as the sender's and ours.
+             */
+            std::uint64_t negative = 0;
+
+            /** @brief Adds the durations in @p other to this snapshot. */
+            void merge(const Snapshot& other) noexcept;
+
+            /**
+             * @brief Estimates a percentile, by interpolating within the bucket it falls in.
+             *
+             * @param fraction The percentile as a fraction, such as 0.99 for p99
+             * @return The estimate, or zero if nothing was recorded. It's never
+             * more than `max`, which also stands in for the upper bound of the
+             * last bucket.
+             */
+            std::chrono::nanoseconds percentile(double fraction) const noexcept;
+        };
+
+        /** @returns The upper bound of @p bucket. The last bucket has none. */
+        static constexpr std::chrono::nanoseconds upper_bound(std::size_t bucket) noexcept
+        {
+            return std::chrono::nanoseconds(std::int64_t{1000} << bucket);
+        }
+
+        /** @brief Records @p duration. Negative durations are only counted, as `negative`. */
+        void record(std::chrono::nanoseconds duration) noexcept;
+
+        Snapshot snapshot() const noexcept;
+
+    private:
+        std::array<std::atomic<std::uint64_t>, bucket_count> buckets_{};
+        std::atomic<std::uint64_t> count_ = 0;
+        std::atomic<std::uint64_t> sum_ = 0;
+        std::atomic<std::uint64_t> max_ = 0;
+        std::atomic<std::uint64_t> negative_ = 0;
+    };
+}  // namespace gunblade
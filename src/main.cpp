@@ -1,7 +1,32 @@
+#include "af_packet.h"
+#include "batch_replay.h"
+#include "capture_filter.h"
+#include "capture_reader.h"
+#include "connection_cache.h"
+#include "connection_source.h"
+#include "decode_arena.h"
+#include "ffxiv/binary_format.h"
 #include "ffxiv/stream_handler.h"
-#include "tcp_table.h"
+#include "metrics.h"
+#include "metrics_exporter.h"
+#include "options.h"
+#include "output_sink.h"
+#include "pipeline.h"
+#include "trace.h"
 #include "utils.h"
 
+#include <chrono>     // seconds, steady_clock
+#include <cstdio>     // stdout
+#include <fstream>    // ofstream
+#include <iostream>   // cerr, cout
+#include <memory>     // make_shared, make_unique, unique_ptr
+#include <optional>   // optional
+#include <stdexcept>  // exception, invalid_argument
+#include <string>     // string
+#include <thread>     // sleep_for
+#include <utility>    // move
+#include <vector>     // vector
+
 #include <spdlog/spdlog.h>
 #include <spdlog/cfg/env.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
@@ -30,16 +55,23 @@ static void setup_logging()
     spdlog::trace(pcap_lib_version());
 }
 
+/** @returns The network interface to sniff on: the one asked for, or the default one. */
+static Tins::NetworkInterface get_interface(const gunblade::Options& options)
+{
+    return options.interface ? Tins::NetworkInterface(*options.interface)
+                             : Tins::NetworkInterface::default_interface();
+}
+
 /**
- * @brief Gets a new packet sniffer for the default network interface.
+ * @brief Gets a new packet sniffer for the network interface to sniff on.
  */
-static Tins::Sniffer get_sniffer()
+static std::unique_ptr<Tins::BaseSniffer> get_sniffer(const gunblade::Options& options)
 {
     static const Tins::SnifferConfiguration sniffer_config = []() {
         Tins::SnifferConfiguration cfg;
 
         cfg.set_direction(pcap_direction_t::PCAP_D_INOUT);
-        cfg.set_filter("tcp and src portrange 49152-65535 and dst portrange 49152-65535");
+        cfg.set_filter(gunblade::base_capture_filter);
         cfg.set_immediate_mode(true);
         cfg.set_promisc_mode(false);
         cfg.set_timeout(100);
@@ -47,31 +79,591 @@ static Tins::Sniffer get_sniffer()
         return cfg;
     }();
 
-    Tins::NetworkInterface iface = Tins::NetworkInterface::default_interface();
+    Tins::NetworkInterface iface = get_interface(options);
 
+#ifdef _WIN32
     spdlog::info(
         "Sniffing on interface: {} ({}) (HW: {})",
         gunblade::to_utf8(iface.friendly_name()),
         iface.name(),
         iface.hw_address().to_string());
+#else
+    spdlog::info("Sniffing on interface: {} (HW: {})", iface.name(), iface.hw_address().to_string());
+#endif
+
+    return std::make_unique<Tins::Sniffer>(iface.name(), sniffer_config);
+}
+
+/**
+ * @brief Gets a new reader that replays a capture file.
+ *
+ * @param path The path of the pcap/pcapng file to replay
+ * @throws std::runtime_error If the file can't be read as a capture.
+ */
+static std::unique_ptr<gunblade::CaptureReader> get_file_reader(const std::string& path)
+{
+    spdlog::info("Replaying capture file: {}", path);
+
+    return std::make_unique<gunblade::CaptureReader>(path);
+}
+
+/** @brief Stops tracing, and writes every span recorded to @p path as a Chrome trace. */
+static void write_trace(const std::string& path)
+{
+    gunblade::trace::stop();
+
+    std::ofstream file(path);
+
+    if (!file)
+    {
+        spdlog::error("Unable to write the trace to {}", path);
+        return;
+    }
+
+    gunblade::trace::write_chrome_trace(file);
+    spdlog::info("Wrote the trace to {}", path);
+}
+
+/** @brief Copies the kernel's counters for a live capture into @p metrics. */
+static void update_capture_stats(Tins::BaseSniffer& sniffer, gunblade::Metrics& metrics)
+{
+    pcap_stat stats{};
+
+    if (pcap_stats(sniffer.get_pcap_handle(), &stats) != 0)
+    {
+        return;
+    }
+
+    metrics.set_capture({stats.ps_recv, stats.ps_drop, stats.ps_ifdrop});
+}
+
+#ifdef __linux__
+/** @brief Copies the kernel's counters for every socket of an AF_PACKET capture into @p metrics. */
+static void update_capture_stats(
+    const std::vector<std::unique_ptr<gunblade::AfPacketSocket>>& sockets,
+    gunblade::Metrics& metrics)
+{
+    gunblade::Metrics::CaptureStats totals;
+
+    for (const auto& socket : sockets)
+    {
+        const auto stats = socket->stats();
+        totals.received += stats.received;
+        totals.dropped += stats.dropped;
+    }
+
+    metrics.set_capture(totals);
+}
+#endif
+
+/**
+ * @brief Opens where to send decoded bundles to, which is sent to from a thread
+ * of its own, as the backpressure option says to.
+ *
+ * @throws std::runtime_error If the output can't be opened.
+ */
+static std::unique_ptr<gunblade::AsyncSink> open_output(const gunblade::Options& options)
+{
+    // Binary output starts with a header, which must go out before any records
+    std::string header;
+
+    if (options.format == gunblade::OutputFormat::BINARY)
+    {
+        if (options.output.kind == gunblade::OutputTarget::Kind::STDOUT)
+        {
+            gunblade::set_binary_mode(stdout);
+        }
+
+        gunblade::ffxiv::binary::write_stream_header(header);
+    }
+
+    gunblade::RotationOptions rotation;
+    rotation.max_bytes = options.rotate_bytes;
+    rotation.keep = options.rotate_keep;
+
+    gunblade::AsyncSinkOptions sink_options;
+    sink_options.capacity = options.output_buffer;
+    sink_options.backpressure = options.backpressure.value_or(gunblade::Backpressure::BLOCK);
+
+    return std::make_unique<gunblade::AsyncSink>(
+        gunblade::open_sink(options.output, rotation, header),
+        sink_options);
+}
+
+/**
+ * @brief Starts reporting metrics, if any of the options ask for them.
+ *
+ * @throws std::runtime_error If the metrics port can't be listened on.
+ */
+static std::unique_ptr<gunblade::MetricsExporter> start_exporter(
+    const gunblade::Options& options,
+    gunblade::MetricsExporter::Gather gather)
+{
+    if (options.stats_interval == 0 && options.metrics_port == 0)
+    {
+        return nullptr;
+    }
+
+    return std::make_unique<gunblade::MetricsExporter>(
+        std::move(gather),
+        std::chrono::seconds(options.stats_interval),
+        options.metrics_port);
+}
+
+/**
+ * @brief Replays every capture file in a batch, and writes their merged output to @p output.
+ *
+ * A single capture file being replayed with the built-in reassembler is replayed
+ * as a batch of one, since only batches can use it.
+ *
+ * @return The exit code: 1 if any file couldn't be replayed.
+ */
+static int replay_batch(
+    const gunblade::Options& options,
+    const gunblade::Pipeline::FollowerSetup& follower_setup,
+    const gunblade::BatchReplay::ReassemblerSetup& reassembler_setup,
+    const gunblade::MetricsExporter::Gather& gather,
+    gunblade::AsyncSink& output)
+{
+    std::vector<std::string> files;
+
+    try
+    {
+        files = gunblade::BatchReplay::expand_paths(
+            options.batch.empty() ? std::vector{*options.read_file} : options.batch);
+    }
+    catch (const std::exception& e)
+    {
+        spdlog::error(e.what());
+        return 1;
+    }
+
+    gunblade::BatchOptions batch_options;
+    batch_options.workers = options.workers;
+    batch_options.merge_memory = options.merge_memory;
+
+    if (options.spill_directory)
+    {
+        batch_options.spill_directory = *options.spill_directory;
+    }
+
+    std::unique_ptr<gunblade::MetricsExporter> exporter;
+
+    try
+    {
+        exporter = start_exporter(options, gather);
+    }
+    catch (const std::exception& e)
+    {
+        spdlog::error(e.what());
+        return 1;
+    }
+
+    const auto batch = options.reassembler == gunblade::Reassembler::BUILTIN
+                           ? gunblade::BatchReplay(batch_options, reassembler_setup)
+                           : gunblade::BatchReplay(batch_options, follower_setup);
+    gunblade::BatchReplay::Stats stats;
+
+    try
+    {
+        stats = batch.run(files, output);
+    }
+    catch (const std::exception& e)
+    {
+        spdlog::error(e.what());
+        return 1;
+    }
+
+    // Everything must be sent before the final metrics are reported
+    output.close();
+
+    if (exporter)
+    {
+        exporter->stop();
+    }
+
+    spdlog::info(
+        "Replayed {} packets from {} file(s) into {} records ({} of {} tasks stolen)",
+        stats.packets,
+        files.size(),
+        stats.records,
+        stats.stolen_tasks,
+        stats.tasks);
 
-    return Tins::Sniffer(iface.name(), sniffer_config);
+    if (stats.spilled_runs > 0)
+    {
+        spdlog::info(
+            "Spilled {} bytes of output to disk, as {} sorted runs",
+            stats.spilled_bytes,
+            stats.spilled_runs);
+    }
+
+    return stats.failed_tasks > 0 ? 1 : 0;
+}
+
+#ifdef __linux__
+/**
+ * @brief Sniffs live with one AF_PACKET socket per worker, all in one fanout group,
+ * so that each worker captures and decodes its own share of the flows.
+ *
+ * @return The exit code, if sniffing couldn't start. Otherwise, sniffs forever.
+ */
+static int capture_af_packet(
+    const gunblade::Options& options,
+    const gunblade::ffxiv::FollowerOptions& follower_options,
+    const gunblade::PipelineOptions& pipeline_options,
+    const gunblade::Pipeline::ReassemblerSetup& reassembler_setup,
+    gunblade::Metrics& metrics,
+    gunblade::AsyncSink& output)
+{
+    std::vector<std::unique_ptr<gunblade::AfPacketSocket>> sockets;
+    std::vector<gunblade::PacketSource*> sources;
+
+    try
+    {
+        gunblade::AfPacketOptions socket_options;
+        socket_options.interface = get_interface(options).name();
+        socket_options.fanout_group = gunblade::AfPacketSocket::default_fanout_group();
+
+        for (std::size_t i = 0; i < options.workers; ++i)
+        {
+            sockets.push_back(std::make_unique<gunblade::AfPacketSocket>(socket_options));
+            sources.push_back(sockets.back().get());
+
+            // Let the kernel drop everything but FFXIV's traffic, once it's known which that is
+            if (follower_options.connections && !options.static_filter)
+            {
+                sockets.back()->narrow_filter(follower_options.connections);
+            }
+        }
+
+        spdlog::info(
+            "Sniffing on interface: {} ({} AF_PACKET sockets)",
+            socket_options.interface,
+            sockets.size());
+    }
+    catch (const std::exception& e)
+    {
+        spdlog::error(e.what());
+        return 1;
+    }
+
+    gunblade::Pipeline pipeline(pipeline_options, reassembler_setup, sources, output);
+
+    std::unique_ptr<gunblade::MetricsExporter> exporter;
+
+    try
+    {
+        exporter = start_exporter(options, [&follower_options, &metrics, &pipeline, &output]() {
+            gunblade::MetricsReport report;
+            report.decoders = metrics.snapshot();
+            report.pipeline = pipeline.stats();
+            report.memory = follower_options.memory->stats();
+            report.output = output.stats();
+            return report;
+        });
+    }
+    catch (const std::exception& e)
+    {
+        spdlog::error(e.what());
+        return 1;
+    }
+
+    // The workers capture for themselves, which leaves only the kernel's counters to read
+    while (true)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        update_capture_stats(sockets, metrics);
+    }
 }
+#endif
 
-int main()
+int main(int argc, char* argv[])
 {
     setup_logging();
 
-    // Set up a new stream follower to do TCP stream reassembly
-    Tins::TCPIP::StreamFollower follower;
-    gunblade::ffxiv::setup_follower(follower);
+    gunblade::Options options;
+
+    try
+    {
+        options = gunblade::parse_options(argc, argv);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        spdlog::error(e.what());
+        std::cerr << gunblade::usage(argv[0]);
+        return 1;
+    }
+
+    if (options.show_help)
+    {
+        std::cout << gunblade::usage(argv[0]);
+        return 0;
+    }
+
+    const bool live = !options.read_file.has_value() && options.batch.empty();
+
+    if (options.trace_file)
+    {
+        gunblade::trace::set_thread_name("capture");
+        gunblade::trace::start();
+    }
+
+    // Captures don't come with the connection table of the machine they were
+    // taken on, so when replaying, every stream is treated as an FFXIV stream.
+    gunblade::ffxiv::FollowerOptions follower_options;
+
+    if (live)
+    {
+        follower_options.connections =
+            std::make_shared<gunblade::ConnectionCache>(gunblade::make_system_connection_source());
+    }
+
+    follower_options.format = options.format;
+    follower_options.write_timestamps = options.timestamps;
+    follower_options.measure_latency = live;
+    follower_options.max_flow_buffer = options.max_flow_buffer;
+    follower_options.memory = std::make_shared<gunblade::MemoryBudget>(options.memory_budget);
+
+    if (!options.filter.empty())
+    {
+        follower_options.filter = std::make_shared<gunblade::ffxiv::SegmentFilter>(options.filter);
+    }
+
+    // Output with any of the priority opcodes is the last to be dropped
+    if (!options.priority_opcodes.empty())
+    {
+        // Opcodes only restrict IPCs, so keepalives must be ruled out separately
+        gunblade::ffxiv::FilterRules priority;
+        priority.segment_types = {gunblade::ffxiv::SegmentType::IPC};
+        priority.opcodes = options.priority_opcodes;
+
+        follower_options.priority = std::make_shared<gunblade::ffxiv::SegmentFilter>(priority);
+    }
+
+    std::unique_ptr<gunblade::AsyncSink> output;
+
+    try
+    {
+        output = open_output(options);
+    }
+    catch (const std::exception& e)
+    {
+        spdlog::error(e.what());
+        return 1;
+    }
+
+    // Every follower counts into its own shard of the metrics, so they never contend
+    const auto metrics = std::make_shared<gunblade::Metrics>();
+
+    // The options for each worker's follower, which writes to the worker's own output,
+    // and whose flows share their own arena
+    const auto worker_options = [&follower_options, &metrics](gunblade::RecordWriter& output) {
+        auto worker = follower_options;
+        worker.output = &output;
+        worker.metrics = metrics->add_shard();
+        worker.arena = std::make_shared<gunblade::DecodeArena>(worker.metrics);
+        return worker;
+    };
+
+    // Set up a stream follower on each worker to do TCP stream reassembly
+    const gunblade::Pipeline::FollowerSetup follower_setup =
+        [&worker_options](Tins::TCPIP::StreamFollower& follower, gunblade::RecordWriter& output) {
+            gunblade::ffxiv::setup_follower(follower, worker_options(output));
+        };
+
+    // Or the built-in reassembler, when replaying or sniffing with AF_PACKET sockets
+    const gunblade::Pipeline::ReassemblerSetup reassembler_setup =
+        [&worker_options](gunblade::TcpReassembler& reassembler, gunblade::RecordWriter& output) {
+            gunblade::ffxiv::setup_reassembler(reassembler, worker_options(output));
+        };
 
-    // Sniff packets forever
-    Tins::Sniffer sniffer = get_sniffer();
-    sniffer.sniff_loop([&follower](Tins::PDU& packet) {
-        follower.process_packet(packet);
-        return true;
-    });
+    if (!live && (!options.batch.empty() || options.reassembler == gunblade::Reassembler::BUILTIN))
+    {
+        const auto gather = [&follower_options, &metrics, &output]() {
+            gunblade::MetricsReport report;
+            report.decoders = metrics->snapshot();
+            report.memory = follower_options.memory->stats();
+            report.output = output->stats();
+            return report;
+        };
+
+        const auto status =
+            replay_batch(options, follower_setup, reassembler_setup, gather, *output);
+
+        if (options.trace_file)
+        {
+            write_trace(*options.trace_file);
+        }
+
+        return status;
+    }
+
+    // Replays can wait for the pipeline to catch up, live captures can't
+    gunblade::PipelineOptions pipeline_options;
+    pipeline_options.workers = options.workers;
+    pipeline_options.packet_queue_capacity = options.queue_size;
+    pipeline_options.drop_when_full = live;
+    pipeline_options.measure_latency = live;
+
+#ifdef __linux__
+    if (options.capture == gunblade::CaptureBackend::AF_PACKET)
+    {
+        return capture_af_packet(
+            options,
+            follower_options,
+            pipeline_options,
+            reassembler_setup,
+            *metrics,
+            *output);
+    }
+#endif
+
+    gunblade::Pipeline pipeline(pipeline_options, follower_setup, *output);
+
+    std::unique_ptr<gunblade::MetricsExporter> exporter;
+
+    try
+    {
+        exporter = start_exporter(options, [&follower_options, &metrics, &pipeline, &output]() {
+            gunblade::MetricsReport report;
+            report.decoders = metrics->snapshot();
+            report.pipeline = pipeline.stats();
+            report.memory = follower_options.memory->stats();
+            report.output = output->stats();
+            return report;
+        });
+    }
+    catch (const std::exception& e)
+    {
+        spdlog::error(e.what());
+        return 1;
+    }
+
+    // Sniff packets until the capture ends (which is never, when sniffing live)
+    std::unique_ptr<Tins::BaseSniffer> sniffer;
+    std::unique_ptr<gunblade::CaptureReader> reader;
+
+    try
+    {
+        if (options.read_file)
+        {
+            reader = get_file_reader(*options.read_file);
+        }
+        else
+        {
+            sniffer = get_sniffer(options);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        spdlog::error(e.what());
+        return 1;
+    }
+
+    // Let the kernel drop everything but FFXIV's traffic, once it's known which that is
+    std::optional<gunblade::CaptureFilter> capture_filter;
+
+    if (follower_options.connections && !options.static_filter)
+    {
+        capture_filter.emplace(follower_options.connections, sniffer->link_type());
+    }
+
+    // The kernel's counters are only read now and then, from the capture thread
+    using clock = std::chrono::steady_clock;
+    auto next_capture_stats = clock::now();
+
+    while (true)
+    {
+        Tins::Packet packet = reader ? reader->next_packet() : sniffer->next_packet();
+
+        if (!packet)
+        {
+            break;
+        }
+
+        if (capture_filter)
+        {
+            capture_filter->observe(*packet.pdu());
+            capture_filter->update(*sniffer);
+        }
+
+        if (live && clock::now() >= next_capture_stats)
+        {
+            update_capture_stats(*sniffer, *metrics);
+            next_capture_stats = clock::now() + std::chrono::seconds(1);
+        }
+
+        pipeline.submit(std::move(packet));
+    }
+
+    if (live)
+    {
+        update_capture_stats(*sniffer, *metrics);
+    }
+
+    if (reader)
+    {
+        const auto& stats = reader->stats();
+        spdlog::info(
+            "Read {} packet records, kept {} ({} malformed)",
+            stats.records,
+            stats.packets,
+            stats.malformed);
+
+        if (reader->truncated())
+        {
+            spdlog::warn("The capture file ends with a truncated or malformed record");
+        }
+    }
+
+    pipeline.stop();
+    output->close();
+
+    if (exporter)
+    {
+        exporter->stop();
+    }
+
+    if (options.trace_file)
+    {
+        write_trace(*options.trace_file);
+    }
+
+    const auto memory = follower_options.memory->stats();
+    spdlog::info(
+        "Flow buffers: peak {} bytes (largest flow {} bytes, budget {} bytes), {} resyncs",
+        memory.peak_buffered,
+        memory.largest_flow,
+        memory.limit,
+        memory.resyncs);
+
+    // Only live captures are written soon after they're captured
+    if (live)
+    {
+        const auto latency = pipeline.stats().output_latency;
+        const auto microseconds = [&latency](double fraction) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                       latency.percentile(fraction))
+                .count();
+        };
+
+        spdlog::info(
+            "Capture to output latency: p50 {} us, p99 {} us, p999 {} us, max {} us ({} batches)",
+            microseconds(0.5),
+            microseconds(0.99),
+            microseconds(0.999),
+            microseconds(1.0),
+            latency.count);
+    }
+
+    const auto sent = output->stats();
+    spdlog::info(
+        "Output: {} bytes sent, {} batches ({} bytes) dropped, {} bytes failed",
+        sent.written_bytes,
+        sent.dropped_batches,
+        sent.dropped_bytes,
+        sent.failed_bytes);
 
     return 0;
 }
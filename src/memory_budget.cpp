@@ -0,0 +1,86 @@
+#include "memory_budget.h"
+
+#include <utility>  // move
+
+/** @brief Raises @p target to @p value, if it's lower. */
+static void store_max(std::atomic<std::size_t>& target, std::size_t value) noexcept
+{
+    auto current = target.load(std::memory_order_relaxed);
+
+    while (current < value &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+        // Try again with the value that beat us to it
+    }
+}
+
+namespace gunblade
+{
+    MemoryBudget::Flow::Flow(std::shared_ptr<MemoryBudget> budget) noexcept
+        : budget_(std::move(budget))
+    {
+        budget_->flows_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    MemoryBudget::Flow::~Flow()
+    {
+        budget_->buffered_.fetch_sub(buffered_, std::memory_order_relaxed);
+        budget_->flows_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    bool MemoryBudget::Flow::set_buffered(std::size_t bytes) noexcept
+    {
+        // Apply the difference, since every other flow is updating the total too
+        std::size_t total;
+
+        if (bytes >= buffered_)
+        {
+            const auto grown = bytes - buffered_;
+            total = budget_->buffered_.fetch_add(grown, std::memory_order_relaxed) + grown;
+        }
+        else
+        {
+            const auto shrunk = buffered_ - bytes;
+            total = budget_->buffered_.fetch_sub(shrunk, std::memory_order_relaxed) - shrunk;
+        }
+
+        buffered_ = bytes;
+
+        if (bytes > peak_)
+        {
+            peak_ = bytes;
+            store_max(budget_->largest_flow_, bytes);
+        }
+
+        store_max(budget_->peak_buffered_, total);
+        return total > budget_->limit_;
+    }
+
+    void MemoryBudget::Flow::count_resync() noexcept
+    {
+        budget_->resyncs_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    MemoryBudget::MemoryBudget(std::size_t limit) noexcept : limit_(limit)
+    {
+        // Do nothing
+    }
+
+    bool MemoryBudget::exceeded() const noexcept
+    {
+        return buffered_.load(std::memory_order_relaxed) > limit_;
+    }
+
+    MemoryBudget::Stats MemoryBudget::stats() const noexcept
+    {
+        Stats stats;
+        stats.limit = limit_;
+        stats.buffered = buffered_.load(std::memory_order_relaxed);
+        stats.peak_buffered = peak_buffered_.load(std::memory_order_relaxed);
+        stats.largest_flow = largest_flow_.load(std::memory_order_relaxed);
+        stats.flows = flows_.load(std::memory_order_relaxed);
+        stats.resyncs = resyncs_.load(std::memory_order_relaxed);
+
+        return stats;
+    }
+}  // namespace gunblade
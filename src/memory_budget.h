@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>   // atomic
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+#include <memory>   // shared_ptr
+
+namespace gunblade
+{
+    /**
+     * @brief Accounts for the bytes buffered by every flow's decoder, against a global limit.
+     *
+     * Each flow keeps its own `Flow` account up to date, and sheds buffered bytes
+     * while the total is over the limit. All member functions are safe to call
+     * from multiple threads, but each `Flow` must only be used by one thread.
+     */
+    class MemoryBudget final
+    {
+    public:
+        struct Stats
+        {
+            /** @brief The limit on the bytes buffered across every flow. */
+            std::size_t limit = 0;
+
+            /** @brief The bytes currently buffered across every flow. */
+            std::size_t buffered = 0;
+
+            /** @brief The most bytes that have been buffered across every flow at once. */
+            std::size_t peak_buffered = 0;
+
+            /** @brief The most bytes that any one flow has buffered. */
+            std::size_t largest_flow = 0;
+
+            /** @brief The number of flows currently being accounted for. */
+            std::size_t flows = 0;
+
+            /** @brief The number of times that a flow dropped bytes to resynchronize. */
+            std::uint64_t resyncs = 0;
+        };
+
+        /** @brief One flow's share of the budget. Gives its bytes back when destroyed. */
+        class Flow final
+        {
+        public:
+            explicit Flow(std::shared_ptr<MemoryBudget> budget) noexcept;
+
+            Flow(const Flow&) = delete;
+            Flow& operator=(const Flow&) = delete;
+
+            ~Flow();
+
+            /**
+             * @brief Records how many bytes the flow has buffered now.
+             *
+             * @return Whether the budget is exceeded.
+             */
+            bool set_buffered(std::size_t bytes) noexcept;
+
+            /** @brief Records that the flow dropped bytes to resynchronize. */
+            void count_resync() noexcept;
+
+            /** @returns The bytes that the flow has buffered. */
+            inline std::size_t buffered() const noexcept
+            {
+                return buffered_;
+            }
+
+            /** @returns The most bytes that the flow has buffered. */
+            inline std::size_t peak() const noexcept
+            {
+                return peak_;
+            }
+
+        private:
+            std::shared_ptr<MemoryBudget> budget_;
+            std::size_t buffered_ = 0;
+            std::size_t peak_ = 0;
+        };
+
+        /** @param limit The most bytes to buffer across every flow. */
+        explicit MemoryBudget(std::size_t limit) noexcept;
+
+        /** @returns Whether more bytes are buffered than the limit allows. */
+        bool exceeded() const noexcept;
+
+        /** @returns A snapshot of the budget's gauges and counters. */
+        Stats stats() const noexcept;
+
+    private:
+        const std::size_t limit_;
+
+        std::atomic<std::size_t> buffered_ = 0;
+        std::atomic<std::size_t> peak_buffered_ = 0;
+        std::atomic<std::size_t> largest_flow_ = 0;
+        std::atomic<std::size_t> flows_ = 0;
+        std::atomic<std::uint64_t> resyncs_ = 0;
+    };
+}  // namespace gunblade
@@ -0,0 +1,549 @@
+#include "metrics.h"
+
+#include <iterator>     // back_inserter
+#include <string_view>  // string_view
+#include <utility>      // move
+
+#include <fmt/format.h>  // format, format_to
+#include <nlohmann/json.hpp>
+
+/** @brief Adds each of @p counters to the matching element of @p totals. */
+template <std::size_t Size>
+static void merge(
+    std::array<std::uint64_t, Size>& totals,
+    const std::array<std::atomic<std::uint64_t>, Size>& counters) noexcept
+{
+    for (std::size_t i = 0; i < Size; ++i)
+    {
+        totals[i] += counters[i].load(std::memory_order_relaxed);
+    }
+}
+
+static nlohmann::json histogram_to_json(const gunblade::Histogram::Snapshot& histogram)
+{
+    auto buckets = nlohmann::json::array();
+
+    for (const auto count : histogram.buckets)
+    {
+        buckets.push_back(count);
+    }
+
+    return {
+        {"count", histogram.count},
+        {"sumNs", histogram.sum.count()},
+        {"p50Ns", histogram.percentile(0.5).count()},
+        {"p99Ns", histogram.percentile(0.99).count()},
+        {"p999Ns", histogram.percentile(0.999).count()},
+        {"maxNs", histogram.max.count()},
+        {"overflow", histogram.buckets.back()},
+        {"negative", histogram.negative},
+        {"buckets", std::move(buckets)}};
+}
+
+/** @brief Appends the help and type lines that come before a metric's samples. */
+static void write_header(
+    std::string& out,
+    std::string_view name,
+    std::string_view type,
+    std::string_view help)
+{
+    fmt::format_to(std::back_inserter(out), "# HELP {0} {1}\n# TYPE {0} {2}\n", name, help, type);
+}
+
+/** @brief Appends a metric with a single, unlabelled sample. */
+static void write_metric(
+    std::string& out,
+    std::string_view name,
+    std::string_view type,
+    std::string_view help,
+    std::uint64_t value)
+{
+    write_header(out, name, type, help);
+    fmt::format_to(std::back_inserter(out), "{} {}\n", name, value);
+}
+
+/** @brief Appends a metric with one sample for each value of the label @p label. */
+template <std::size_t Size>
+static void write_labelled_metric(
+    std::string& out,
+    std::string_view name,
+    std::string_view help,
+    std::string_view label,
+    const std::array<std::string_view, Size>& label_values,
+    const std::array<std::uint64_t, Size>& values)
+{
+    write_header(out, name, "counter", help);
+
+    for (std::size_t i = 0; i < Size; ++i)
+    {
+        fmt::format_to(
+            std::back_inserter(out),
+            "{}{{{}=\"{}\"}} {}\n",
+            name,
+            label,
+            label_values[i],
+            values[i]);
+    }
+}
+
+static void write_histogram(
+    std::string& out,
+    std::string_view name,
+    std::string_view help,
+    const gunblade::Histogram::Snapshot& histogram)
+{
+    using seconds = std::chrono::duration<double>;
+
+    write_header(out, name, "histogram", help);
+
+    // Prometheus buckets are cumulative, and the last one has no upper bound
+    std::uint64_t cumulative = 0;
+
+    for (std::size_t i = 0; i + 1 < histogram.buckets.size(); ++i)
+    {
+        cumulative += histogram.buckets[i];
+
+        fmt::format_to(
+            std::back_inserter(out),
+            "{}_bucket{{le=\"{}\"}} {}\n",
+            name,
+            seconds(gunblade::Histogram::upper_bound(i)).count(),
+            cumulative);
+    }
+
+    fmt::format_to(
+        std::back_inserter(out),
+        "{0}_bucket{{le=\"+Inf\"}} {1}\n{0}_sum {2}\n{0}_count {1}\n",
+        name,
+        histogram.count,
+        seconds(histogram.sum).count());
+
+    // The buckets can't say how far past the last bound the durations went, or what was left out
+    const auto max_name = fmt::format("{}_max", name);
+    write_header(out, max_name, "gauge", fmt::format("The longest duration in {}.", name));
+    fmt::format_to(std::back_inserter(out), "{} {}\n", max_name, seconds(histogram.max).count());
+
+    write_metric(
+        out,
+        fmt::format("{}_negative_total", name),
+        "counter",
+        fmt::format("Negative durations left out of {}, from clocks that disagree.", name),
+        histogram.negative);
+}
+
+namespace gunblade
+{
+    void Metrics::Shard::add_reassembled(std::size_t bytes) noexcept
+    {
+        add_relaxed(reassembled_bytes_, bytes);
+    }
+
+    void Metrics::Shard::count_bundle(
+        const ffxiv::BundleView& bundle,
+        std::span<const ffxiv::SegmentView> segments) noexcept
+    {
+        switch (bundle.header.compression)
+        {
+            case ffxiv::Compression::NONE:
+                add_relaxed(bundles_[0], 1);
+                break;
+
+            case ffxiv::Compression::ZLIB:
+                add_relaxed(bundles_[1], 1);
+                break;
+
+            default:
+                add_relaxed(bundles_[2], 1);
+                break;
+        }
+
+        // Add up locally, since a bundle can have a lot of segments
+        std::array<std::uint64_t, 4> counts{};
+
+        for (const auto& segment : segments)
+        {
+            switch (segment.header.type)
+            {
+                case ffxiv::SegmentType::IPC:
+                    ++counts[0];
+                    break;
+
+                case ffxiv::SegmentType::CLIENT_KEEPALIVE:
+                    ++counts[1];
+                    break;
+
+                case ffxiv::SegmentType::SERVER_KEEPALIVE:
+                    ++counts[2];
+                    break;
+
+                default:
+                    ++counts[3];
+                    break;
+            }
+        }
+
+        for (std::size_t i = 0; i < counts.size(); ++i)
+        {
+            if (counts[i] > 0)
+            {
+                add_relaxed(segments_[i], counts[i]);
+            }
+        }
+    }
+
+    void Metrics::Shard::count_malformed() noexcept
+    {
+        add_relaxed(malformed_bundles_, 1);
+    }
+
+    void Metrics::Shard::record_inflate(std::chrono::nanoseconds duration) noexcept
+    {
+        inflate_time_.record(duration);
+    }
+
+    void Metrics::Shard::record_output(
+        std::size_t bytes,
+        std::chrono::nanoseconds duration) noexcept
+    {
+        add_relaxed(records_, 1);
+        add_relaxed(output_bytes_, bytes);
+        serialize_time_.record(duration);
+    }
+
+    void Metrics::Shard::count_allocation(std::size_t bytes) noexcept
+    {
+        add_relaxed(allocations_, 1);
+        add_relaxed(allocated_bytes_, bytes);
+    }
+
+    void Metrics::Shard::record_latency(std::chrono::nanoseconds duration) noexcept
+    {
+        latency_.record(duration);
+    }
+
+    void Metrics::Shard::record_transit(std::chrono::nanoseconds duration) noexcept
+    {
+        transit_time_.record(duration);
+    }
+
+    std::shared_ptr<Metrics::Shard> Metrics::add_shard()
+    {
+        auto shard = std::make_shared<Shard>();
+
+        std::lock_guard lock(mutex_);
+        shards_.push_back(shard);
+
+        return shard;
+    }
+
+    void Metrics::set_capture(const CaptureStats& stats) noexcept
+    {
+        captured_.store(stats.received, std::memory_order_relaxed);
+        capture_dropped_.store(stats.dropped, std::memory_order_relaxed);
+        interface_dropped_.store(stats.interface_dropped, std::memory_order_relaxed);
+    }
+
+    Metrics::Snapshot Metrics::snapshot() const
+    {
+        const auto load = [](const std::atomic<std::uint64_t>& counter) {
+            return counter.load(std::memory_order_relaxed);
+        };
+
+        Snapshot totals;
+
+        {
+            std::lock_guard lock(mutex_);
+
+            for (const auto& shard : shards_)
+            {
+                totals.reassembled_bytes += load(shard->reassembled_bytes_);
+                ::merge(totals.bundles, shard->bundles_);
+                totals.malformed_bundles += load(shard->malformed_bundles_);
+                ::merge(totals.segments, shard->segments_);
+                totals.records += load(shard->records_);
+                totals.output_bytes += load(shard->output_bytes_);
+                totals.allocations += load(shard->allocations_);
+                totals.allocated_bytes += load(shard->allocated_bytes_);
+                totals.inflate_time.merge(shard->inflate_time_.snapshot());
+                totals.serialize_time.merge(shard->serialize_time_.snapshot());
+                totals.latency.merge(shard->latency_.snapshot());
+                totals.transit_time.merge(shard->transit_time_.snapshot());
+            }
+        }
+
+        totals.capture.received = load(captured_);
+        totals.capture.dropped = load(capture_dropped_);
+        totals.capture.interface_dropped = load(interface_dropped_);
+
+        return totals;
+    }
+
+    std::string to_json_line(const MetricsReport& report)
+    {
+        const auto& decoders = report.decoders;
+        const auto& pipeline = report.pipeline;
+        const auto& memory = report.memory;
+        const auto& output = report.output;
+
+        const nlohmann::json json = {
+            {"capture",
+             {{"received", decoders.capture.received},
+              {"dropped", decoders.capture.dropped},
+              {"interfaceDropped", decoders.capture.interface_dropped}}},
+            {"pipeline",
+             {{"packets", pipeline.packets},
+              {"droppedPackets", pipeline.dropped_packets},
+              {"writes", pipeline.writes},
+              {"droppedWrites", pipeline.dropped_writes},
+              {"packetQueueDepth", pipeline.packet_queue_depth},
+              {"outputQueueDepth", pipeline.output_queue_depth},
+              {"outputLatency", histogram_to_json(pipeline.output_latency)}}},
+            {"decoders",
+             {{"reassembledBytes", decoders.reassembled_bytes},
+              {"bundles",
+               {{"none", decoders.bundles[0]},
+                {"zlib", decoders.bundles[1]},
+                {"other", decoders.bundles[2]}}},
+              {"malformedBundles", decoders.malformed_bundles},
+              {"segments",
+               {{"ipc", decoders.segments[0]},
+                {"clientKeepalive", decoders.segments[1]},
+                {"serverKeepalive", decoders.segments[2]},
+                {"other", decoders.segments[3]}}},
+              {"records", decoders.records},
+              {"outputBytes", decoders.output_bytes},
+              {"allocations", decoders.allocations},
+              {"allocatedBytes", decoders.allocated_bytes},
+              {"inflateTime", histogram_to_json(decoders.inflate_time)},
+              {"serializeTime", histogram_to_json(decoders.serialize_time)},
+              {"latency", histogram_to_json(decoders.latency)},
+              {"transitTime", histogram_to_json(decoders.transit_time)}}},
+            {"flowBuffers",
+             {{"limit", memory.limit},
+              {"buffered", memory.buffered},
+              {"peakBuffered", memory.peak_buffered},
+              {"largestFlow", memory.largest_flow},
+              {"flows", memory.flows},
+              {"resyncs", memory.resyncs}}},
+            {"output",
+             {{"writtenBytes", output.written_bytes},
+              {"droppedBatches", output.dropped_batches},
+              {"droppedBytes", output.dropped_bytes},
+              {"failedBytes", output.failed_bytes},
+              {"queuedBytes", output.queued_bytes}}}};
+
+        return json.dump() + '\n';
+    }
+
+    std::string to_prometheus(const MetricsReport& report)
+    {
+        const auto& decoders = report.decoders;
+        const auto& pipeline = report.pipeline;
+        const auto& memory = report.memory;
+        const auto& output = report.output;
+
+        std::string out;
+
+        write_metric(
+            out,
+            "gunblade_capture_received_packets_total",
+            "counter",
+            "Packets that matched the capture filter.",
+            decoders.capture.received);
+        write_metric(
+            out,
+            "gunblade_capture_dropped_packets_total",
+            "counter",
+            "Packets dropped because the capture buffer was full.",
+            decoders.capture.dropped);
+        write_metric(
+            out,
+            "gunblade_capture_interface_dropped_packets_total",
+            "counter",
+            "Packets dropped by the network interface.",
+            decoders.capture.interface_dropped);
+
+        write_metric(
+            out,
+            "gunblade_pipeline_packets_total",
+            "counter",
+            "Packets handed to a worker.",
+            pipeline.packets);
+        write_metric(
+            out,
+            "gunblade_pipeline_dropped_packets_total",
+            "counter",
+            "Packets dropped because a worker's queue was full.",
+            pipeline.dropped_packets);
+        write_metric(
+            out,
+            "gunblade_pipeline_writes_total",
+            "counter",
+            "Output batches handed to the writer thread.",
+            pipeline.writes);
+        write_metric(
+            out,
+            "gunblade_pipeline_dropped_writes_total",
+            "counter",
+            "Output batches dropped because a worker's output queue was full.",
+            pipeline.dropped_writes);
+        write_metric(
+            out,
+            "gunblade_pipeline_packet_queue_depth",
+            "gauge",
+            "Packets queued across every worker.",
+            pipeline.packet_queue_depth);
+        write_metric(
+            out,
+            "gunblade_pipeline_output_queue_depth",
+            "gauge",
+            "Output batches queued across every worker.",
+            pipeline.output_queue_depth);
+        write_histogram(
+            out,
+            "gunblade_pipeline_output_latency_seconds",
+            "Time from capturing a batch's first packet to queueing the batch for output.",
+            pipeline.output_latency);
+
+        write_metric(
+            out,
+            "gunblade_reassembled_bytes_total",
+            "counter",
+            "Bytes of TCP payload fed to the decoders.",
+            decoders.reassembled_bytes);
+        write_labelled_metric(
+            out,
+            "gunblade_bundles_total",
+            "Bundles decoded, by compression.",
+            "compression",
+            std::array<std::string_view, 3>{"none", "zlib", "other"},
+            decoders.bundles);
+        write_metric(
+            out,
+            "gunblade_malformed_bundles_total",
+            "counter",
+            "Bundles skipped because they couldn't be decoded.",
+            decoders.malformed_bundles);
+        write_labelled_metric(
+            out,
+            "gunblade_segments_total",
+            "Segments written, by type.",
+            "type",
+            std::array<std::string_view, 4>{"ipc", "client_keepalive", "server_keepalive", "other"},
+            decoders.segments);
+        write_metric(
+            out,
+            "gunblade_records_total",
+            "counter",
+            "Records written.",
+            decoders.records);
+        write_metric(
+            out,
+            "gunblade_output_bytes_total",
+            "counter",
+            "Bytes of records written.",
+            decoders.output_bytes);
+        write_metric(
+            out,
+            "gunblade_decoder_allocations_total",
+            "counter",
+            "Allocations that the decoders made from the heap.",
+            decoders.allocations);
+        write_metric(
+            out,
+            "gunblade_decoder_allocated_bytes_total",
+            "counter",
+            "Bytes that the decoders allocated from the heap.",
+            decoders.allocated_bytes);
+        write_histogram(
+            out,
+            "gunblade_inflate_seconds",
+            "Time spent decompressing bundles, per pull from a decoder.",
+            decoders.inflate_time);
+        write_histogram(
+            out,
+            "gunblade_serialize_seconds",
+            "Time spent serializing each record.",
+            decoders.serialize_time);
+        write_histogram(
+            out,
+            "gunblade_capture_to_serialize_seconds",
+            "Time from capturing a bundle's last packet to serializing the bundle.",
+            decoders.latency);
+        write_histogram(
+            out,
+            "gunblade_bundle_transit_seconds",
+            "Time from a bundle's epoch, on the sender's clock, to capturing it.",
+            decoders.transit_time);
+
+        write_metric(
+            out,
+            "gunblade_flow_buffer_limit_bytes",
+            "gauge",
+            "The most bytes that every flow may buffer between them.",
+            memory.limit);
+        write_metric(
+            out,
+            "gunblade_flow_buffer_bytes",
+            "gauge",
+            "Bytes buffered across every flow.",
+            memory.buffered);
+        write_metric(
+            out,
+            "gunblade_flow_buffer_peak_bytes",
+            "gauge",
+            "The most bytes buffered across every flow at once.",
+            memory.peak_buffered);
+        write_metric(
+            out,
+            "gunblade_flow_buffer_largest_flow_bytes",
+            "gauge",
+            "The most bytes that any one flow has buffered.",
+            memory.largest_flow);
+        write_metric(
+            out,
+            "gunblade_flows",
+            "gauge",
+            "Flows being decoded.",
+            memory.flows);
+        write_metric(
+            out,
+            "gunblade_resyncs_total",
+            "counter",
+            "Times that a flow dropped bytes to resynchronize.",
+            memory.resyncs);
+
+        write_metric(
+            out,
+            "gunblade_sink_written_bytes_total",
+            "counter",
+            "Bytes of output sent.",
+            output.written_bytes);
+        write_metric(
+            out,
+            "gunblade_sink_dropped_batches_total",
+            "counter",
+            "Output batches dropped because the output queue was full.",
+            output.dropped_batches);
+        write_metric(
+            out,
+            "gunblade_sink_dropped_bytes_total",
+            "counter",
+            "Bytes of output dropped because the output queue was full.",
+            output.dropped_bytes);
+        write_metric(
+            out,
+            "gunblade_sink_failed_bytes_total",
+            "counter",
+            "Bytes of output that failed to send.",
+            output.failed_bytes);
+        write_metric(
+            out,
+            "gunblade_sink_queued_bytes",
+            "gauge",
+            "Bytes of output queued to be sent.",
+            output.queued_bytes);
+
+        return out;
+    }
+}  // namespace gunblade
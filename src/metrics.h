@@ -0,0 +1,170 @@
+#pragma once
+
+#include "ffxiv/structs.h"
+#include "histogram.h"
+#include "memory_budget.h"
+#include "output_sink.h"
+#include "pipeline.h"
+
+#include <array>    // array
+#include <atomic>   // atomic
+#include <chrono>   // nanoseconds
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+#include <memory>   // shared_ptr
+#include <mutex>    // mutex
+#include <span>     // span
+#include <string>   // string
+#include <vector>   // vector
+
+namespace gunblade
+{
+    /**
+     * @brief Counts what the decoders have done, cheaply enough to always be on.
+     *
+     * Each stream follower counts into its own `Shard`, so the decoders never
+     * contend with each other, and the shards are only summed when a snapshot
+     * is taken.
+     */
+    class Metrics final
+    {
+    public:
+        /** @brief The counters kept by the kernel for a live capture. */
+        struct CaptureStats
+        {
+            /** @brief Packets that matched the capture filter. */
+            std::uint64_t received = 0;
+
+            /** @brief Packets dropped because the capture buffer was full. */
+            std::uint64_t dropped = 0;
+
+            /** @brief Packets dropped by the network interface or its driver. */
+            std::uint64_t interface_dropped = 0;
+        };
+
+        struct Snapshot
+        {
+            /** @brief Bytes of TCP payload reassembled and fed to the decoders. */
+            std::uint64_t reassembled_bytes = 0;
+
+            /** @brief Bundles decoded with no compression, zlib compression, or another kind. */
+            std::array<std::uint64_t, 3> bundles{};
+
+            /** @brief Bundles skipped because they couldn't be decoded. */
+            std::uint64_t malformed_bundles = 0;
+
+            /** @brief Segments written: IPCs, client keepalives, server keepalives and others. */
+            std::array<std::uint64_t, 4> segments{};
+
+            /** @brief Records written. */
+            std::uint64_t records = 0;
+
+            /** @brief Bytes of records written. */
+            std::uint64_t output_bytes = 0;
+
+            /** @brief Allocations that decoders made from the heap, rather than their arena. */
+            std::uint64_t allocations = 0;
+
+            /** @brief Bytes that decoders allocated from the heap. */
+            std::uint64_t allocated_bytes = 0;
+
+            /** @brief How long each pull from a decoder spent decompressing. */
+            Histogram::Snapshot inflate_time;
+
+            /** @brief How long each record took to serialize. */
+            Histogram::Snapshot serialize_time;
+
+            /**
+             * @brief How long after the packet that completed it each bundle was
+             * serialized. Only measured for live captures.
+             */
+            Histogram::Snapshot latency;
+
+            /**
+             * @brief How long after its epoch each bundle was captured. The epoch
+             * comes from the sender's clock, so this includes any clock skew, and
+             * bundles that seem to be captured before they were sent are only
+             * counted (as `negative`).
+             */
+            Histogram::Snapshot transit_time;
+
+            CaptureStats capture;
+        };
+
+        /** @brief The counters of one stream follower. Must only be updated by one thread. */
+        class Shard final
+        {
+        public:
+            void add_reassembled(std::size_t bytes) noexcept;
+
+            /** @brief Counts a decoded bundle, and the segments of it that are written. */
+            void count_bundle(
+                const ffxiv::BundleView& bundle,
+                std::span<const ffxiv::SegmentView> segments) noexcept;
+
+            void count_malformed() noexcept;
+
+            void record_inflate(std::chrono::nanoseconds duration) noexcept;
+
+            /** @brief Counts a record written, which took @p duration to serialize. */
+            void record_output(std::size_t bytes, std::chrono::nanoseconds duration) noexcept;
+
+            /** @brief Counts an allocation of @p bytes that a decoder made from the heap. */
+            void count_allocation(std::size_t bytes) noexcept;
+
+            /** @brief Records how long after its packet was captured a bundle was serialized. */
+            void record_latency(std::chrono::nanoseconds duration) noexcept;
+
+            /** @brief Records how long after it was sent (by its epoch) a bundle was captured. */
+            void record_transit(std::chrono::nanoseconds duration) noexcept;
+
+        private:
+            friend class Metrics;
+
+            std::atomic<std::uint64_t> reassembled_bytes_ = 0;
+            std::array<std::atomic<std::uint64_t>, 3> bundles_{};
+            std::atomic<std::uint64_t> malformed_bundles_ = 0;
+            std::array<std::atomic<std::uint64_t>, 4> segments_{};
+            std::atomic<std::uint64_t> records_ = 0;
+            std::atomic<std::uint64_t> output_bytes_ = 0;
+            std::atomic<std::uint64_t> allocations_ = 0;
+            std::atomic<std::uint64_t> allocated_bytes_ = 0;
+            Histogram inflate_time_;
+            Histogram serialize_time_;
+            Histogram latency_;
+            Histogram transit_time_;
+        };
+
+        /** @returns A new shard, for one stream follower to count into. */
+        std::shared_ptr<Shard> add_shard();
+
+        /** @brief Records the latest counters of the live capture. */
+        void set_capture(const CaptureStats& stats) noexcept;
+
+        /** @returns The sum of every shard's counters. */
+        Snapshot snapshot() const;
+
+    private:
+        mutable std::mutex mutex_;
+        std::vector<std::shared_ptr<Shard>> shards_;
+
+        std::atomic<std::uint64_t> captured_ = 0;
+        std::atomic<std::uint64_t> capture_dropped_ = 0;
+        std::atomic<std::uint64_t> interface_dropped_ = 0;
+    };
+
+    /** @brief Everything that's reported about a running capture. */
+    struct MetricsReport
+    {
+        Metrics::Snapshot decoders;
+        Pipeline::Stats pipeline;
+        MemoryBudget::Stats memory;
+        AsyncSink::Stats output;
+    };
+
+    /** @returns @p report as a single line of JSON, with a trailing newline. */
+    std::string to_json_line(const MetricsReport& report);
+
+    /** @returns @p report in the Prometheus text exposition format. */
+    std::string to_prometheus(const MetricsReport& report);
+}  // namespace gunblade
@@ -0,0 +1,286 @@
+#include "metrics_exporter.h"
+
+#include <atomic>       // atomic
+#include <cstdio>       // fflush, fwrite, stderr
+#include <stdexcept>    // runtime_error
+#include <string>       // string
+#include <string_view>  // string_view
+#include <utility>      // move
+
+#include <fmt/format.h>     // format
+#include <spdlog/spdlog.h>  // debug, info
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+using socket_t = SOCKET;
+static constexpr socket_t invalid_socket = INVALID_SOCKET;
+static constexpr int send_flags = 0;
+
+static void close_socket(socket_t socket)
+{
+    closesocket(socket);
+}
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using socket_t = int;
+static constexpr socket_t invalid_socket = -1;
+static constexpr int send_flags = MSG_NOSIGNAL;
+
+static void close_socket(socket_t socket)
+{
+    close(socket);
+}
+#endif
+
+/** @brief Stops a client that never finishes its request from holding up the server. */
+static void set_receive_timeout(socket_t socket, std::chrono::milliseconds timeout)
+{
+#ifdef _WIN32
+    const DWORD value = static_cast<DWORD>(timeout.count());
+#else
+    timeval value{};
+    value.tv_sec = static_cast<decltype(value.tv_sec)>(timeout.count() / 1000);
+    value.tv_usec = static_cast<decltype(value.tv_usec)>((timeout.count() % 1000) * 1000);
+#endif
+
+    setsockopt(
+        socket,
+        SOL_SOCKET,
+        SO_RCVTIMEO,
+        reinterpret_cast<const char*>(&value),
+        sizeof(value));
+}
+
+static void send_all(socket_t socket, std::string_view data)
+{
+    while (!data.empty())
+    {
+        const auto sent = send(socket, data.data(), static_cast<int>(data.size()), send_flags);
+
+        if (sent <= 0)
+        {
+            return;
+        }
+
+        data.remove_prefix(static_cast<std::size_t>(sent));
+    }
+}
+
+static std::string http_response(std::string_view status, std::string_view body)
+{
+    return fmt::format(
+        "HTTP/1.1 {}\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+        "Content-Length: {}\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "{}",
+        status,
+        body.size(),
+        body);
+}
+
+namespace gunblade
+{
+    /** @brief Serves reports to one client at a time, which is plenty for a scraper. */
+    class MetricsExporter::Server final
+    {
+    public:
+        Server(const Gather& gather, std::uint16_t port) : gather_(gather)
+        {
+#ifdef _WIN32
+            WSADATA wsa_data;
+            WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+            listener_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+            if (listener_ == invalid_socket)
+            {
+                throw std::runtime_error("Unable to create the metrics socket");
+            }
+
+            const int reuse = 1;
+            setsockopt(
+                listener_,
+                SOL_SOCKET,
+                SO_REUSEADDR,
+                reinterpret_cast<const char*>(&reuse),
+                sizeof(reuse));
+
+            // Only serve the local machine, since there's no authentication
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = htons(port);
+
+            if (bind(listener_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+                listen(listener_, 8) != 0)
+            {
+                close_socket(listener_);
+                throw std::runtime_error(
+                    fmt::format("Unable to serve metrics on 127.0.0.1:{}", port));
+            }
+
+            spdlog::info("Serving metrics on http://127.0.0.1:{}/metrics", port);
+
+            thread_ = std::thread(&Server::serve_loop, this);
+        }
+
+        ~Server()
+        {
+            stopping_.store(true, std::memory_order_relaxed);
+            thread_.join();
+            close_socket(listener_);
+
+#ifdef _WIN32
+            WSACleanup();
+#endif
+        }
+
+    private:
+        void serve_loop()
+        {
+            while (!stopping_.load(std::memory_order_relaxed))
+            {
+                // Wake up every so often to check whether to stop
+                fd_set readable;
+                FD_ZERO(&readable);
+                FD_SET(listener_, &readable);
+
+                timeval timeout{};
+                timeout.tv_usec = 200 * 1000;
+
+                const auto nfds = static_cast<int>(listener_ + 1);
+
+                if (select(nfds, &readable, nullptr, nullptr, &timeout) <= 0)
+                {
+                    continue;
+                }
+
+                const auto client = accept(listener_, nullptr, nullptr);
+
+                if (client == invalid_socket)
+                {
+                    continue;
+                }
+
+                serve(client);
+                close_socket(client);
+            }
+        }
+
+        void serve(socket_t client)
+        {
+            set_receive_timeout(client, std::chrono::milliseconds(1000));
+
+            // Only the request line matters, but read the whole header so the client sees a reply
+            std::string request;
+            char buffer[1024];
+
+            while (request.size() < 8192 && request.find("\r\n\r\n") == std::string::npos)
+            {
+                const auto received = recv(client, buffer, sizeof(buffer), 0);
+
+                if (received <= 0)
+                {
+                    break;
+                }
+
+                request.append(buffer, static_cast<std::size_t>(received));
+            }
+
+            const auto line = std::string_view(request).substr(0, request.find("\r\n"));
+
+            if (line.starts_with("GET /metrics ") || line.starts_with("GET /metrics?"))
+            {
+                send_all(client, http_response("200 OK", to_prometheus(gather_())));
+            }
+            else
+            {
+                spdlog::debug("Metrics request not found: {}", line);
+                send_all(client, http_response("404 Not Found", "Not found\n"));
+            }
+        }
+
+        const Gather& gather_;
+        socket_t listener_ = invalid_socket;
+        std::thread thread_;
+        std::atomic<bool> stopping_ = false;
+    };
+
+    MetricsExporter::MetricsExporter(
+        Gather gather,
+        std::chrono::milliseconds dump_interval,
+        std::uint16_t port)
+        : gather_(std::move(gather)), dump_interval_(dump_interval)
+    {
+        if (port != 0)
+        {
+            server_ = std::make_unique<Server>(gather_, port);
+        }
+
+        if (dump_interval_.count() > 0)
+        {
+            dumper_ = std::thread(&MetricsExporter::dump_loop, this);
+        }
+    }
+
+    MetricsExporter::~MetricsExporter()
+    {
+        stop();
+    }
+
+    void MetricsExporter::stop()
+    {
+        {
+            std::lock_guard lock(mutex_);
+
+            if (stopped_)
+            {
+                return;
+            }
+
+            stopped_ = true;
+        }
+
+        stopping_.notify_all();
+        server_.reset();
+
+        if (dumper_.joinable())
+        {
+            dumper_.join();
+
+            // Report how the capture ended, too
+            dump();
+        }
+    }
+
+    void MetricsExporter::dump()
+    {
+        const auto line = to_json_line(gather_());
+
+        std::fwrite(line.data(), 1, line.size(), stderr);
+        std::fflush(stderr);
+    }
+
+    void MetricsExporter::dump_loop()
+    {
+        std::unique_lock lock(mutex_);
+
+        while (!stopping_.wait_for(lock, dump_interval_, [this]() { return stopped_; }))
+        {
+            // Don't hold up stopping while the report is gathered and written
+            lock.unlock();
+            dump();
+            lock.lock();
+        }
+    }
+}  // namespace gunblade
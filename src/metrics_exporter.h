@@ -0,0 +1,62 @@
+#pragma once
+
+#include "metrics.h"
+
+#include <chrono>              // milliseconds
+#include <condition_variable>  // condition_variable
+#include <cstdint>             // uint16_t
+#include <functional>          // function
+#include <memory>              // unique_ptr
+#include <mutex>               // mutex
+#include <thread>              // thread
+
+namespace gunblade
+{
+    /**
+     * @brief Reports metrics while a capture runs, by writing them to stderr as
+     * JSON every so often, and by serving them over HTTP for Prometheus to scrape.
+     *
+     * Reports are gathered on the exporter's own threads, so gathering them must
+     * be safe to do from any thread.
+     */
+    class MetricsExporter final
+    {
+    public:
+        /** @brief Gathers a report of the capture as it is right now. */
+        using Gather = std::function<MetricsReport()>;
+
+        /**
+         * @param gather Gathers each report
+         * @param dump_interval How often to write a report to stderr, or zero to never
+         * @param port The port to serve reports on at http://127.0.0.1:<port>/metrics,
+         * or zero to not serve them at all
+         * @throws std::runtime_error If the port can't be listened on.
+         */
+        MetricsExporter(Gather gather, std::chrono::milliseconds dump_interval, std::uint16_t port);
+
+        MetricsExporter(const MetricsExporter&) = delete;
+        MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+        /** @brief Stops the exporter, if it hasn't been stopped already. */
+        ~MetricsExporter();
+
+        /** @brief Stops serving reports, and writes one last report to stderr if dumping. */
+        void stop();
+
+    private:
+        class Server;
+
+        void dump();
+        void dump_loop();
+
+        const Gather gather_;
+        const std::chrono::milliseconds dump_interval_;
+
+        std::unique_ptr<Server> server_;
+        std::thread dumper_;
+
+        std::mutex mutex_;
+        std::condition_variable stopping_;
+        bool stopped_ = false;
+    };
+}  // namespace gunblade
@@ -0,0 +1,521 @@
+#include "options.h"
+#include "trace.h"
+
+#include <algorithm>    // clamp, copy, max
+#include <charconv>     // from_chars
+#include <fstream>      // ifstream
+#include <iterator>     // back_inserter
+#include <limits>       // numeric_limits
+#include <stdexcept>    // invalid_argument
+#include <string_view>  // string_view
+#include <thread>       // thread
+
+#include <fmt/format.h>  // format
+
+/** @brief Parses the value of @p option as a positive number. */
+static std::size_t parse_count(std::string_view option, const std::string& value)
+{
+    std::size_t count = 0;
+    const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), count);
+
+    if (ec != std::errc() || end != value.data() + value.size() || count == 0)
+    {
+        throw std::invalid_argument(
+            fmt::format("{} requires a positive number, not \"{}\"", option, value));
+    }
+
+    return count;
+}
+
+/** @brief Calls @p parse on each item of the comma-separated list @p value. */
+template <typename Parse>
+static void for_each_item(std::string_view value, Parse parse)
+{
+    while (true)
+    {
+        const auto comma = value.find(',');
+        parse(value.substr(0, comma));
+
+        if (comma == std::string_view::npos)
+        {
+            break;
+        }
+
+        value.remove_prefix(comma + 1);
+    }
+}
+
+/** @returns The output target in @p value: "-", "unix:<path>", "tcp:<host>:<port>" or a file. */
+static gunblade::OutputTarget parse_output_target(std::string_view option, std::string_view value)
+{
+    using Kind = gunblade::OutputTarget::Kind;
+
+    gunblade::OutputTarget target;
+
+    if (value == "-")
+    {
+        return target;
+    }
+
+    if (value.starts_with("unix:"))
+    {
+        target.kind = Kind::UNIX_SOCKET;
+        target.path = value.substr(5);
+    }
+    else if (value.starts_with("tcp:"))
+    {
+        // The port comes last, so IPv6 addresses can keep their colons
+        const auto address = value.substr(4);
+        const auto colon = address.rfind(':');
+
+        if (colon == std::string_view::npos || colon == 0)
+        {
+            throw std::invalid_argument(fmt::format("{} needs tcp:<host>:<port>", option));
+        }
+
+        const auto port = parse_count(option, std::string(address.substr(colon + 1)));
+
+        if (port > std::numeric_limits<std::uint16_t>::max())
+        {
+            throw std::invalid_argument(fmt::format("{} needs a valid port number", option));
+        }
+
+        target.kind = Kind::TCP_SOCKET;
+        target.path = address.substr(0, colon);
+        target.port = static_cast<std::uint16_t>(port);
+    }
+    else
+    {
+        target.kind = Kind::FILE;
+        target.path = value.starts_with("file:") ? value.substr(5) : value;
+    }
+
+    if (target.path.empty())
+    {
+        throw std::invalid_argument(fmt::format("{} needs a path", option));
+    }
+
+    return target;
+}
+
+/** @brief Adds the rules in the filter config file at @p path to @p rules. */
+static void read_filter_config(gunblade::ffxiv::FilterRules& rules, const std::string& path)
+{
+    std::ifstream file(path);
+
+    if (!file)
+    {
+        throw std::invalid_argument(fmt::format("Unable to open filter config {}", path));
+    }
+
+    const auto config = gunblade::ffxiv::read_filter_rules(file);
+
+    const auto append = [](auto& to, const auto& from) {
+        std::copy(from.begin(), from.end(), std::back_inserter(to));
+    };
+
+    append(rules.segment_types, config.segment_types);
+    append(rules.opcodes, config.opcodes);
+    append(rules.source_actors, config.source_actors);
+    append(rules.target_actors, config.target_actors);
+
+    if (config.direction.has_value())
+    {
+        rules.direction = config.direction;
+    }
+}
+
+namespace gunblade
+{
+    std::size_t Options::default_workers() noexcept
+    {
+        // Leave room for the capture and writer threads
+        const std::size_t cores = std::thread::hardware_concurrency();
+        return std::clamp<std::size_t>(cores > 2 ? cores - 2 : 1, 1, 8);
+    }
+
+    Options parse_options(int argc, char* argv[])
+    {
+        Options options;
+        bool workers_set = false;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string_view arg = argv[i];
+
+            // Gets the value following an option that requires one
+            const auto value = [&]() -> std::string {
+                if (i + 1 >= argc)
+                {
+                    throw std::invalid_argument(fmt::format("{} requires a value", arg));
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "-h" || arg == "--help")
+            {
+                options.show_help = true;
+            }
+            else if (arg == "-r" || arg == "--read")
+            {
+                options.read_file = value();
+            }
+            else if (arg == "-b" || arg == "--batch")
+            {
+                options.batch.push_back(value());
+            }
+            else if (arg == "-f" || arg == "--format")
+            {
+                const auto format = value();
+
+                if (format == "json")
+                {
+                    options.format = OutputFormat::JSON_LINES;
+                }
+                else if (format == "binary")
+                {
+                    options.format = OutputFormat::BINARY;
+                }
+                else
+                {
+                    throw std::invalid_argument(
+                        fmt::format("{} must be \"json\" or \"binary\"", arg));
+                }
+            }
+            else if (arg == "--timestamps")
+            {
+                options.timestamps = true;
+            }
+            else if (arg == "--output")
+            {
+                options.output = parse_output_target(arg, value());
+            }
+            else if (arg == "--rotate-bytes")
+            {
+                options.rotate_bytes = parse_count(arg, value());
+            }
+            else if (arg == "--rotate-keep")
+            {
+                options.rotate_keep = parse_count(arg, value());
+            }
+            else if (arg == "--backpressure")
+            {
+                const auto backpressure = value();
+
+                if (backpressure == "block")
+                {
+                    options.backpressure = Backpressure::BLOCK;
+                }
+                else if (backpressure == "drop-oldest")
+                {
+                    options.backpressure = Backpressure::DROP_OLDEST;
+                }
+                else if (backpressure == "drop-newest")
+                {
+                    options.backpressure = Backpressure::DROP_NEWEST;
+                }
+                else if (backpressure == "priority")
+                {
+                    options.backpressure = Backpressure::DROP_BY_PRIORITY;
+                }
+                else
+                {
+                    throw std::invalid_argument(fmt::format(
+                        "{} must be \"block\", \"drop-oldest\", \"drop-newest\" or \"priority\"",
+                        arg));
+                }
+            }
+            else if (arg == "--output-buffer")
+            {
+                options.output_buffer = parse_count(arg, value());
+            }
+            else if (arg == "--priority-opcode")
+            {
+                for_each_item(value(), [&options](std::string_view item) {
+                    options.priority_opcodes.push_back(ffxiv::parse_opcode(item));
+                });
+            }
+            else if (arg == "--reassembler")
+            {
+                const auto reassembler = value();
+
+                if (reassembler == "libtins")
+                {
+                    options.reassembler = Reassembler::LIBTINS;
+                }
+                else if (reassembler == "builtin")
+                {
+                    options.reassembler = Reassembler::BUILTIN;
+                }
+                else
+                {
+                    throw std::invalid_argument(
+                        fmt::format("{} must be \"libtins\" or \"builtin\"", arg));
+                }
+            }
+            else if (arg == "--capture")
+            {
+                const auto capture = value();
+
+                if (capture == "pcap")
+                {
+                    options.capture = CaptureBackend::PCAP;
+                }
+                else if (capture == "afpacket")
+                {
+                    options.capture = CaptureBackend::AF_PACKET;
+                }
+                else
+                {
+                    throw std::invalid_argument(
+                        fmt::format("{} must be \"pcap\" or \"afpacket\"", arg));
+                }
+            }
+            else if (arg == "-i" || arg == "--interface")
+            {
+                options.interface = value();
+            }
+            else if (arg == "-j" || arg == "--workers")
+            {
+                options.workers = parse_count(arg, value());
+                workers_set = true;
+            }
+            else if (arg == "--queue-size")
+            {
+                options.queue_size = parse_count(arg, value());
+            }
+            else if (arg == "--max-flow-buffer")
+            {
+                options.max_flow_buffer = parse_count(arg, value());
+            }
+            else if (arg == "--memory-budget")
+            {
+                options.memory_budget = parse_count(arg, value());
+            }
+            else if (arg == "--merge-memory")
+            {
+                options.merge_memory = parse_count(arg, value());
+            }
+            else if (arg == "--spill-dir")
+            {
+                options.spill_directory = value();
+            }
+            else if (arg == "--static-filter")
+            {
+                options.static_filter = true;
+            }
+            else if (arg == "--stats-interval")
+            {
+                options.stats_interval = parse_count(arg, value());
+            }
+            else if (arg == "--metrics-port")
+            {
+                const auto port = parse_count(arg, value());
+
+                if (port > std::numeric_limits<std::uint16_t>::max())
+                {
+                    throw std::invalid_argument(fmt::format("{} must be a port number", arg));
+                }
+
+                options.metrics_port = static_cast<std::uint16_t>(port);
+            }
+            else if (arg == "--trace")
+            {
+                if (!trace::compiled_in)
+                {
+                    throw std::invalid_argument(
+                        fmt::format("{} requires a build with GUNBLADE_TRACING enabled", arg));
+                }
+
+                options.trace_file = value();
+            }
+            else if (arg == "-t" || arg == "--segment-type")
+            {
+                for_each_item(value(), [&options](std::string_view item) {
+                    options.filter.segment_types.push_back(ffxiv::parse_segment_type(item));
+                });
+            }
+            else if (arg == "-o" || arg == "--opcode")
+            {
+                for_each_item(value(), [&options](std::string_view item) {
+                    options.filter.opcodes.push_back(ffxiv::parse_opcode(item));
+                });
+            }
+            else if (arg == "--direction")
+            {
+                options.filter.direction = ffxiv::parse_direction(value());
+            }
+            else if (arg == "--source-actor")
+            {
+                for_each_item(value(), [&options](std::string_view item) {
+                    options.filter.source_actors.push_back(ffxiv::parse_actor_id(item));
+                });
+            }
+            else if (arg == "--target-actor")
+            {
+                for_each_item(value(), [&options](std::string_view item) {
+                    options.filter.target_actors.push_back(ffxiv::parse_actor_id(item));
+                });
+            }
+            else if (arg == "--filter")
+            {
+                read_filter_config(options.filter, value());
+            }
+            else
+            {
+                throw std::invalid_argument(fmt::format("Unknown option: {}", arg));
+            }
+        }
+
+        if (options.read_file.has_value() && !options.batch.empty())
+        {
+            throw std::invalid_argument("--read and --batch can't be used together");
+        }
+
+        if (options.timestamps && options.format != OutputFormat::JSON_LINES)
+        {
+            throw std::invalid_argument("--timestamps only works with --format json");
+        }
+
+        const bool live = !options.read_file.has_value() && options.batch.empty();
+
+        const auto output = options.output.kind;
+
+#ifndef __linux__
+        if (output == OutputTarget::Kind::UNIX_SOCKET || output == OutputTarget::Kind::TCP_SOCKET)
+        {
+            throw std::invalid_argument("--output to a socket is only available on Linux");
+        }
+#endif
+
+        if (options.rotate_bytes > 0 && output != OutputTarget::Kind::FILE)
+        {
+            throw std::invalid_argument("--rotate-bytes only works with --output to a file");
+        }
+
+        if (options.backpressure == Backpressure::DROP_BY_PRIORITY &&
+            options.priority_opcodes.empty())
+        {
+            throw std::invalid_argument("--backpressure priority needs --priority-opcode");
+        }
+
+        if (!options.backpressure.has_value())
+        {
+            // Nothing is lost by waiting during a replay, but a live capture can't wait
+            options.backpressure = live ? Backpressure::DROP_NEWEST : Backpressure::BLOCK;
+        }
+
+        if (options.capture == CaptureBackend::AF_PACKET)
+        {
+#ifndef __linux__
+            throw std::invalid_argument("--capture afpacket is only available on Linux");
+#endif
+
+            if (!live)
+            {
+                throw std::invalid_argument("--capture afpacket only works when sniffing live");
+            }
+
+            options.reassembler = Reassembler::BUILTIN;
+        }
+
+        if (options.reassembler == Reassembler::BUILTIN && live &&
+            options.capture != CaptureBackend::AF_PACKET)
+        {
+            throw std::invalid_argument(
+                "--reassembler builtin only works with --read, --batch or --capture afpacket");
+        }
+
+        // Nothing else needs a core during a batch replay, until the very end
+        if (!options.batch.empty() && !workers_set)
+        {
+            options.workers = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+        }
+
+        return options;
+    }
+
+    std::string usage(const std::string& program)
+    {
+        const Options defaults;
+
+        return fmt::format(
+            "Usage: {} [options]\n"
+            "\n"
+            "Options:\n"
+            "  -h, --help           Show this help text and exit\n"
+            "  -r, --read <file>    Replay a pcap/pcapng capture instead of sniffing live\n"
+            "  -b, --batch <path>   Replay capture files (or directories of them) across\n"
+            "                       every core, merging their output by timestamp.\n"
+            "                       May be given more than once\n"
+            "  -f, --format <fmt>   Write bundles as \"json\" lines or \"binary\" records\n"
+            "                       (default: json)\n"
+            "  --output <target>    Send bundles to \"-\" (stdout), a file, \"unix:<path>\"\n"
+            "                       or \"tcp:<host>:<port>\" (sockets on Linux only)\n"
+            "                       (default: -)\n"
+            "  --rotate-bytes <bytes>\n"
+            "                       Start a new output file once it reaches <bytes>\n"
+            "  --rotate-keep <n>    Keep <n> old output files, as <file>.1 and up\n"
+            "                       (default: 5)\n"
+            "  --backpressure <policy>\n"
+            "                       When output can't keep up: \"block\", \"drop-oldest\",\n"
+            "                       \"drop-newest\" or \"priority\" (drop output without\n"
+            "                       any priority opcodes first) (default: block when\n"
+            "                       replaying, drop-newest when sniffing live)\n"
+            "  --output-buffer <bytes>\n"
+            "                       Queue up to <bytes> of output (default: {})\n"
+            "  --priority-opcode <opcodes>\n"
+            "                       Keep output with IPCs of these types over the rest\n"
+            "  --timestamps         Add when each bundle was captured and serialized to\n"
+            "                       its JSON record, in microseconds since the epoch\n"
+            "  --reassembler <r>    Reassemble TCP streams with \"libtins\" or the\n"
+            "                       \"builtin\" reassembler, which is faster but only\n"
+            "                       replays (as a batch, with --read) or captures with\n"
+            "                       --capture afpacket (default: libtins)\n"
+            "  --capture <backend>  Sniff live with \"pcap\", or with \"afpacket\" sockets\n"
+            "                       that each worker reads from itself, on Linux. Always\n"
+            "                       uses the builtin reassembler (default: pcap)\n"
+            "  -i, --interface <name>\n"
+            "                       Sniff on <name> instead of the default interface\n"
+            "  -j, --workers <n>    Decode on <n> worker threads (default: {}, or every\n"
+            "                       core with --batch)\n"
+            "  --queue-size <n>     Queue up to <n> packets per worker (default: 65536)\n"
+            "  --max-flow-buffer <bytes>\n"
+            "                       Resync a flow that buffers more than <bytes> without\n"
+            "                       completing a bundle (default: {})\n"
+            "  --memory-budget <bytes>\n"
+            "                       Resync flows while they buffer more than <bytes>\n"
+            "                       between them (default: {})\n"
+            "  --merge-memory <bytes>\n"
+            "                       Hold up to <bytes> of a batch replay's output in\n"
+            "                       memory, and spill the rest to disk (default: {})\n"
+            "  --spill-dir <dir>    Spill batch replay output to <dir> (default: the\n"
+            "                       system's temporary directory)\n"
+            "  --static-filter      Don't narrow the capture filter to FFXIV's connections\n"
+            "  --stats-interval <seconds>\n"
+            "                       Write metrics to stderr as a line of JSON every\n"
+            "                       <seconds>, and on exit\n"
+            "  --metrics-port <port>\n"
+            "                       Serve Prometheus metrics on\n"
+            "                       http://127.0.0.1:<port>/metrics\n"
+            "  --trace <file>       Write a Chrome trace of the decoding stages to <file>\n"
+            "                       when the capture ends (needs GUNBLADE_TRACING)\n"
+            "\n"
+            "Filters (lists are comma-separated, numbers may be hex with a 0x prefix):\n"
+            "  -t, --segment-type <types>  Only decode these segment types (ipc,\n"
+            "                              client-keepalive, server-keepalive or numbers)\n"
+            "  -o, --opcode <opcodes>      Only decode IPCs of these types\n"
+            "  --direction <dir>           Only decode data sent \"client-to-server\"\n"
+            "                              or \"server-to-client\"\n"
+            "  --source-actor <ids>        Only decode segments sent by these actors\n"
+            "  --target-actor <ids>        Only decode segments sent to these actors\n"
+            "  --filter <file>             Read more filters from a JSON config file\n",
+            program,
+            defaults.output_buffer,
+            Options::default_workers(),
+            defaults.max_flow_buffer,
+            defaults.memory_budget,
+            defaults.merge_memory);
+    }
+}  // namespace gunblade
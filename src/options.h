@@ -0,0 +1,152 @@
+#pragma once
+
+#include "ffxiv/segment_filter.h"
+#include "ffxiv/structs.h"
+#include "output.h"
+
+#include <cstddef>   // size_t
+#include <cstdint>   // uint16_t
+#include <optional>  // optional
+#include <string>    // string
+#include <vector>    // vector
+
+namespace gunblade
+{
+    /** @brief What reassembles TCP streams out of captured packets. */
+    enum class Reassembler
+    {
+        /** @brief libtins' stream follower. */
+        LIBTINS,
+
+        /**
+         * @brief `TcpReassembler`, which never hands packets to libtins. Replays and
+         * AF_PACKET captures only.
+         */
+        BUILTIN
+    };
+
+    /** @brief What captures packets when sniffing live. */
+    enum class CaptureBackend
+    {
+        /** @brief libpcap, through libtins. */
+        PCAP,
+
+        /**
+         * @brief A Linux `AF_PACKET` socket per worker (see `AfPacketSocket`), which
+         * always uses the built-in reassembler.
+         */
+        AF_PACKET
+    };
+
+    /** @brief The command-line options that Gunblade was run with. */
+    struct Options
+    {
+        /** @brief Whether to print the usage text and exit. */
+        bool show_help = false;
+
+        /**
+         * @brief A pcap/pcapng capture file to replay instead of sniffing live.
+         *
+         * Captures are replayed as fast as they can be read, not in real time.
+         */
+        std::optional<std::string> read_file;
+
+        /**
+         * @brief Capture files, or directories of them, to replay all at once instead
+         * of sniffing live. Their output is merged in timestamp order.
+         */
+        std::vector<std::string> batch;
+
+        /** @brief The format to write decoded bundles in. */
+        OutputFormat format = OutputFormat::JSON_LINES;
+
+        /** @brief Where to send decoded bundles. */
+        OutputTarget output;
+
+        /** @brief When to rotate output files, and how many to keep. */
+        std::size_t rotate_bytes = 0;
+        std::size_t rotate_keep = 5;
+
+        /**
+         * @brief What to do with output that can't be sent as fast as it's
+         * decoded. By default, replays block and live captures drop the newest.
+         */
+        std::optional<Backpressure> backpressure;
+
+        /** @brief The most bytes of output to queue, to ride out a slow consumer. */
+        std::size_t output_buffer = 64 * 1024 * 1024;
+
+        /** @brief The IPC types (opcodes) that are kept over others, when output is dropped. */
+        std::vector<std::uint16_t> priority_opcodes;
+
+        /**
+         * @brief Whether to add when each bundle was captured and serialized to its
+         * JSON record, to measure latency downstream with.
+         */
+        bool timestamps = false;
+
+        /** @brief What reassembles TCP streams. */
+        Reassembler reassembler = Reassembler::LIBTINS;
+
+        /** @brief What captures packets when sniffing live. */
+        CaptureBackend capture = CaptureBackend::PCAP;
+
+        /** @brief The network interface to sniff on, instead of the default one. */
+        std::optional<std::string> interface;
+
+        /**
+         * @brief The number of decode worker threads. Batch replays use every core,
+         * unless told otherwise.
+         */
+        std::size_t workers = default_workers();
+
+        /** @brief The number of packets that can be queued for each worker. */
+        std::size_t queue_size = 65536;
+
+        /** @brief The most bytes that one flow may buffer before resynchronizing. */
+        std::size_t max_flow_buffer = 2 * ffxiv::Bundle::max_length;
+
+        /** @brief The most bytes that every flow may buffer between them. */
+        std::size_t memory_budget = 256 * 1024 * 1024;
+
+        /** @brief The most bytes of a batch replay's output to hold in memory until it's merged. */
+        std::size_t merge_memory = 512 * 1024 * 1024;
+
+        /** @brief Where a batch replay spills its output to, when it doesn't fit in memory. */
+        std::optional<std::string> spill_directory;
+
+        /**
+         * @brief Whether to keep sniffing with the broad base capture filter, rather
+         * than narrowing it down to FFXIV's connections once they're known.
+         */
+        bool static_filter = false;
+
+        /** @brief How often to write metrics to stderr as JSON, in seconds, or 0 to never. */
+        std::size_t stats_interval = 0;
+
+        /** @brief The local port to serve Prometheus metrics on, or 0 to not serve them. */
+        std::uint16_t metrics_port = 0;
+
+        /**
+         * @brief Where to write a Chrome trace of the decoding stages, once the
+         * capture ends. Only available when built with GUNBLADE_TRACING.
+         */
+        std::optional<std::string> trace_file;
+
+        /** @brief Which segments to decode, from both the filter flags and any config file. */
+        ffxiv::FilterRules filter;
+
+        /** @returns The default number of decode worker threads for this machine. */
+        static std::size_t default_workers() noexcept;
+    };
+
+    /**
+     * @brief Parses the command-line arguments that Gunblade was run with.
+     *
+     * @throws std::invalid_argument If the arguments are invalid.
+     */
+    Options parse_options(int argc, char* argv[]);
+
+    /** @returns The usage text for the program named @p program. */
+    std::string usage(const std::string& program);
+}  // namespace gunblade
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>       // microseconds
+#include <cstdint>      // uint16_t, uint64_t
+#include <string>       // string
+#include <string_view>  // string_view
+
+namespace gunblade
+{
+    enum class OutputFormat
+    {
+        /** @brief One JSON object per line - https://jsonlines.org/ */
+        JSON_LINES,
+
+        /** @brief Length-prefixed binary records (see ffxiv/binary_format.h). */
+        BINARY
+    };
+
+    /** @brief Where to send the serialized records. */
+    struct OutputTarget
+    {
+        enum class Kind
+        {
+            STDOUT,
+
+            /** @brief A file, which may be rotated. */
+            FILE,
+
+            /** @brief A Unix domain stream socket, which is connected to. Linux only. */
+            UNIX_SOCKET,
+
+            /** @brief A TCP socket, which is connected to. Linux only. */
+            TCP_SOCKET
+        };
+
+        Kind kind = Kind::STDOUT;
+
+        /** @brief The path of the file or Unix domain socket, or the TCP socket's host. */
+        std::string path;
+
+        /** @brief The TCP socket's port. */
+        std::uint16_t port = 0;
+    };
+
+    /** @brief What to do with output that arrives faster than it can be sent. */
+    enum class Backpressure
+    {
+        /** @brief Wait for room, holding up decoding (and then capturing) until there is. */
+        BLOCK,
+
+        /** @brief Drop the oldest queued output to make room. */
+        DROP_OLDEST,
+
+        /** @brief Drop the output that doesn't fit. */
+        DROP_NEWEST,
+
+        /**
+         * @brief Drop the oldest queued output without any priority records first,
+         * then the output that doesn't fit, unless it has priority records too.
+         */
+        DROP_BY_PRIORITY
+    };
+
+    /** @brief Somewhere to write serialized records to. */
+    class RecordWriter
+    {
+    public:
+        virtual ~RecordWriter() = default;
+
+        /**
+         * @brief Writes one complete record.
+         *
+         * @param record The serialized record (in JSON Lines format, it is
+         * terminated by a newline). It is copied (or written) before this returns.
+         * @param epoch The timestamp of the record's bundle, in milliseconds since
+         * the Unix epoch, for writers that put their records in order.
+         * @param priority Whether the record should be kept over others, when
+         * output has to be dropped.
+         */
+        virtual void write(std::string_view record, std::uint64_t epoch, bool priority) = 0;
+
+        /**
+         * @brief Gets when the packet being followed right now was captured. That's
+         * the packet that completed any record written while following it.
+         *
+         * @return The time since the Unix epoch, or zero if it isn't known.
+         */
+        virtual std::chrono::microseconds capture_time() const noexcept
+        {
+            return std::chrono::microseconds(0);
+        }
+    };
+}  // namespace gunblade
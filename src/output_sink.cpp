@@ -0,0 +1,388 @@
+#include "output_sink.h"
+#include "trace.h"
+
+#include <chrono>        // seconds
+#include <cstddef>       // ptrdiff_t
+#include <iostream>      // cout
+#include <stdexcept>     // runtime_error
+#include <string>        // to_string
+#include <system_error>  // error_code
+#include <utility>       // move
+
+#include <fmt/format.h>     // format
+#include <spdlog/spdlog.h>  // info, warn
+
+/** @brief The most emptied buffers that are kept to be reused. */
+static constexpr std::size_t max_spare_buffers = 64;
+
+/** @brief How long to wait before trying to open a file again, after failing to. */
+static constexpr auto reopen_interval = std::chrono::seconds(1);
+
+namespace gunblade
+{
+    StreamSink::StreamSink(std::ostream& out, std::string_view header) : out_(out)
+    {
+        out_.write(header.data(), static_cast<std::streamsize>(header.size()));
+    }
+
+    bool StreamSink::write(std::string_view records, bool)
+    {
+        out_.write(records.data(), static_cast<std::streamsize>(records.size()));
+        return out_.good();
+    }
+
+    void StreamSink::flush()
+    {
+        out_.flush();
+    }
+
+    FileSink::FileSink(
+        std::filesystem::path path,
+        const RotationOptions& rotation,
+        std::string header)
+        : path_(std::move(path)), rotation_(rotation), header_(std::move(header))
+    {
+        if (!open())
+        {
+            throw std::runtime_error(fmt::format("Unable to open {}", path_.string()));
+        }
+    }
+
+    bool FileSink::write(std::string_view records, bool)
+    {
+        // Records are never split across files, so a file only goes over when one batch does
+        const bool full = file_.is_open() && rotation_.max_bytes > 0 && size_ > header_.size() &&
+                          size_ + records.size() > rotation_.max_bytes;
+
+        if (full && !rotate())
+        {
+            spdlog::warn("Unable to open {}, dropping output until it can be", path_.string());
+            return false;
+        }
+
+        if (!file_.is_open())
+        {
+            // Keep trying to open the file, but not for every batch
+            if (clock::now() < next_attempt_ || !open())
+            {
+                return false;
+            }
+
+            spdlog::info("Reopened {}", path_.string());
+        }
+
+        file_.write(records.data(), static_cast<std::streamsize>(records.size()));
+        size_ += records.size();
+
+        return file_.good();
+    }
+
+    void FileSink::flush()
+    {
+        file_.flush();
+    }
+
+    bool FileSink::open()
+    {
+        next_attempt_ = clock::now() + reopen_interval;
+
+        file_.close();
+        file_.clear();
+        file_.open(path_, std::ios::binary | std::ios::trunc);
+
+        if (!file_.is_open())
+        {
+            return false;
+        }
+
+        file_.write(header_.data(), static_cast<std::streamsize>(header_.size()));
+        size_ = header_.size();
+
+        return true;
+    }
+
+    bool FileSink::rotate()
+    {
+        file_.close();
+
+        const auto rotated = [this](std::size_t index) {
+            auto path = path_;
+            path += "." + std::to_string(index);
+            return path;
+        };
+
+        // Errors are ignored, since files that don't exist yet are expected
+        std::error_code ec;
+
+        if (rotation_.keep == 0)
+        {
+            std::filesystem::remove(path_, ec);
+        }
+        else
+        {
+            std::filesystem::remove(rotated(rotation_.keep), ec);
+
+            for (auto i = rotation_.keep; i > 1; --i)
+            {
+                std::filesystem::rename(rotated(i - 1), rotated(i), ec);
+            }
+
+            std::filesystem::rename(path_, rotated(1), ec);
+        }
+
+        return open();
+    }
+
+    AsyncSink::AsyncSink(std::unique_ptr<OutputSink> sink, const AsyncSinkOptions& options)
+        : sink_(std::move(sink)), options_(options), thread_(&AsyncSink::send_loop, this)
+    {
+        // Do nothing
+    }
+
+    AsyncSink::~AsyncSink()
+    {
+        close();
+    }
+
+    bool AsyncSink::write(std::string_view records, bool priority)
+    {
+        if (records.empty())
+        {
+            return true;
+        }
+
+        std::unique_lock lock(mutex_);
+
+        // Once closing, the sender may have already stopped, so nothing more can be queued
+        if (closing_ || !make_room(lock, records.size(), priority))
+        {
+            ++stats_.dropped_batches;
+            stats_.dropped_bytes += records.size();
+            return false;
+        }
+
+        auto& batch = queue_.emplace_back();
+        batch.priority = priority;
+
+        // Copy into a buffer that's already been allocated, if there is one
+        if (!spare_buffers_.empty())
+        {
+            batch.records = std::move(spare_buffers_.back());
+            spare_buffers_.pop_back();
+        }
+
+        batch.records.assign(records);
+        queued_bytes_ += records.size();
+
+        ready_.notify_one();
+        return true;
+    }
+
+    void AsyncSink::flush()
+    {
+        // Do nothing
+    }
+
+    void AsyncSink::close()
+    {
+        {
+            std::lock_guard lock(mutex_);
+
+            if (closed_)
+            {
+                return;
+            }
+
+            closed_ = true;
+            closing_ = true;
+        }
+
+        ready_.notify_one();
+        room_.notify_all();
+        thread_.join();
+
+        const auto totals = stats();
+
+        if (totals.dropped_batches > 0 || totals.failed_bytes > 0)
+        {
+            spdlog::warn(
+                "Output couldn't keep up: {} batches ({} bytes) dropped, {} bytes failed to send",
+                totals.dropped_batches,
+                totals.dropped_bytes,
+                totals.failed_bytes);
+        }
+    }
+
+    AsyncSink::Stats AsyncSink::stats() const
+    {
+        std::lock_guard lock(mutex_);
+
+        auto totals = stats_;
+        totals.queued_bytes = queued_bytes_ + sending_bytes_;
+
+        return totals;
+    }
+
+    bool AsyncSink::make_room(std::unique_lock<std::mutex>& lock, std::size_t size, bool priority)
+    {
+        if (fits(size))
+        {
+            return true;
+        }
+
+        switch (options_.backpressure)
+        {
+            case Backpressure::BLOCK:
+                room_.wait(lock, [this, size]() { return closing_ || fits(size); });
+
+                // Woken up by close(), which might mean there's still no room
+                return !closing_;
+
+            case Backpressure::DROP_OLDEST:
+                while (!queue_.empty() && !fits(size))
+                {
+                    drop(0);
+                }
+
+                // The batches being sent can't be dropped, so there might still be no room
+                return fits(size);
+
+            case Backpressure::DROP_BY_PRIORITY:
+                for (std::size_t i = 0; i < queue_.size() && !fits(size);)
+                {
+                    if (queue_[i].priority)
+                    {
+                        ++i;
+                    }
+                    else
+                    {
+                        drop(i);
+                    }
+                }
+
+                // Only priority output is left, which is only pushed out by more of it
+                while (priority && !queue_.empty() && !fits(size))
+                {
+                    drop(0);
+                }
+
+                return fits(size);
+
+            case Backpressure::DROP_NEWEST:
+            default:
+                return false;
+        }
+    }
+
+    void AsyncSink::drop(std::size_t index)
+    {
+        auto& batch = queue_[index];
+
+        ++stats_.dropped_batches;
+        stats_.dropped_bytes += batch.records.size();
+        queued_bytes_ -= batch.records.size();
+
+        if (spare_buffers_.size() < max_spare_buffers)
+        {
+            batch.records.clear();
+            spare_buffers_.push_back(std::move(batch.records));
+        }
+
+        queue_.erase(queue_.begin() + static_cast<std::ptrdiff_t>(index));
+    }
+
+    void AsyncSink::send_loop()
+    {
+        trace::set_thread_name("output");
+
+        std::deque<Batch> batches;
+
+        while (true)
+        {
+            {
+                std::unique_lock lock(mutex_);
+                ready_.wait(lock, [this]() { return closing_ || !queue_.empty(); });
+
+                // Only stop once everything that was queued has been sent
+                if (queue_.empty())
+                {
+                    break;
+                }
+
+                // Take the whole queue, so the lock isn't held while sending. Its
+                // bytes still count against the capacity until they've been sent.
+                batches.swap(queue_);
+                sending_bytes_ = queued_bytes_;
+                queued_bytes_ = 0;
+            }
+
+            std::uint64_t written = 0;
+            std::uint64_t failed = 0;
+
+            for (const auto& batch : batches)
+            {
+                GUNBLADE_TRACE_SPAN("send");
+
+                if (sink_->write(batch.records, batch.priority))
+                {
+                    written += batch.records.size();
+                }
+                else
+                {
+                    failed += batch.records.size();
+                }
+            }
+
+            {
+                GUNBLADE_TRACE_SPAN("flush");
+                sink_->flush();
+            }
+
+            {
+                std::lock_guard lock(mutex_);
+                stats_.written_bytes += written;
+                stats_.failed_bytes += failed;
+                sending_bytes_ = 0;
+
+                // Give the buffers back to be reused
+                for (auto& batch : batches)
+                {
+                    if (spare_buffers_.size() >= max_spare_buffers)
+                    {
+                        break;
+                    }
+
+                    batch.records.clear();
+                    spare_buffers_.push_back(std::move(batch.records));
+                }
+            }
+
+            room_.notify_all();
+            batches.clear();
+        }
+    }
+
+    std::unique_ptr<OutputSink> open_sink(
+        const OutputTarget& target,
+        const RotationOptions& rotation,
+        const std::string& header)
+    {
+        switch (target.kind)
+        {
+            case OutputTarget::Kind::FILE:
+                return std::make_unique<FileSink>(target.path, rotation, header);
+
+            case OutputTarget::Kind::UNIX_SOCKET:
+            case OutputTarget::Kind::TCP_SOCKET:
+#ifdef __linux__
+                return std::make_unique<SocketSink>(target, header);
+#else
+                throw std::runtime_error("Sending output to a socket is only available on Linux");
+#endif
+
+            case OutputTarget::Kind::STDOUT:
+            default:
+                return std::make_unique<StreamSink>(std::cout, header);
+        }
+    }
+}  // namespace gunblade
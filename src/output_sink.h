@@ -0,0 +1,280 @@
+#pragma once
+
+#include "output.h"
+
+#include <chrono>              // steady_clock
+#include <condition_variable>  // condition_variable
+#include <cstddef>             // size_t
+#include <cstdint>             // uint64_t
+#include <deque>               // deque
+#include <filesystem>          // path
+#include <fstream>             // ofstream
+#include <memory>              // unique_ptr
+#include <mutex>               // mutex, unique_lock
+#include <ostream>             // ostream
+#include <string>              // string
+#include <string_view>         // string_view
+#include <thread>              // thread
+#include <vector>              // vector
+
+namespace gunblade
+{
+    /** @brief Somewhere to send batches of serialized records to, in order. */
+    class OutputSink
+    {
+    public:
+        virtual ~OutputSink() = default;
+
+        /**
+         * @brief Sends a batch of whole records.
+         *
+         * @param records The records, which are copied (or sent) before this returns
+         * @param priority Whether any of the records should be kept over others,
+         * when output has to be dropped
+         * @return Whether the records were sent (or queued to be). If not, they're lost.
+         */
+        virtual bool write(std::string_view records, bool priority) = 0;
+
+        /** @brief Pushes out whatever has been written so far. */
+        virtual void flush() = 0;
+    };
+
+    /** @brief Writes to a stream, such as stdout. */
+    class StreamSink final : public OutputSink
+    {
+    public:
+        /** @param header What to write first, such as the binary format's stream header */
+        explicit StreamSink(std::ostream& out, std::string_view header = {});
+
+        bool write(std::string_view records, bool priority) override;
+
+        void flush() override;
+
+    private:
+        std::ostream& out_;
+    };
+
+    struct RotationOptions
+    {
+        /** @brief The size at which a file is rotated, or 0 to never rotate it. */
+        std::size_t max_bytes = 0;
+
+        /** @brief The number of rotated files to keep, as "<path>.1" (the newest) and up. */
+        std::size_t keep = 5;
+    };
+
+    /**
+     * @brief Writes to a file, starting a new one whenever it gets too big.
+     *
+     * If a new file can't be opened, the sink tries again (at most once a
+     * second), and whatever is written until then is lost.
+     */
+    class FileSink final : public OutputSink
+    {
+    public:
+        /**
+         * @param header What to start every file with
+         * @throws std::runtime_error If the file can't be opened.
+         */
+        FileSink(std::filesystem::path path, const RotationOptions& rotation, std::string header);
+
+        /** @brief Writes @p records, rotating the file first if they don't fit in it. */
+        bool write(std::string_view records, bool priority) override;
+
+        void flush() override;
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * @brief Opens the file afresh, and writes the header to it.
+         *
+         * @return Whether it succeeded. If not, the file is left closed.
+         */
+        bool open();
+
+        /** @brief Shifts every rotated file up by one, dropping the oldest, then reopens. */
+        bool rotate();
+
+        const std::filesystem::path path_;
+        const RotationOptions rotation_;
+        const std::string header_;
+
+        std::ofstream file_;
+        std::size_t size_ = 0;
+        clock::time_point next_attempt_;
+    };
+
+    /**
+     * @brief Sends to a Unix domain or TCP stream socket, which something else is
+     * listening on. Linux only.
+     *
+     * If the connection drops, the sink reconnects (at most once a second), and
+     * whatever is written until then is lost.
+     */
+    class SocketSink final : public OutputSink
+    {
+    public:
+        /**
+         * @param target A `UNIX_SOCKET` or `TCP_SOCKET` target
+         * @param header What to send first, on every connection
+         * @throws std::runtime_error If the first connection fails.
+         */
+        SocketSink(OutputTarget target, std::string header);
+
+        SocketSink(const SocketSink&) = delete;
+        SocketSink& operator=(const SocketSink&) = delete;
+
+        ~SocketSink() override;
+
+        bool write(std::string_view records, bool priority) override;
+
+        /** @brief Does nothing, since nothing is buffered. */
+        void flush() override;
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * @brief Connects and sends the header.
+         *
+         * @return Whether it succeeded. If not, the error is in `errno`.
+         */
+        bool connect();
+
+        /** @brief Sends all of @p data, closing the socket if that fails. */
+        bool send_all(std::string_view data);
+
+        void close() noexcept;
+
+        const OutputTarget target_;
+        const std::string header_;
+
+        int fd_ = -1;
+        clock::time_point next_attempt_;
+    };
+
+    struct AsyncSinkOptions
+    {
+        /**
+         * @brief The most bytes of output to hold, counting the batches being sent.
+         * A batch bigger than this is still queued when nothing else is held.
+         */
+        std::size_t capacity = 64 * 1024 * 1024;
+
+        /** @brief What to do with output that doesn't fit in the queue. */
+        Backpressure backpressure = Backpressure::BLOCK;
+    };
+
+    /**
+     * @brief Sends output to another sink from a thread of its own, through a
+     * bounded queue, so that a slow consumer never holds up whatever writes to it.
+     *
+     * Unless told to block, output that doesn't fit in the queue is dropped, and
+     * counted. The other sink is flushed whenever the queue runs dry. May be
+     * written to from any one thread at a time.
+     */
+    class AsyncSink final : public OutputSink
+    {
+    public:
+        struct Stats
+        {
+            /** @brief Bytes sent. */
+            std::uint64_t written_bytes = 0;
+
+            /** @brief Batches dropped because the queue was full. */
+            std::uint64_t dropped_batches = 0;
+
+            /** @brief Bytes dropped because the queue was full. */
+            std::uint64_t dropped_bytes = 0;
+
+            /** @brief Bytes that the other sink failed to send. */
+            std::uint64_t failed_bytes = 0;
+
+            /** @brief Bytes currently queued or being sent. */
+            std::size_t queued_bytes = 0;
+        };
+
+        AsyncSink(std::unique_ptr<OutputSink> sink, const AsyncSinkOptions& options);
+
+        AsyncSink(const AsyncSink&) = delete;
+        AsyncSink& operator=(const AsyncSink&) = delete;
+
+        /** @brief Closes the sink, if it hasn't been closed already. */
+        ~AsyncSink() override;
+
+        /**
+         * @brief Queues @p records to be sent. Once the sink is closing, they're dropped.
+         *
+         * @return Whether they were queued, rather than dropped.
+         */
+        bool write(std::string_view records, bool priority) override;
+
+        /** @brief Does nothing, since the other sink is flushed as soon as the queue is empty. */
+        void flush() override;
+
+        /** @brief Sends everything that's queued, then stops the thread. */
+        void close();
+
+        /** @returns A snapshot of the sink's counters. */
+        Stats stats() const;
+
+    private:
+        struct Batch
+        {
+            std::string records;
+            bool priority = false;
+        };
+
+        /**
+         * @brief Makes room for @p size more bytes, as the backpressure policy says to.
+         *
+         * @return Whether there's room now. If not, the new batch should be dropped.
+         */
+        bool make_room(std::unique_lock<std::mutex>& lock, std::size_t size, bool priority);
+
+        /** @brief Drops the queued batch at @p index. */
+        void drop(std::size_t index);
+
+        /** @returns Whether @p size more bytes fit, alongside those queued or being sent. */
+        inline bool fits(std::size_t size) const noexcept
+        {
+            const auto held = queued_bytes_ + sending_bytes_;
+            return held == 0 || held + size <= options_.capacity;
+        }
+
+        void send_loop();
+
+        const std::unique_ptr<OutputSink> sink_;
+        const AsyncSinkOptions options_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable ready_;
+        std::condition_variable room_;
+
+        std::deque<Batch> queue_;
+        std::size_t queued_bytes_ = 0;
+
+        /** @brief The bytes that the sender has taken from the queue, but not yet sent. */
+        std::size_t sending_bytes_ = 0;
+
+        /** @brief Emptied buffers, to be reused. */
+        std::vector<std::string> spare_buffers_;
+
+        Stats stats_;
+        bool closing_ = false;
+        bool closed_ = false;
+        std::thread thread_;
+    };
+
+    /**
+     * @brief Opens a sink that sends to @p target, but only from the calling thread.
+     *
+     * @param header What to start the output with, and every new file or connection
+     * @throws std::runtime_error If the target can't be opened.
+     */
+    std::unique_ptr<OutputSink> open_sink(
+        const OutputTarget& target,
+        const RotationOptions& rotation,
+        const std::string& header);
+}  // namespace gunblade
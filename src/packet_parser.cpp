@@ -0,0 +1,265 @@
+#include "packet_parser.h"
+
+#include <algorithm>  // copy_n, min
+#include <cstddef>    // size_t
+
+using Bytes = std::span<const std::uint8_t>;
+
+static constexpr std::uint16_t ethertype_ipv4 = 0x0800;
+static constexpr std::uint16_t ethertype_ipv6 = 0x86dd;
+static constexpr std::uint16_t ethertype_vlan = 0x8100;
+static constexpr std::uint16_t ethertype_qinq = 0x88a8;
+
+static constexpr std::uint8_t protocol_tcp = 6;
+
+static inline std::uint16_t read_be16(Bytes bytes, std::size_t offset) noexcept
+{
+    return static_cast<std::uint16_t>((bytes[offset] << 8) | bytes[offset + 1]);
+}
+
+static inline std::uint32_t read_be32(Bytes bytes, std::size_t offset) noexcept
+{
+    return (std::uint32_t{bytes[offset]} << 24) | (std::uint32_t{bytes[offset + 1]} << 16) |
+           (std::uint32_t{bytes[offset + 2]} << 8) | std::uint32_t{bytes[offset + 3]};
+}
+
+/** @brief Parses the TCP header at the start of @p segment into @p packet. */
+static bool parse_tcp(Bytes segment, gunblade::TcpPacketView& packet) noexcept
+{
+    if (segment.size() < 20)
+    {
+        return false;
+    }
+
+    const std::size_t header_length = (segment[12] >> 4) * 4u;
+
+    if (header_length < 20 || header_length > segment.size())
+    {
+        return false;
+    }
+
+    packet.src_port = read_be16(segment, 0);
+    packet.dst_port = read_be16(segment, 2);
+    packet.seq = read_be32(segment, 4);
+    packet.ack = read_be32(segment, 8);
+    packet.flags = segment[13];
+    packet.payload = segment.subspan(header_length);
+
+    return true;
+}
+
+static std::optional<gunblade::TcpPacketView> parse_ipv4(Bytes ip) noexcept
+{
+    if (ip.size() < 20 || (ip[0] >> 4) != 4)
+    {
+        return std::nullopt;
+    }
+
+    const std::size_t header_length = (ip[0] & 0x0f) * 4u;
+    const std::size_t total_length = read_be16(ip, 2);
+
+    if (header_length < 20 || total_length < header_length || header_length > ip.size())
+    {
+        return std::nullopt;
+    }
+
+    // Fragments would need reassembling first, which nothing upstream does either
+    const auto fragment = read_be16(ip, 6);
+
+    if ((fragment & 0x3fff) != 0 || ip[9] != protocol_tcp)
+    {
+        return std::nullopt;
+    }
+
+    // Drop any link-layer padding, but keep what there is of a truncated packet
+    ip = ip.first(std::min(total_length, ip.size()));
+
+    gunblade::TcpPacketView packet;
+    packet.ip = ip;
+    std::copy_n(ip.begin() + 12, 4, packet.src_addr.begin());
+    std::copy_n(ip.begin() + 16, 4, packet.dst_addr.begin());
+
+    if (!parse_tcp(ip.subspan(header_length), packet))
+    {
+        return std::nullopt;
+    }
+
+    return packet;
+}
+
+static std::optional<gunblade::TcpPacketView> parse_ipv6(Bytes ip) noexcept
+{
+    if (ip.size() < 40 || (ip[0] >> 4) != 6)
+    {
+        return std::nullopt;
+    }
+
+    // A payload length of 0 means a jumbogram, which never carries game traffic
+    const std::size_t payload_length = read_be16(ip, 4);
+
+    if (payload_length == 0)
+    {
+        return std::nullopt;
+    }
+
+    ip = ip.first(std::min(40 + payload_length, ip.size()));
+
+    // Skip past any extension headers to the TCP header
+    auto next_header = ip[6];
+    std::size_t offset = 40;
+
+    while (next_header != protocol_tcp)
+    {
+        std::size_t length = 0;
+
+        switch (next_header)
+        {
+            case 0:   // Hop-by-hop options
+            case 43:  // Routing
+            case 60:  // Destination options
+                if (offset + 2 > ip.size())
+                {
+                    return std::nullopt;
+                }
+
+                length = (ip[offset + 1] + 1u) * 8u;
+                break;
+
+            case 51:  // Authentication
+                if (offset + 2 > ip.size())
+                {
+                    return std::nullopt;
+                }
+
+                length = (ip[offset + 1] + 2u) * 4u;
+                break;
+
+            default:
+                // Fragments, or anything else that isn't TCP
+                return std::nullopt;
+        }
+
+        next_header = ip[offset];
+        offset += length;
+
+        if (offset > ip.size())
+        {
+            return std::nullopt;
+        }
+    }
+
+    gunblade::TcpPacketView packet;
+    packet.ip = ip;
+    packet.is_v6 = true;
+    std::copy_n(ip.begin() + 8, 16, packet.src_addr.begin());
+    std::copy_n(ip.begin() + 24, 16, packet.dst_addr.begin());
+
+    if (!parse_tcp(ip.subspan(offset), packet))
+    {
+        return std::nullopt;
+    }
+
+    return packet;
+}
+
+/** @brief Parses an IP packet of either version, telling them apart by the version field. */
+static std::optional<gunblade::TcpPacketView> parse_ip(Bytes ip) noexcept
+{
+    if (ip.empty())
+    {
+        return std::nullopt;
+    }
+
+    switch (ip[0] >> 4)
+    {
+        case 4:
+            return parse_ipv4(ip);
+
+        case 6:
+            return parse_ipv6(ip);
+
+        default:
+            return std::nullopt;
+    }
+}
+
+static std::optional<gunblade::TcpPacketView> parse_ethertype(
+    std::uint16_t ethertype,
+    Bytes payload) noexcept
+{
+    switch (ethertype)
+    {
+        case ethertype_ipv4:
+            return parse_ipv4(payload);
+
+        case ethertype_ipv6:
+            return parse_ipv6(payload);
+
+        default:
+            return std::nullopt;
+    }
+}
+
+static std::optional<gunblade::TcpPacketView> parse_ethernet(Bytes frame) noexcept
+{
+    if (frame.size() < 14)
+    {
+        return std::nullopt;
+    }
+
+    auto ethertype = read_be16(frame, 12);
+    std::size_t offset = 14;
+
+    // Skip any VLAN tags, each of which is followed by the real ethertype
+    while (ethertype == ethertype_vlan || ethertype == ethertype_qinq)
+    {
+        if (offset + 4 > frame.size())
+        {
+            return std::nullopt;
+        }
+
+        ethertype = read_be16(frame, offset + 2);
+        offset += 4;
+    }
+
+    return parse_ethertype(ethertype, frame.subspan(offset));
+}
+
+namespace gunblade
+{
+    std::optional<TcpPacketView> parse_tcp_packet(
+        std::uint32_t link_type,
+        std::span<const std::uint8_t> frame) noexcept
+    {
+        switch (link_type)
+        {
+            case link_type::ethernet:
+                return parse_ethernet(frame);
+
+            case link_type::raw:
+                return parse_ip(frame);
+
+            case link_type::ipv4:
+                return parse_ipv4(frame);
+
+            case link_type::ipv6:
+                return parse_ipv6(frame);
+
+            case link_type::null:
+            case link_type::loop:
+                // The address family of IPv6 differs between systems, so go by the IP version
+                return frame.size() >= 4 ? parse_ip(frame.subspan(4)) : std::nullopt;
+
+            case link_type::linux_sll:
+                return frame.size() >= 16 ? parse_ethertype(read_be16(frame, 14), frame.subspan(16))
+                                          : std::nullopt;
+
+            case link_type::linux_sll2:
+                return frame.size() >= 20 ? parse_ethertype(read_be16(frame, 0), frame.subspan(20))
+                                          : std::nullopt;
+
+            default:
+                return std::nullopt;
+        }
+    }
+}  // namespace gunblade
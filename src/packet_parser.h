@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>     // array
+#include <chrono>    // microseconds
+#include <cstdint>   // uint8_t, uint16_t, uint32_t
+#include <optional>  // optional
+#include <span>      // span
+
+namespace gunblade
+{
+    /** @brief The link-layer header types (pcap's LINKTYPE_ values) that can be parsed. */
+    namespace link_type
+    {
+        /** @brief BSD loopback: a 4-byte address family, in the capturing host's byte order. */
+        inline constexpr std::uint32_t null = 0;
+
+        inline constexpr std::uint32_t ethernet = 1;
+
+        /** @brief Raw IPv4 or IPv6, with no link-layer header. */
+        inline constexpr std::uint32_t raw = 101;
+
+        /** @brief OpenBSD loopback: a 4-byte address family, in network byte order. */
+        inline constexpr std::uint32_t loop = 108;
+
+        /** @brief Linux "cooked" capture, as captured on the "any" interface. */
+        inline constexpr std::uint32_t linux_sll = 113;
+
+        inline constexpr std::uint32_t ipv4 = 228;
+        inline constexpr std::uint32_t ipv6 = 229;
+
+        /** @brief Linux "cooked" capture, version 2. */
+        inline constexpr std::uint32_t linux_sll2 = 276;
+    }  // namespace link_type
+
+    /** @brief A TCP segment, parsed in place from a captured frame. */
+    struct TcpPacketView
+    {
+        /** @brief The IP packet that carries the segment, from its header on. */
+        std::span<const std::uint8_t> ip;
+
+        bool is_v6 = false;
+
+        /** @brief The source address, in network byte order. IPv4 uses the first 4 bytes. */
+        std::array<std::uint8_t, 16> src_addr{};
+
+        /** @brief The destination address, in network byte order. IPv4 uses the first 4 bytes. */
+        std::array<std::uint8_t, 16> dst_addr{};
+
+        std::uint16_t src_port = 0;
+        std::uint16_t dst_port = 0;
+        std::uint32_t seq = 0;
+        std::uint32_t ack = 0;
+
+        /** @brief The TCP flags, as in the header (FIN is bit 0). */
+        std::uint8_t flags = 0;
+
+        /** @brief The segment's payload, which is cut short if the capture was. */
+        std::span<const std::uint8_t> payload;
+    };
+
+    /** @brief A TCP segment that was parsed in place, and when it was captured. */
+    struct CapturedPacket
+    {
+        /** @brief When the packet was captured, since the Unix epoch. */
+        std::chrono::microseconds timestamp{0};
+
+        /** @brief The packet, which points into wherever it was captured to. */
+        TcpPacketView tcp;
+    };
+
+    /**
+     * @brief Parses just enough of a captured frame to find its TCP segment.
+     *
+     * Understands Ethernet (with any VLAN tags), Linux cooked captures, loopback
+     * and raw IP link layers, IPv4 and IPv6 (skipping any extension headers),
+     * and TCP. Nothing is copied, so the view points into @p frame.
+     *
+     * @param link_type The link-layer header type of @p frame (see `link_type`)
+     * @param frame The captured bytes
+     * @return The TCP segment, or nothing if the frame isn't an unfragmented
+     * TCP segment, or is malformed.
+     */
+    std::optional<TcpPacketView> parse_tcp_packet(
+        std::uint32_t link_type,
+        std::span<const std::uint8_t> frame) noexcept;
+}  // namespace gunblade
@@ -0,0 +1,461 @@
+#include "flow_hash.h"
+#include "pipeline.h"
+#include "spsc_queue.h"
+#include "trace.h"
+
+#include <algorithm>    // max
+#include <chrono>       // microseconds, steady_clock, system_clock
+#include <span>         // span
+#include <string>       // string, to_string
+#include <string_view>  // string_view
+#include <utility>      // move
+#include <vector>       // vector
+
+#include <spdlog/spdlog.h>  // info, warn
+
+/** @brief Waits a little longer each time a thread finds nothing to do. */
+static void backoff(unsigned int& attempts)
+{
+    if (attempts < 64)
+    {
+        // Stay hot for a while, since more work usually follows soon
+    }
+    else if (attempts < 128)
+    {
+        std::this_thread::yield();
+    }
+    else
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    ++attempts;
+}
+
+namespace gunblade
+{
+    /** @brief A batch of output, handed from a worker to the writer thread. */
+    struct OutputBatch
+    {
+        std::string records;
+
+        /**
+         * @brief When the packet that completed the batch's first record was
+         * captured, or zero if that isn't known.
+         */
+        std::chrono::microseconds captured{0};
+
+        /** @brief Whether any of the batch's records should be kept over others. */
+        bool priority = false;
+    };
+
+    class Pipeline::Worker final : public RecordWriter
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        Worker(const PipelineOptions& options, const FollowerSetup& setup, Pipeline& pipeline)
+            : packets(options.packet_queue_capacity),
+              output(options.output_queue_capacity),
+              spare_buffers(options.output_queue_capacity),
+              pipeline_(pipeline)
+        {
+            setup(follower_, *this);
+        }
+
+        /** @brief A worker that reads its own packets from @p source, rather than the queue. */
+        Worker(
+            const PipelineOptions& options,
+            const ReassemblerSetup& setup,
+            PacketSource& source,
+            Pipeline& pipeline)
+            : packets(1),
+              output(options.output_queue_capacity),
+              spare_buffers(options.output_queue_capacity),
+              pipeline_(pipeline),
+              source_(&source)
+        {
+            setup(reassembler_, *this);
+        }
+
+        void start(std::size_t index)
+        {
+            thread_ = std::thread([this, index]() {
+                trace::set_thread_name("worker " + std::to_string(index));
+
+                if (source_)
+                {
+                    poll();
+                }
+                else
+                {
+                    run();
+                }
+            });
+        }
+
+        void stop()
+        {
+            stopping_.store(true, std::memory_order_release);
+            thread_.join();
+        }
+
+        void write(std::string_view record, std::uint64_t, bool priority) override
+        {
+            if (batch_.records.empty())
+            {
+                batch_started_ = clock::now();
+                batch_.captured = packet_time_;
+                batch_.priority = false;
+            }
+
+            batch_.records.append(record);
+            batch_.priority |= priority;
+
+            if (batch_.records.size() >= pipeline_.options_.output_batch_bytes)
+            {
+                flush();
+            }
+        }
+
+        std::chrono::microseconds capture_time() const noexcept override
+        {
+            return packet_time_;
+        }
+
+        /** @brief Packets from the capture thread. */
+        SpscQueue<Tins::Packet> packets;
+
+        /** @brief Batches of output for the writer thread. */
+        SpscQueue<OutputBatch> output;
+
+        /** @brief Emptied batches handed back by the writer thread, to be reused. */
+        SpscQueue<std::string> spare_buffers;
+
+        std::atomic<std::uint64_t> submitted = 0;
+        std::atomic<std::uint64_t> dropped_packets = 0;
+        std::atomic<std::uint64_t> writes = 0;
+        std::atomic<std::uint64_t> dropped_writes = 0;
+
+    private:
+        void run()
+        {
+            const auto batch_size = std::max<std::size_t>(pipeline_.options_.packet_batch_size, 1);
+            std::vector<Tins::Packet> batch(batch_size);
+            unsigned int attempts = 0;
+
+            while (true)
+            {
+                if (const auto count = packets.try_pop_bulk(batch); count > 0)
+                {
+                    follow(std::span(batch).first(count));
+                    attempts = 0;
+
+                    // Don't sit on output for too long while busy
+                    if (!batch_.records.empty() &&
+                        clock::now() - batch_started_ >= pipeline_.options_.output_batch_interval)
+                    {
+                        flush();
+                    }
+
+                    continue;
+                }
+
+                // Nothing else to do right now, so hand over whatever output there is
+                flush();
+
+                // Only stop once everything that was submitted has been processed
+                if (stopping_.load(std::memory_order_acquire) && packets.empty())
+                {
+                    break;
+                }
+
+                backoff(attempts);
+            }
+        }
+
+        /** @brief Follows the packets from the worker's own source, until stopped. */
+        void poll()
+        {
+            const auto timeout = pipeline_.options_.output_batch_interval;
+
+            while (!stopping_.load(std::memory_order_acquire))
+            {
+                const auto batch = source_->next_batch(timeout);
+
+                if (batch.empty())
+                {
+                    flush();
+                    continue;
+                }
+
+                {
+                    GUNBLADE_TRACE_SPAN("reassemble");
+
+                    // Output is decoded once per batch, so it's all stamped with the last packet
+                    packet_time_ = batch.back().timestamp;
+                    reassembler_.process(batch);
+                }
+
+                submitted.fetch_add(batch.size(), std::memory_order_relaxed);
+
+                if (!batch_.records.empty() &&
+                    clock::now() - batch_started_ >= pipeline_.options_.output_batch_interval)
+                {
+                    flush();
+                }
+            }
+
+            flush();
+        }
+
+        /** @brief Reassembles @p packets, decoding whatever they complete. */
+        void follow(std::span<Tins::Packet> packets)
+        {
+            GUNBLADE_TRACE_SPAN("reassemble");
+
+            for (auto& packet : packets)
+            {
+                packet_time_ = packet_time(packet);
+                follower_.process_packet(packet);
+            }
+        }
+
+        /** @brief Hands the current batch of output to the writer thread. */
+        void flush()
+        {
+            if (batch_.records.empty())
+            {
+                return;
+            }
+
+            unsigned int attempts = 0;
+
+            while (!output.try_push(batch_))
+            {
+                if (pipeline_.options_.drop_when_full)
+                {
+                    dropped_writes.fetch_add(1, std::memory_order_relaxed);
+                    pipeline_.warn_drop();
+                    batch_.records.clear();
+                    return;
+                }
+
+                backoff(attempts);
+            }
+
+            writes.fetch_add(1, std::memory_order_relaxed);
+
+            // Start the next batch in a buffer that's already been allocated, if there is one
+            if (spare_buffers.try_pop(batch_.records))
+            {
+                batch_.records.clear();
+            }
+        }
+
+        Pipeline& pipeline_;
+        Tins::TCPIP::StreamFollower follower_;
+        std::thread thread_;
+
+        /** @brief Where the worker reads its packets from, if they aren't submitted. */
+        PacketSource* source_ = nullptr;
+        TcpReassembler reassembler_;
+        std::atomic<bool> stopping_ = false;
+
+        OutputBatch batch_;
+        clock::time_point batch_started_;
+        std::chrono::microseconds packet_time_{0};
+    };
+
+    Pipeline::Pipeline(const PipelineOptions& options, const FollowerSetup& setup, OutputSink& out)
+        : options_(options), out_(out)
+    {
+        const auto count = options.workers > 0 ? options.workers : 1;
+        workers_.reserve(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            workers_.push_back(std::make_unique<Worker>(options_, setup, *this));
+        }
+
+        start();
+    }
+
+    Pipeline::Pipeline(
+        const PipelineOptions& options,
+        const ReassemblerSetup& setup,
+        const std::vector<PacketSource*>& sources,
+        OutputSink& out)
+        : options_(options), out_(out)
+    {
+        workers_.reserve(sources.size());
+
+        for (auto* source : sources)
+        {
+            workers_.push_back(std::make_unique<Worker>(options_, setup, *source, *this));
+        }
+
+        start();
+    }
+
+    Pipeline::~Pipeline()
+    {
+        stop();
+    }
+
+    void Pipeline::submit(Tins::Packet&& packet)
+    {
+        auto& worker = *workers_[flow_hash(*packet.pdu()) % workers_.size()];
+        unsigned int attempts = 0;
+
+        while (!worker.packets.try_push(packet))
+        {
+            if (options_.drop_when_full)
+            {
+                worker.dropped_packets.fetch_add(1, std::memory_order_relaxed);
+                warn_drop();
+                return;
+            }
+
+            backoff(attempts);
+        }
+
+        // Only the capture thread ever counts these, so there's no need for a locked add
+        const auto submitted = worker.submitted.load(std::memory_order_relaxed);
+        worker.submitted.store(submitted + 1, std::memory_order_relaxed);
+    }
+
+    void Pipeline::stop()
+    {
+        if (stopped_)
+        {
+            return;
+        }
+
+        stopped_ = true;
+
+        // Stop the workers first, so the writer sees all of their output
+        for (auto& worker : workers_)
+        {
+            worker->stop();
+        }
+
+        workers_stopped_.store(true, std::memory_order_release);
+        writer_.join();
+
+        const auto totals = stats();
+        spdlog::info(
+            "Pipeline stopped: {} packets ({} dropped), {} writes ({} dropped)",
+            totals.packets,
+            totals.dropped_packets,
+            totals.writes,
+            totals.dropped_writes);
+    }
+
+    Pipeline::Stats Pipeline::stats() const
+    {
+        Stats totals;
+
+        for (const auto& worker : workers_)
+        {
+            totals.packets += worker->submitted.load(std::memory_order_relaxed);
+            totals.dropped_packets += worker->dropped_packets.load(std::memory_order_relaxed);
+            totals.writes += worker->writes.load(std::memory_order_relaxed);
+            totals.dropped_writes += worker->dropped_writes.load(std::memory_order_relaxed);
+            totals.packet_queue_depth += worker->packets.size();
+            totals.output_queue_depth += worker->output.size();
+        }
+
+        totals.output_latency = output_latency_.snapshot();
+
+        return totals;
+    }
+
+    void Pipeline::start()
+    {
+        for (std::size_t i = 0; i < workers_.size(); ++i)
+        {
+            workers_[i]->start(i);
+        }
+
+        writer_ = std::thread(&Pipeline::write_loop, this);
+    }
+
+    void Pipeline::warn_drop()
+    {
+        if (!warned_drop_.exchange(true, std::memory_order_relaxed))
+        {
+            spdlog::warn("Pipeline queue full, dropping data (see the stats on exit)");
+        }
+    }
+
+    void Pipeline::write_loop()
+    {
+        trace::set_thread_name("writer");
+
+        OutputBatch batch;
+        std::vector<std::chrono::microseconds> captured;
+        unsigned int attempts = 0;
+
+        while (true)
+        {
+            // Checked before draining, so nothing queued after this can be missed
+            const bool finished = workers_stopped_.load(std::memory_order_acquire);
+            bool wrote = false;
+
+            for (auto& worker : workers_)
+            {
+                while (worker->output.try_pop(batch))
+                {
+                    GUNBLADE_TRACE_SPAN("write");
+                    out_.write(batch.records, batch.priority);
+                    wrote = true;
+
+                    if (options_.measure_latency && batch.captured.count() > 0)
+                    {
+                        captured.push_back(batch.captured);
+                    }
+
+                    // Give the buffer back to be reused (or free it, if there's no room)
+                    batch.records.clear();
+                    worker->spare_buffers.try_push(batch.records);
+                }
+            }
+
+            if (wrote)
+            {
+                // Flush once per pass, rather than once per record
+                GUNBLADE_TRACE_SPAN("flush");
+                out_.flush();
+                attempts = 0;
+
+                record_latency(captured);
+                captured.clear();
+            }
+            else if (finished)
+            {
+                break;
+            }
+            else
+            {
+                backoff(attempts);
+            }
+        }
+    }
+
+    void Pipeline::record_latency(const std::vector<std::chrono::microseconds>& captured)
+    {
+        if (captured.empty())
+        {
+            return;
+        }
+
+        const auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch());
+
+        for (const auto time : captured)
+        {
+            output_latency_.record(now - time);
+        }
+    }
+}  // namespace gunblade
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "histogram.h"
+#include "output.h"
+#include "output_sink.h"
+#include "packet_parser.h"
+#include "tcp_reassembler.h"
+
+#include <atomic>      // atomic
+#include <chrono>      // microseconds, milliseconds, seconds
+#include <cstddef>     // size_t
+#include <cstdint>     // uint64_t
+#include <functional>  // function
+#include <memory>      // unique_ptr
+#include <span>        // span
+#include <thread>      // thread
+#include <vector>      // vector
+
+#include <tins/packet.h>
+#include <tins/tcp_ip/stream_follower.h>
+
+namespace gunblade
+{
+    /** @returns When @p packet was captured, since the Unix epoch. */
+    inline std::chrono::microseconds packet_time(const Tins::Packet& packet)
+    {
+        const auto& timestamp = packet.timestamp();
+
+        return std::chrono::seconds(timestamp.seconds()) +
+               std::chrono::microseconds(timestamp.microseconds());
+    }
+
+    struct PipelineOptions
+    {
+        /** @brief The number of decode workers. Each one follows a share of the flows. */
+        std::size_t workers = 1;
+
+        /** @brief The number of packets that can be queued for each worker. */
+        std::size_t packet_queue_capacity = 65536;
+
+        /**
+         * @brief The most packets that a worker takes from its queue at once. The
+         * clock is only checked once per batch.
+         */
+        std::size_t packet_batch_size = 64;
+
+        /** @brief The number of output batches that can be queued by each worker. */
+        std::size_t output_queue_capacity = 4096;
+
+        /** @brief The size at which a worker hands its output to the writer thread. */
+        std::size_t output_batch_bytes = 64 * 1024;
+
+        /**
+         * @brief The longest that a worker holds on to output before handing it to
+         * the writer thread. Output is also handed over whenever a worker runs out
+         * of packets to process.
+         */
+        std::chrono::milliseconds output_batch_interval = std::chrono::milliseconds(5);
+
+        /**
+         * @brief Whether to drop packets and output when a queue is full,
+         * instead of waiting for room.
+         *
+         * Live captures should never wait, or the kernel will start dropping
+         * packets instead. Replays should always wait, since nothing is lost.
+         */
+        bool drop_when_full = true;
+
+        /**
+         * @brief Whether to measure how long after its packet was captured each
+         * batch of output was written and flushed (or queued, by an `AsyncSink`).
+         *
+         * Only meaningful for live captures, since replayed packets were captured
+         * long ago.
+         */
+        bool measure_latency = false;
+    };
+
+    /**
+     * @brief Captures a worker's share of the packets, for the worker to read itself,
+     * so that they never pass through the capture thread.
+     */
+    class PacketSource
+    {
+    public:
+        virtual ~PacketSource() = default;
+
+        /**
+         * @brief Waits for the next batch of captured packets.
+         *
+         * @param timeout The longest to wait for
+         * @return The batch, which is valid until the next call, or nothing if no
+         * packets arrived in time.
+         */
+        virtual std::span<const CapturedPacket> next_batch(std::chrono::milliseconds timeout) = 0;
+    };
+
+    /**
+     * @brief Runs TCP reassembly and decoding on worker threads, and output on a writer thread.
+     *
+     * Packets are sharded across the workers by flow, so each flow is only
+     * ever followed (and decoded) by one worker. Each worker has its own
+     * lock-free queue of packets from the capture thread, and its own queue
+     * of output for the writer thread. Workers batch up their output, and the
+     * writer hands the emptied buffers back to be reused.
+     *
+     * Alternatively, each worker reads from its own `PacketSource`, which has
+     * already sharded the packets by flow, and follows them with a
+     * `TcpReassembler`. Then there's no capture thread at all.
+     */
+    class Pipeline final
+    {
+    public:
+        /**
+         * @brief Sets up a worker's stream follower.
+         *
+         * Called once per worker, with the writer that the worker's follower
+         * should write its output to.
+         */
+        using FollowerSetup = std::function<void(Tins::TCPIP::StreamFollower&, RecordWriter&)>;
+
+        /** @brief Sets up a worker's reassembler, with the writer that its output goes to. */
+        using ReassemblerSetup = std::function<void(TcpReassembler&, RecordWriter&)>;
+
+        struct Stats
+        {
+            /** @brief Packets handed to a worker. */
+            std::uint64_t packets = 0;
+
+            /** @brief Packets dropped because a worker's queue was full. */
+            std::uint64_t dropped_packets = 0;
+
+            /** @brief Output batches handed to the writer thread. */
+            std::uint64_t writes = 0;
+
+            /** @brief Output batches dropped because a worker's output queue was full. */
+            std::uint64_t dropped_writes = 0;
+
+            /** @brief Packets currently queued across every worker. */
+            std::size_t packet_queue_depth = 0;
+
+            /** @brief Output batches currently queued across every worker. */
+            std::size_t output_queue_depth = 0;
+
+            /**
+             * @brief How long after the packet that completed its first record each
+             * batch of output was flushed, if measured.
+             */
+            Histogram::Snapshot output_latency;
+        };
+
+        /** @param out Where to write the output to, which must outlive the pipeline */
+        Pipeline(const PipelineOptions& options, const FollowerSetup& setup, OutputSink& out);
+
+        /**
+         * @brief Runs one worker per packet source, instead of `options.workers`.
+         * Nothing may be submitted.
+         *
+         * @param sources The sources to read from, which must outlive the pipeline
+         */
+        Pipeline(
+            const PipelineOptions& options,
+            const ReassemblerSetup& setup,
+            const std::vector<PacketSource*>& sources,
+            OutputSink& out);
+
+        Pipeline(const Pipeline&) = delete;
+        Pipeline& operator=(const Pipeline&) = delete;
+
+        /** @brief Stops the pipeline, if it hasn't been stopped already. */
+        ~Pipeline();
+
+        /**
+         * @brief Hands a captured packet to the worker that follows its flow.
+         *
+         * Must only be called from one thread (the capture thread), and not
+         * when the workers read from packet sources.
+         */
+        void submit(Tins::Packet&& packet);
+
+        /** @brief Finishes processing everything that was submitted, then stops every thread. */
+        void stop();
+
+        /** @returns A snapshot of the pipeline's counters. */
+        Stats stats() const;
+
+    private:
+        class Worker;
+
+        /** @brief Starts the worker threads, and the writer thread. */
+        void start();
+
+        /** @brief Logs a warning the first time anything is dropped. */
+        void warn_drop();
+
+        void write_loop();
+
+        /** @brief Records the latency of each batch of output that was just flushed. */
+        void record_latency(const std::vector<std::chrono::microseconds>& captured);
+
+        const PipelineOptions options_;
+        OutputSink& out_;
+
+        std::vector<std::unique_ptr<Worker>> workers_;
+        std::thread writer_;
+        Histogram output_latency_;
+
+        std::atomic<bool> workers_stopped_ = false;
+        std::atomic<bool> warned_drop_ = false;
+        bool stopped_ = false;
+    };
+}  // namespace gunblade
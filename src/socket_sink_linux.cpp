@@ -0,0 +1,189 @@
+#include "output_sink.h"
+
+#include <cerrno>     // EINTR, errno
+#include <cstring>    // strerror
+#include <stdexcept>  // runtime_error
+#include <string>     // to_string
+#include <utility>    // move
+
+#include <fmt/format.h>     // format
+#include <spdlog/spdlog.h>  // info, warn
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/** @brief How long to wait before trying to reconnect a dropped socket. */
+static constexpr auto reconnect_interval = std::chrono::seconds(1);
+
+/** @returns How to describe @p target in logs. */
+static std::string describe(const gunblade::OutputTarget& target)
+{
+    if (target.kind == gunblade::OutputTarget::Kind::UNIX_SOCKET)
+    {
+        return fmt::format("unix:{}", target.path);
+    }
+
+    return fmt::format("tcp:{}:{}", target.path, target.port);
+}
+
+/** @returns A socket connected to the Unix domain socket at @p path, or -1. */
+static int connect_unix(const std::string& path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (fd >= 0 && ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        const auto error = errno;
+        ::close(fd);
+        errno = error;
+        return -1;
+    }
+
+    return fd;
+}
+
+/** @returns A socket connected to @p host on @p port, or -1. */
+static int connect_tcp(const std::string& host, std::uint16_t port)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* addresses = nullptr;
+
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+    {
+        errno = EHOSTUNREACH;
+        return -1;
+    }
+
+    int fd = -1;
+
+    for (const auto* address = addresses; address != nullptr; address = address->ai_next)
+    {
+        fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+
+        if (fd >= 0 && ::connect(fd, address->ai_addr, address->ai_addrlen) == 0)
+        {
+            break;
+        }
+
+        if (fd >= 0)
+        {
+            const auto error = errno;
+            ::close(fd);
+            errno = error;
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(addresses);
+    return fd;
+}
+
+namespace gunblade
+{
+    SocketSink::SocketSink(OutputTarget target, std::string header)
+        : target_(std::move(target)), header_(std::move(header))
+    {
+        if (!connect())
+        {
+            throw std::runtime_error(fmt::format(
+                "Unable to connect to {}: {}",
+                describe(target_),
+                std::strerror(errno)));
+        }
+    }
+
+    SocketSink::~SocketSink()
+    {
+        close();
+    }
+
+    bool SocketSink::write(std::string_view records, bool)
+    {
+        if (fd_ < 0)
+        {
+            if (clock::now() < next_attempt_)
+            {
+                return false;
+            }
+
+            if (!connect())
+            {
+                return false;
+            }
+
+            spdlog::info("Reconnected to {}", describe(target_));
+        }
+
+        return send_all(records);
+    }
+
+    void SocketSink::flush()
+    {
+        // Do nothing
+    }
+
+    bool SocketSink::connect()
+    {
+        next_attempt_ = clock::now() + reconnect_interval;
+
+        fd_ = target_.kind == OutputTarget::Kind::UNIX_SOCKET
+                  ? connect_unix(target_.path)
+                  : connect_tcp(target_.path, target_.port);
+
+        return fd_ >= 0 && send_all(header_);
+    }
+
+    bool SocketSink::send_all(std::string_view data)
+    {
+        while (!data.empty())
+        {
+            // Don't let a consumer that hung up kill the process with SIGPIPE
+            const auto sent = send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+
+            if (sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (sent < 0)
+            {
+                spdlog::warn(
+                    "Lost the connection to {}: {}",
+                    describe(target_),
+                    std::strerror(errno));
+
+                close();
+                return false;
+            }
+
+            data.remove_prefix(static_cast<std::size_t>(sent));
+        }
+
+        return true;
+    }
+
+    void SocketSink::close() noexcept
+    {
+        if (fd_ >= 0)
+        {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+}  // namespace gunblade
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>  // min
+#include <atomic>     // atomic, memory_order
+#include <bit>        // bit_ceil
+#include <cstddef>    // size_t
+#include <memory>     // unique_ptr
+#include <span>       // span
+#include <utility>    // move
+
+namespace gunblade
+{
+    /**
+     * @brief A bounded, lock-free, single-producer single-consumer queue.
+     *
+     * Exactly one thread may push and exactly one (other) thread may pop.
+     *
+     * @tparam T The type of the queued values, which must be default-constructible
+     * and move-assignable. Popped slots are left in a moved-from state.
+     */
+    template <typename T>
+    class SpscQueue final
+    {
+    public:
+        /** @param capacity The minimum number of values the queue can hold at once. */
+        explicit SpscQueue(std::size_t capacity)
+            : capacity_(std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity)),
+              mask_(capacity_ - 1),
+              slots_(std::make_unique<T[]>(capacity_))
+        {
+            // Do nothing
+        }
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        /**
+         * @brief Pushes a value onto the queue. Must only be called by the producer.
+         *
+         * @return Whether the value was pushed. If the queue was full,
+         * @p value is left untouched.
+         */
+        bool try_push(T& value)
+        {
+            const auto tail = tail_.load(std::memory_order_relaxed);
+
+            // Only re-read the consumer's index when the cached one says we're full
+            if (tail - head_cache_ == capacity_)
+            {
+                head_cache_ = head_.load(std::memory_order_acquire);
+
+                if (tail - head_cache_ == capacity_)
+                {
+                    return false;
+                }
+            }
+
+            slots_[tail & mask_] = std::move(value);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Pops a value off the queue. Must only be called by the consumer.
+         *
+         * @return Whether a value was popped into @p value.
+         */
+        bool try_pop(T& value)
+        {
+            const auto head = head_.load(std::memory_order_relaxed);
+
+            // Only re-read the producer's index when the cached one says we're empty
+            if (head == tail_cache_)
+            {
+                tail_cache_ = tail_.load(std::memory_order_acquire);
+
+                if (head == tail_cache_)
+                {
+                    return false;
+                }
+            }
+
+            value = std::move(slots_[head & mask_]);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Pops as many values as are queued, up to the size of @p values.
+         * Must only be called by the consumer.
+         *
+         * Popping many values at once only hands the slots back to the producer once.
+         *
+         * @return The number of values popped into the front of @p values.
+         */
+        std::size_t try_pop_bulk(std::span<T> values)
+        {
+            const auto head = head_.load(std::memory_order_relaxed);
+
+            // Only re-read the producer's index when the cached one says there isn't enough
+            if (tail_cache_ - head < values.size())
+            {
+                tail_cache_ = tail_.load(std::memory_order_acquire);
+            }
+
+            const auto count = std::min(tail_cache_ - head, values.size());
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                values[i] = std::move(slots_[(head + i) & mask_]);
+            }
+
+            if (count > 0)
+            {
+                head_.store(head + count, std::memory_order_release);
+            }
+
+            return count;
+        }
+
+        /** @returns The number of queued values. Only approximate while in use. */
+        inline std::size_t size() const noexcept
+        {
+            const auto tail = tail_.load(std::memory_order_acquire);
+            const auto head = head_.load(std::memory_order_acquire);
+            return tail - head;
+        }
+
+        inline bool empty() const noexcept
+        {
+            return size() == 0;
+        }
+
+        inline std::size_t capacity() const noexcept
+        {
+            return capacity_;
+        }
+
+    private:
+        static constexpr std::size_t cache_line_size = 64;
+
+        const std::size_t capacity_;
+        const std::size_t mask_;
+        const std::unique_ptr<T[]> slots_;
+
+        /** @brief The next slot to pop, and the consumer's cached copy of `tail_`. */
+        alignas(cache_line_size) std::atomic<std::size_t> head_ = 0;
+        std::size_t tail_cache_ = 0;
+
+        /** @brief The next slot to push, and the producer's cached copy of `head_`. */
+        alignas(cache_line_size) std::atomic<std::size_t> tail_ = 0;
+        std::size_t head_cache_ = 0;
+    };
+}  // namespace gunblade
@@ -0,0 +1,405 @@
+#include "flow_hash.h"
+#include "tcp_reassembler.h"
+
+#include <algorithm>  // upper_bound
+#include <vector>     // erase
+#include <utility>    // move
+
+static constexpr std::uint8_t tcp_fin = 0x01;
+static constexpr std::uint8_t tcp_syn = 0x02;
+static constexpr std::uint8_t tcp_rst = 0x04;
+static constexpr std::uint8_t tcp_ack = 0x10;
+
+/** @brief The size that the connection table starts out at. Must be a power of 2. */
+static constexpr std::size_t initial_slots = 64;
+
+/** @returns How far @p seq is ahead of @p next, allowing for sequence numbers wrapping around. */
+static inline std::int32_t seq_offset(std::uint32_t seq, std::uint32_t next) noexcept
+{
+    return static_cast<std::int32_t>(seq - next);
+}
+
+/** @returns Whether @p packet was sent from the client of @p endpoints (or by the server). */
+static inline bool is_from_client(
+    const gunblade::TcpEndpoints& endpoints,
+    const gunblade::TcpPacketView& packet) noexcept
+{
+    return packet.src_port == endpoints.client_port && packet.src_addr == endpoints.client_addr;
+}
+
+/** @returns Whether @p packet was sent between @p endpoints, either way. */
+static bool is_same_connection(
+    const gunblade::TcpEndpoints& endpoints,
+    const gunblade::TcpPacketView& packet) noexcept
+{
+    if (packet.is_v6 != endpoints.is_v6)
+    {
+        return false;
+    }
+
+    return (packet.src_port == endpoints.client_port && packet.dst_port == endpoints.server_port &&
+            packet.src_addr == endpoints.client_addr &&
+            packet.dst_addr == endpoints.server_addr) ||
+           (packet.src_port == endpoints.server_port && packet.dst_port == endpoints.client_port &&
+            packet.src_addr == endpoints.server_addr && packet.dst_addr == endpoints.client_addr);
+}
+
+namespace gunblade
+{
+    TcpReassembler::TcpReassembler(const TcpReassemblerOptions& options)
+        : options_(options), slots_(initial_slots)
+    {
+        // Do nothing
+    }
+
+    TcpReassembler::~TcpReassembler() = default;
+
+    void TcpReassembler::process(const TcpPacketView& packet, std::chrono::microseconds timestamp)
+    {
+        process_one(packet, timestamp);
+        end_batch();
+    }
+
+    void TcpReassembler::process(std::span<const CapturedPacket> packets)
+    {
+        for (const auto& packet : packets)
+        {
+            process_one(packet.tcp, packet.timestamp);
+        }
+
+        end_batch();
+    }
+
+    void TcpReassembler::process_one(
+        const TcpPacketView& packet,
+        std::chrono::microseconds timestamp)
+    {
+        if (options_.idle_timeout.count() > 0 && timestamp - last_expiry_ >= options_.idle_timeout)
+        {
+            expire(timestamp);
+            last_expiry_ = timestamp;
+        }
+
+        const bool syn = packet.flags & tcp_syn;
+        const bool fin = packet.flags & tcp_fin;
+        const bool rst = packet.flags & tcp_rst;
+
+        const auto hash = flow_hash(packet);
+        auto slot = find_slot(packet, hash);
+
+        if (!slots_[slot])
+        {
+            // Only start following a connection once it has something to follow
+            if (rst || (!syn && packet.payload.empty()))
+            {
+                return;
+            }
+
+            // Keep the table at most half full, so probes stay short
+            if ((size_ + 1) * 2 > slots_.size())
+            {
+                grow();
+                slot = find_slot(packet, hash);
+            }
+
+            open(slot, packet, hash);
+        }
+
+        auto& connection = *slots_[slot];
+        connection.last_seen = timestamp;
+
+        if (rst)
+        {
+            erase(slot);
+            return;
+        }
+
+        const bool from_client = is_from_client(connection.endpoints, packet);
+        auto& direction = connection.directions[from_client ? 0 : 1];
+
+        if (connection.handler)
+        {
+            auto seq = packet.seq;
+
+            if (syn)
+            {
+                // The SYN itself takes up a sequence number, before any data
+                ++seq;
+
+                if (!direction.synced)
+                {
+                    direction.next_seq = seq;
+                    direction.synced = true;
+                }
+            }
+            else if (!direction.synced && !packet.payload.empty())
+            {
+                // Joined partway through, so carry on from wherever this is
+                direction.next_seq = seq;
+                direction.synced = true;
+            }
+
+            if (direction.synced && !packet.payload.empty())
+            {
+                receive(connection, from_client, seq, packet.payload);
+            }
+        }
+
+        if (fin)
+        {
+            direction.finished = true;
+
+            if (connection.directions[0].finished && connection.directions[1].finished)
+            {
+                erase(slot);
+            }
+        }
+    }
+
+    std::size_t TcpReassembler::find_slot(
+        const TcpPacketView& packet,
+        std::uint64_t hash) const noexcept
+    {
+        const auto mask = slots_.size() - 1;
+        auto slot = static_cast<std::size_t>(hash) & mask;
+
+        while (slots_[slot] &&
+               !(slots_[slot]->hash == hash && is_same_connection(slots_[slot]->endpoints, packet)))
+        {
+            slot = (slot + 1) & mask;
+        }
+
+        return slot;
+    }
+
+    TcpReassembler::Connection& TcpReassembler::open(
+        std::size_t slot,
+        const TcpPacketView& packet,
+        std::uint64_t hash)
+    {
+        // The client sends the first SYN and the server answers it, but without
+        // the handshake, all there is to go on is who spoke first
+        const bool sent_by_server = (packet.flags & (tcp_syn | tcp_ack)) == (tcp_syn | tcp_ack);
+
+        auto connection = std::make_unique<Connection>();
+        auto& endpoints = connection->endpoints;
+        endpoints.is_v6 = packet.is_v6;
+        endpoints.client_addr = sent_by_server ? packet.dst_addr : packet.src_addr;
+        endpoints.server_addr = sent_by_server ? packet.src_addr : packet.dst_addr;
+        endpoints.client_port = sent_by_server ? packet.dst_port : packet.src_port;
+        endpoints.server_port = sent_by_server ? packet.src_port : packet.dst_port;
+
+        connection->hash = hash;
+        connection->handler = new_stream_ ? new_stream_(endpoints) : nullptr;
+
+        ++stats_.streams;
+        ++size_;
+
+        slots_[slot] = std::move(connection);
+        return *slots_[slot];
+    }
+
+    void TcpReassembler::end_batch()
+    {
+        // Handlers may not be destroyed while ending the batch, so this can't be invalidated
+        for (auto* connection : pending_)
+        {
+            connection->pending = false;
+
+            if (connection->handler)
+            {
+                connection->handler->on_batch_end();
+            }
+        }
+
+        pending_.clear();
+    }
+
+    void TcpReassembler::erase(std::size_t slot)
+    {
+        const auto mask = slots_.size() - 1;
+        auto& connection = *slots_[slot];
+
+        // Let the handler finish off whatever it was handed before it's gone
+        if (connection.pending)
+        {
+            std::erase(pending_, &connection);
+
+            if (connection.handler)
+            {
+                connection.handler->on_batch_end();
+            }
+        }
+
+        slots_[slot].reset();
+        --size_;
+
+        // Shift back any connections that probed past this slot, so they can still be found
+        auto hole = slot;
+
+        for (auto i = (slot + 1) & mask; slots_[i]; i = (i + 1) & mask)
+        {
+            const auto home = static_cast<std::size_t>(slots_[i]->hash) & mask;
+
+            if (((i - home) & mask) >= ((i - hole) & mask))
+            {
+                slots_[hole] = std::move(slots_[i]);
+                hole = i;
+            }
+        }
+    }
+
+    void TcpReassembler::grow()
+    {
+        std::vector<std::unique_ptr<Connection>> slots(slots_.size() * 2);
+        const auto mask = slots.size() - 1;
+
+        for (auto& connection : slots_)
+        {
+            if (!connection)
+            {
+                continue;
+            }
+
+            auto slot = static_cast<std::size_t>(connection->hash) & mask;
+
+            while (slots[slot])
+            {
+                slot = (slot + 1) & mask;
+            }
+
+            slots[slot] = std::move(connection);
+        }
+
+        slots_ = std::move(slots);
+    }
+
+    void TcpReassembler::expire(std::chrono::microseconds now)
+    {
+        for (std::size_t slot = 0; slot < slots_.size();)
+        {
+            // Erasing can shift another connection into this slot, so look at it again
+            if (slots_[slot] && now - slots_[slot]->last_seen >= options_.idle_timeout)
+            {
+                erase(slot);
+            }
+            else
+            {
+                ++slot;
+            }
+        }
+    }
+
+    void TcpReassembler::receive(
+        Connection& connection,
+        bool from_client,
+        std::uint32_t seq,
+        std::span<const std::uint8_t> data)
+    {
+        auto& direction = connection.directions[from_client ? 0 : 1];
+
+        if (seq_offset(seq, direction.next_seq) > 0)
+        {
+            ++stats_.out_of_order_segments;
+            hold(direction, seq, data);
+
+            // Give up waiting for the gap once too much is held, and let the decoder resync
+            if (direction.held_bytes > options_.max_held_bytes)
+            {
+                const auto first = direction.held.front().seq;
+                stats_.skipped_bytes += first - direction.next_seq;
+                direction.next_seq = first;
+                drain(connection, from_client);
+            }
+
+            return;
+        }
+
+        // The fast path: hand the data straight over, without copying it
+        ++stats_.in_order_segments;
+        deliver(connection, from_client, seq, data);
+        drain(connection, from_client);
+    }
+
+    void TcpReassembler::deliver(
+        Connection& connection,
+        bool from_client,
+        std::uint32_t seq,
+        std::span<const std::uint8_t> data)
+    {
+        auto& direction = connection.directions[from_client ? 0 : 1];
+
+        // Skip whatever was already handed over, if this was sent again
+        const std::size_t behind = direction.next_seq - seq;
+
+        if (behind >= data.size())
+        {
+            stats_.retransmitted_bytes += data.size();
+            return;
+        }
+
+        stats_.retransmitted_bytes += behind;
+        data = data.subspan(behind);
+        direction.next_seq += static_cast<std::uint32_t>(data.size());
+
+        if (!connection.handler)
+        {
+            return;
+        }
+
+        if (!connection.handler->on_data(from_client, data))
+        {
+            ignore(connection);
+        }
+        else if (!connection.pending)
+        {
+            connection.pending = true;
+            pending_.push_back(&connection);
+        }
+    }
+
+    void TcpReassembler::drain(Connection& connection, bool from_client)
+    {
+        auto& direction = connection.directions[from_client ? 0 : 1];
+
+        while (connection.handler && !direction.held.empty() &&
+               seq_offset(direction.held.front().seq, direction.next_seq) <= 0)
+        {
+            auto segment = std::move(direction.held.front());
+            direction.held.erase(direction.held.begin());
+            direction.held_bytes -= segment.data.size();
+
+            deliver(connection, from_client, segment.seq, segment.data);
+        }
+    }
+
+    void TcpReassembler::hold(
+        Direction& direction,
+        std::uint32_t seq,
+        std::span<const std::uint8_t> data)
+    {
+        // Keep the held segments in order, counting from the next byte expected
+        const auto next = direction.next_seq;
+        const auto position = std::upper_bound(
+            direction.held.begin(),
+            direction.held.end(),
+            seq,
+            [next](std::uint32_t value, const HeldSegment& segment) {
+                return seq_offset(value, next) < seq_offset(segment.seq, next);
+            });
+
+        direction.held.insert(position, HeldSegment{seq, {data.begin(), data.end()}});
+        direction.held_bytes += data.size();
+    }
+
+    void TcpReassembler::ignore(Connection& connection) noexcept
+    {
+        connection.handler.reset();
+
+        for (auto& direction : connection.directions)
+        {
+            direction.held.clear();
+            direction.held_bytes = 0;
+        }
+    }
+}  // namespace gunblade
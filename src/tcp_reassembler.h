@@ -0,0 +1,248 @@
+#pragma once
+
+#include "packet_parser.h"
+
+#include <array>       // array
+#include <chrono>      // microseconds, minutes
+#include <cstddef>     // size_t
+#include <cstdint>     // uint8_t, uint16_t, uint32_t, uint64_t
+#include <functional>  // function
+#include <memory>      // unique_ptr
+#include <span>        // span
+#include <utility>     // move
+#include <vector>      // vector
+
+namespace gunblade
+{
+    /** @brief The two ends of a TCP connection, as seen by `TcpReassembler`. */
+    struct TcpEndpoints
+    {
+        bool is_v6 = false;
+
+        /** @brief The client's address, in network byte order. IPv4 uses the first 4 bytes. */
+        std::array<std::uint8_t, 16> client_addr{};
+
+        /** @brief The server's address, in network byte order. IPv4 uses the first 4 bytes. */
+        std::array<std::uint8_t, 16> server_addr{};
+
+        std::uint16_t client_port = 0;
+        std::uint16_t server_port = 0;
+    };
+
+    /** @brief Consumes the data of one TCP connection, in order. */
+    class TcpStreamHandler
+    {
+    public:
+        virtual ~TcpStreamHandler() = default;
+
+        /**
+         * @brief Consumes the next bytes sent by one side of the connection.
+         *
+         * @param from_client Whether the client sent @p data, rather than the server
+         * @param data The bytes, which are only valid until this returns
+         * @return Whether to keep following the connection. Once this returns
+         * false, the rest of the connection is ignored.
+         */
+        virtual bool on_data(bool from_client, std::span<const std::uint8_t> data) = 0;
+
+        /**
+         * @brief Called once the data of a whole batch of packets has been handed
+         * over, if any of it was for this connection. Handlers that only buffer
+         * in `on_data()` can do the rest of their work here, once per batch.
+         */
+        virtual void on_batch_end()
+        {
+            // Do nothing
+        }
+    };
+
+    struct TcpReassemblerOptions
+    {
+        /**
+         * @brief The most out-of-order bytes that one direction may hold on to while
+         * waiting for a gap to be filled. Past that, the gap is skipped.
+         */
+        std::size_t max_held_bytes = 1024 * 1024;
+
+        /** @brief How long a connection may go without any packets before it's forgotten. */
+        std::chrono::microseconds idle_timeout = std::chrono::minutes(5);
+    };
+
+    /**
+     * @brief Reassembles TCP connections from parsed packets, for a handful of
+     * long-lived, mostly in-order connections.
+     *
+     * Connections live in one flat, open-addressed table. Segments that arrive in
+     * order are handed to the connection's handler straight out of the packet,
+     * without being copied, and only segments that arrive early are copied into a
+     * small holding area until the gap before them is filled (or given up on).
+     *
+     * Connections are followed from whichever packet is seen first, so captures
+     * that start mid-connection still decode. Must only be used from one thread.
+     */
+    class TcpReassembler final
+    {
+    public:
+        /**
+         * @brief Sets up a handler for a connection seen for the first time.
+         *
+         * Returns null to ignore the connection.
+         */
+        using NewStream = std::function<std::unique_ptr<TcpStreamHandler>(const TcpEndpoints&)>;
+
+        struct Stats
+        {
+            /** @brief Connections seen. */
+            std::uint64_t streams = 0;
+
+            /** @brief Segments handed over as soon as they arrived. */
+            std::uint64_t in_order_segments = 0;
+
+            /** @brief Segments held until the gap before them was filled. */
+            std::uint64_t out_of_order_segments = 0;
+
+            /** @brief Bytes that arrived again after they were handed over. */
+            std::uint64_t retransmitted_bytes = 0;
+
+            /** @brief Bytes never seen, because the gap they were in was skipped. */
+            std::uint64_t skipped_bytes = 0;
+        };
+
+        explicit TcpReassembler(const TcpReassemblerOptions& options = TcpReassemblerOptions());
+
+        TcpReassembler(const TcpReassembler&) = delete;
+        TcpReassembler& operator=(const TcpReassembler&) = delete;
+
+        ~TcpReassembler();
+
+        /** @brief Sets up new connections with @p callback. Until then, they are ignored. */
+        inline void new_stream_callback(NewStream callback)
+        {
+            new_stream_ = std::move(callback);
+        }
+
+        /**
+         * @brief Processes a captured packet, handing over whatever data it completes.
+         *
+         * @param packet The packet, which only needs to stay valid until this returns
+         * @param timestamp When the packet was captured, to expire idle connections by
+         */
+        void process(const TcpPacketView& packet, std::chrono::microseconds timestamp);
+
+        /**
+         * @brief Processes a batch of captured packets, then ends the batch for
+         * every connection that was handed any data.
+         *
+         * @param packets The packets, which only need to stay valid until this returns
+         */
+        void process(std::span<const CapturedPacket> packets);
+
+        /** @returns The number of connections being followed (or ignored). */
+        inline std::size_t size() const noexcept
+        {
+            return size_;
+        }
+
+        inline const Stats& stats() const noexcept
+        {
+            return stats_;
+        }
+
+    private:
+        /** @brief A segment that arrived before the data in front of it. */
+        struct HeldSegment
+        {
+            std::uint32_t seq = 0;
+            std::vector<std::uint8_t> data;
+        };
+
+        /** @brief One direction of a connection. */
+        struct Direction
+        {
+            /** @brief The sequence number of the next byte to hand over. */
+            std::uint32_t next_seq = 0;
+
+            /** @brief Whether `next_seq` is known yet. */
+            bool synced = false;
+
+            bool finished = false;
+
+            /** @brief Segments waiting for a gap to be filled, in sequence order. */
+            std::vector<HeldSegment> held;
+            std::size_t held_bytes = 0;
+        };
+
+        struct Connection
+        {
+            TcpEndpoints endpoints;
+            std::uint64_t hash = 0;
+
+            /** @brief The handler, or null if the connection is being ignored. */
+            std::unique_ptr<TcpStreamHandler> handler;
+
+            /** @brief The client's direction, then the server's. */
+            std::array<Direction, 2> directions;
+
+            std::chrono::microseconds last_seen{0};
+
+            /** @brief Whether the handler has been handed data since the batch began. */
+            bool pending = false;
+        };
+
+        /** @brief Processes one packet, without ending the batch. */
+        void process_one(const TcpPacketView& packet, std::chrono::microseconds timestamp);
+
+        /** @brief Ends the batch for every connection that was handed data in it. */
+        void end_batch();
+
+        /** @brief Finds the slot that @p packet's connection is in, or would go in. */
+        std::size_t find_slot(const TcpPacketView& packet, std::uint64_t hash) const noexcept;
+
+        /** @brief Sets up a connection for @p packet in the empty slot @p slot. */
+        Connection& open(std::size_t slot, const TcpPacketView& packet, std::uint64_t hash);
+
+        /** @brief Forgets the connection in @p slot, keeping every other one findable. */
+        void erase(std::size_t slot);
+
+        void grow();
+
+        /** @brief Forgets every connection that's been idle for too long. */
+        void expire(std::chrono::microseconds now);
+
+        /** @brief Hands over @p data, sent by one side at @p seq, and anything it completes. */
+        void receive(
+            Connection& connection,
+            bool from_client,
+            std::uint32_t seq,
+            std::span<const std::uint8_t> data);
+
+        /** @brief Hands over the part of @p data that hasn't been already. */
+        void deliver(
+            Connection& connection,
+            bool from_client,
+            std::uint32_t seq,
+            std::span<const std::uint8_t> data);
+
+        /** @brief Hands over held segments until the next gap. */
+        void drain(Connection& connection, bool from_client);
+
+        /** @brief Holds @p data until the gap before it is filled. */
+        void hold(Direction& direction, std::uint32_t seq, std::span<const std::uint8_t> data);
+
+        /** @brief Stops following @p connection, keeping it in the table so it stays ignored. */
+        static void ignore(Connection& connection) noexcept;
+
+        NewStream new_stream_;
+        const TcpReassemblerOptions options_;
+
+        /** @brief The table of connections, which are null in empty slots. */
+        std::vector<std::unique_ptr<Connection>> slots_;
+        std::size_t size_ = 0;
+
+        /** @brief The connections that were handed data in the current batch. */
+        std::vector<Connection*> pending_;
+
+        std::chrono::microseconds last_expiry_{0};
+        Stats stats_;
+    };
+}  // namespace gunblade
@@ -0,0 +1,184 @@
+#include "tcp_table.h"
+
+#include <array>          // array
+#include <cstdint>        // uint8_t, uint32_t
+#include <cstdlib>        // strtoul
+#include <cstring>        // memcpy
+#include <filesystem>     // directory_iterator, read_symlink
+#include <fstream>        // ifstream
+#include <sstream>        // istringstream
+#include <string>         // string, getline
+#include <string_view>    // string_view
+#include <unordered_map>  // unordered_map
+
+namespace fs = std::filesystem;
+
+/** @brief A row of /proc/net/tcp or /proc/net/tcp6, before its owner is known. */
+struct ProcNetRow
+{
+    gunblade::ConnectionInfo info;
+    unsigned long inode;
+};
+
+static unsigned long parse_hex(std::string_view hex)
+{
+    return std::strtoul(std::string(hex).c_str(), nullptr, 16);
+}
+
+/**
+ * @brief Parses an address from /proc/net/tcp{,6}.
+ *
+ * The kernel prints addresses as 32-bit words of raw (network order)
+ * memory in host byte order, so each word is copied back out as-is.
+ */
+static gunblade::IPAddress parse_address(std::string_view hex)
+{
+    if (hex.size() == 8)
+    {
+        return Tins::IPv4Address(static_cast<std::uint32_t>(parse_hex(hex)));
+    }
+
+    std::array<std::uint8_t, 16> bytes;
+
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        const auto word = static_cast<std::uint32_t>(parse_hex(hex.substr(i * 8, 8)));
+        std::memcpy(bytes.data() + i * 4, &word, sizeof(word));
+    }
+
+    return Tins::IPv6Address(bytes.data());
+}
+
+/** @brief Parses an "address:port" pair from /proc/net/tcp{,6}. */
+static std::pair<gunblade::IPAddress, unsigned short> parse_endpoint(std::string_view endpoint)
+{
+    const auto colon = endpoint.find(':');
+
+    return {
+        parse_address(endpoint.substr(0, colon)),
+        static_cast<unsigned short>(parse_hex(endpoint.substr(colon + 1)))};
+}
+
+static gunblade::TcpState parse_state(unsigned long state)
+{
+    using gunblade::TcpState;
+
+    // See include/net/tcp_states.h in the Linux source
+    switch (state)
+    {
+        case 0x01: return TcpState::ESTABLISHED;
+        case 0x02: return TcpState::SYN_SENT;
+        case 0x03: return TcpState::SYN_RCVD;
+        case 0x04: return TcpState::FIN_WAIT1;
+        case 0x05: return TcpState::FIN_WAIT2;
+        case 0x06: return TcpState::TIME_WAIT;
+        case 0x07: return TcpState::CLOSED;
+        case 0x08: return TcpState::CLOSE_WAIT;
+        case 0x09: return TcpState::LAST_ACK;
+        case 0x0a: return TcpState::LISTEN;
+        case 0x0b: return TcpState::CLOSING;
+        default: return TcpState::UNKNOWN;
+    }
+}
+
+static void read_proc_net(const char* path, std::vector<ProcNetRow>& rows)
+{
+    std::ifstream file(path);
+    std::string line;
+
+    // Skip the column headings
+    std::getline(file, line);
+
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string slot, local, remote, state, queues, timer, retransmits, uid, timeout;
+        unsigned long inode = 0;
+
+        if (!(fields >> slot >> local >> remote >> state >> queues >> timer >> retransmits >>
+              uid >> timeout >> inode))
+        {
+            continue;
+        }
+
+        const auto [local_addr, local_port] = parse_endpoint(local);
+        const auto [remote_addr, remote_port] = parse_endpoint(remote);
+
+        rows.push_back(ProcNetRow{
+            gunblade::ConnectionInfo{
+                local_addr,
+                local_port,
+                remote_addr,
+                remote_port,
+                parse_state(parse_hex(state)),
+                0},
+            inode});
+    }
+}
+
+/** @returns A map of socket inode numbers to the IDs of the processes that hold them open. */
+static std::unordered_map<unsigned long, unsigned long> get_socket_owners()
+{
+    static constexpr std::string_view socket_prefix = "socket:[";
+
+    std::unordered_map<unsigned long, unsigned long> owners;
+    const fs::directory_iterator end;
+
+    // Processes can exit (or be inaccessible) at any time, so ignore all errors
+    std::error_code proc_ec;
+    for (auto process = fs::directory_iterator("/proc", proc_ec); !proc_ec && process != end;
+         process.increment(proc_ec))
+    {
+        const auto name = process->path().filename().string();
+
+        // Only the numeric directories are processes
+        if (name.empty() || name.find_first_not_of("0123456789") != std::string::npos)
+        {
+            continue;
+        }
+
+        const auto pid = std::stoul(name);
+
+        std::error_code fd_ec;
+        for (auto fd = fs::directory_iterator(process->path() / "fd", fd_ec); !fd_ec && fd != end;
+             fd.increment(fd_ec))
+        {
+            std::error_code link_ec;
+            const auto target = fs::read_symlink(fd->path(), link_ec).string();
+
+            if (!link_ec && target.starts_with(socket_prefix))
+            {
+                owners.emplace(std::stoul(target.substr(socket_prefix.size())), pid);
+            }
+        }
+    }
+
+    return owners;
+}
+
+namespace gunblade
+{
+    std::vector<ConnectionInfo> get_tcp_table()
+    {
+        std::vector<ProcNetRow> rows;
+        read_proc_net("/proc/net/tcp", rows);
+        read_proc_net("/proc/net/tcp6", rows);
+
+        const auto owners = get_socket_owners();
+
+        std::vector<ConnectionInfo> table;
+        table.reserve(rows.size());
+
+        for (auto& row : rows)
+        {
+            if (const auto it = owners.find(row.inode); it != owners.end())
+            {
+                row.info.pid = it->second;
+            }
+
+            table.push_back(row.info);
+        }
+
+        return table;
+    }
+}  // namespace gunblade
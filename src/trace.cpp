@@ -0,0 +1,192 @@
+#include "trace.h"
+
+#include <chrono>   // steady_clock
+#include <cstddef>  // size_t
+#include <memory>   // make_shared, shared_ptr
+#include <mutex>    // lock_guard, mutex
+#include <new>      // bad_alloc
+#include <string>   // string
+#include <utility>  // move
+#include <vector>   // vector
+
+#include <nlohmann/json.hpp>
+
+/** @brief The most spans to keep for each thread, so a long trace can't use up all memory. */
+static constexpr std::size_t max_spans_per_thread = 1 << 20;
+
+struct TraceSpan
+{
+    const char* name;
+    std::int64_t start;
+    std::int64_t end;
+};
+
+/**
+ * @brief The spans recorded by one thread.
+ *
+ * Only its own thread adds to it, so its lock is never contended until the
+ * trace is written out.
+ */
+struct ThreadBuffer
+{
+    std::mutex mutex;
+    std::size_t id = 0;
+    std::string name;
+    std::vector<TraceSpan> spans;
+    std::size_t dropped = 0;
+};
+
+/** @brief Every thread's buffer, kept after the thread exits so its spans can be written. */
+static std::mutex& registry_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<std::shared_ptr<ThreadBuffer>>& registry()
+{
+    static std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    return buffers;
+}
+
+static ThreadBuffer& thread_buffer()
+{
+    thread_local const auto buffer = []() {
+        auto buffer = std::make_shared<ThreadBuffer>();
+
+        std::lock_guard lock(registry_mutex());
+        buffer->id = registry().size() + 1;
+        registry().push_back(buffer);
+
+        return buffer;
+    }();
+
+    return *buffer;
+}
+
+/** @brief Writes @p ns nanoseconds as microseconds, which is what trace events are measured in. */
+static void write_microseconds(std::ostream& out, std::int64_t ns)
+{
+    const auto fraction = ns % 1000;
+
+    out << ns / 1000 << '.' << (fraction < 100 ? "0" : "") << (fraction < 10 ? "0" : "")
+        << fraction;
+}
+
+namespace gunblade::trace
+{
+    namespace detail
+    {
+        std::atomic<bool> recording = false;
+
+        std::int64_t now() noexcept
+        {
+            using clock = std::chrono::steady_clock;
+
+            static const auto started = clock::now();
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - started)
+                .count();
+        }
+
+        void record(const char* name, std::int64_t start, std::int64_t end) noexcept
+        {
+            auto& buffer = thread_buffer();
+            std::lock_guard lock(buffer.mutex);
+
+            if (buffer.spans.size() >= max_spans_per_thread)
+            {
+                ++buffer.dropped;
+                return;
+            }
+
+            try
+            {
+                buffer.spans.push_back(TraceSpan{name, start, end});
+            }
+            catch (const std::bad_alloc&)
+            {
+                ++buffer.dropped;
+            }
+        }
+    }  // namespace detail
+
+    void start() noexcept
+    {
+        // Start the clock now, rather than in the middle of the first span
+        detail::now();
+        detail::recording.store(true, std::memory_order_relaxed);
+    }
+
+    void stop() noexcept
+    {
+        detail::recording.store(false, std::memory_order_relaxed);
+    }
+
+    void set_thread_name(std::string name)
+    {
+        // Don't bother giving the thread a buffer if it can never record anything
+        if constexpr (!compiled_in)
+        {
+            return;
+        }
+
+        auto& buffer = thread_buffer();
+        std::lock_guard lock(buffer.mutex);
+        buffer.name = std::move(name);
+    }
+
+    void write_chrome_trace(std::ostream& out)
+    {
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+
+        {
+            std::lock_guard lock(registry_mutex());
+            buffers = registry();
+        }
+
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+
+        const auto separate = [&out, &first]() {
+            if (!first)
+            {
+                out << ",\n";
+            }
+
+            first = false;
+        };
+
+        for (const auto& buffer : buffers)
+        {
+            std::lock_guard lock(buffer->mutex);
+
+            if (!buffer->name.empty())
+            {
+                separate();
+                out << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << buffer->id
+                    << R"(,"args":{"name":)" << nlohmann::json(buffer->name).dump() << "}}";
+            }
+
+            if (buffer->dropped > 0)
+            {
+                separate();
+                out << R"({"name":"spans_dropped","ph":"C","pid":1,"tid":)" << buffer->id
+                    << R"(,"ts":0,"args":{"dropped":)" << buffer->dropped << "}}";
+            }
+
+            // Complete events, which carry their own duration
+            for (const auto& span : buffer->spans)
+            {
+                separate();
+                out << R"({"name":")" << span.name << R"(","ph":"X","pid":1,"tid":)"
+                    << buffer->id << R"(,"ts":)";
+                write_microseconds(out, span.start);
+                out << R"(,"dur":)";
+                write_microseconds(out, span.end - span.start);
+                out << '}';
+            }
+        }
+
+        out << "]}\n";
+    }
+}  // namespace gunblade::trace
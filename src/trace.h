@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>   // atomic
+#include <cstdint>  // int64_t
+#include <ostream>  // ostream
+#include <string>   // string
+
+/**
+ * Trace spans are only compiled in when GUNBLADE_TRACING is defined (with the
+ * GUNBLADE_TRACING CMake option), and even then are only recorded between
+ * `trace::start()` and `trace::stop()`. Without it, `GUNBLADE_TRACE_SPAN`
+ * expands to nothing at all.
+ */
+#ifdef GUNBLADE_TRACING
+#define GUNBLADE_TRACE_CONCAT_INNER(a, b) a##b
+#define GUNBLADE_TRACE_CONCAT(a, b) GUNBLADE_TRACE_CONCAT_INNER(a, b)
+
+/** @brief Traces the rest of the enclosing scope as a span named @p name (a string literal). */
+#define GUNBLADE_TRACE_SPAN(name) \
+    const ::gunblade::trace::Span GUNBLADE_TRACE_CONCAT(gunblade_trace_span_, __LINE__)(name)
+#else
+#define GUNBLADE_TRACE_SPAN(name) static_cast<void>(0)
+#endif
+
+namespace gunblade::trace
+{
+    /** @brief Whether trace spans were compiled in. */
+#ifdef GUNBLADE_TRACING
+    inline constexpr bool compiled_in = true;
+#else
+    inline constexpr bool compiled_in = false;
+#endif
+
+    namespace detail
+    {
+        extern std::atomic<bool> recording;
+
+        /** @returns The number of nanoseconds since the trace clock started. */
+        std::int64_t now() noexcept;
+
+        /** @brief Adds a span to the calling thread's buffer. */
+        void record(const char* name, std::int64_t start, std::int64_t end) noexcept;
+    }  // namespace detail
+
+    /** @brief Starts recording spans, on every thread. */
+    void start() noexcept;
+
+    /** @brief Stops recording spans. The spans already recorded are kept. */
+    void stop() noexcept;
+
+    /** @brief Names the calling thread, to tell the threads apart in the trace. */
+    void set_thread_name(std::string name);
+
+    /**
+     * @brief Writes every span recorded so far as Chrome `trace_event` JSON,
+     * which Perfetto and chrome://tracing can open.
+     *
+     * Spans still being recorded by other threads may or may not be included.
+     */
+    void write_chrome_trace(std::ostream& out);
+
+    /** @brief Records the time from its construction to its destruction, if recording. */
+    class Span final
+    {
+    public:
+        /** @param name The name of the span. Must live forever, like a string literal. */
+        explicit Span(const char* name) noexcept
+            : name_(name),
+              start_(detail::recording.load(std::memory_order_relaxed) ? detail::now() : -1)
+        {
+            // Do nothing
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        ~Span()
+        {
+            if (start_ >= 0)
+            {
+                detail::record(name_, start_, detail::now());
+            }
+        }
+
+    private:
+        const char* const name_;
+        const std::int64_t start_;
+    };
+}  // namespace gunblade::trace
@@ -1,9 +1,15 @@
 #pragma once
 
 #include <codecvt>  // codecvt_utf8
+#include <cstdio>   // FILE
 #include <locale>   // wstring_convert
 #include <string>   // string
 
+#ifdef _WIN32
+#include <fcntl.h>  // _O_BINARY
+#include <io.h>     // _fileno, _setmode
+#endif
+
 namespace gunblade
 {
     template <typename String>
@@ -17,6 +23,17 @@ namespace gunblade
         return converter.to_bytes(wstr.data());
     }
 
+    /**
+     * @brief Stops newlines written to (or read from) @p file from being
+     * translated, which only happens on Windows.
+     */
+    inline void set_binary_mode([[maybe_unused]] std::FILE* file)
+    {
+#ifdef _WIN32
+        _setmode(_fileno(file), _O_BINARY);
+#endif
+    }
+
     /**
      * @brief Get the name of the process identified by @p pid.
      *
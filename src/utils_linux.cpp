@@ -0,0 +1,19 @@
+#include "utils.h"
+
+#include <fstream>  // ifstream
+
+namespace gunblade
+{
+    std::string get_process_name(unsigned long pid)
+    {
+        std::ifstream comm("/proc/" + std::to_string(pid) + "/comm");
+        std::string name;
+
+        if (!std::getline(comm, name))
+        {
+            return std::string();
+        }
+
+        return name;
+    }
+}  // namespace gunblade
@@ -0,0 +1,207 @@
+#include "test_support.h"
+
+#include "ffxiv/inflater.h"
+#include "ffxiv/structs.h"
+
+#include <algorithm>  // equal
+#include <cstddef>    // max_align_t, size_t
+#include <cstdint>    // uint16_t, uint32_t
+#include <cstdlib>    // aligned_alloc, free, malloc
+#include <new>        // align_val_t, bad_alloc, nothrow_t
+#include <vector>     // vector
+
+using namespace gunblade::ffxiv;
+using gunblade::test::check;
+
+// Counts every allocation made through operator new while `counting` is set
+static bool counting = false;
+static std::size_t allocations = 0;
+
+static void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t))
+{
+    if (counting)
+    {
+        ++allocations;
+    }
+
+    size = size == 0 ? 1 : size;
+    void* memory = nullptr;
+
+    if (alignment > alignof(std::max_align_t))
+    {
+        // aligned_alloc needs the size to be a multiple of the alignment
+        memory = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+    else
+    {
+        memory = std::malloc(size);
+    }
+
+    if (!memory)
+    {
+        throw std::bad_alloc();
+    }
+
+    return memory;
+}
+
+void* operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return allocate(size);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return allocate(size);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+/** @brief Inflates each bundle and walks its segments, as the decoder's consumers do. */
+static std::size_t decode_all(Inflater& inflater, const std::vector<Bundle>& bundles)
+{
+    std::size_t segments = 0;
+
+    for (const auto& bundle : bundles)
+    {
+        const auto view = bundle.view();
+        const auto decompressed = view.decompressed_payload(inflater);
+
+        for (const auto& segment : view.segments_view(decompressed))
+        {
+            segments += segment.data.empty() ? 0 : 1;
+        }
+    }
+
+    return segments;
+}
+
+/**
+ * @brief Checks that once an inflater's buffer has grown to fit the bundles it
+ * sees, inflating more of them doesn't allocate at all.
+ */
+int main()
+{
+    // Bundles of a few sizes, out of order, so the buffer has to grow past the first one
+    std::vector<Bundle> bundles;
+    std::vector<Bundle> expected;
+
+    for (const std::size_t segments : {4, 64, 1, 16})
+    {
+        gunblade::test::BundleBuilder builder;
+        for (std::size_t i = 0; i < segments; ++i)
+        {
+            builder.add_ipc(
+                static_cast<std::uint16_t>(0x100 + i),
+                64 + i * 16,
+                static_cast<std::uint32_t>(i));
+        }
+
+        bundles.push_back(builder.build(Compression::ZLIB));
+        expected.push_back(builder.build(Compression::NONE));
+    }
+
+    Inflater inflater;
+
+    // Warm up: the buffer grows to fit the largest payload, and zlib sets up its window
+    const auto segments = decode_all(inflater, bundles);
+    check(segments == 4 + 64 + 1 + 16, "every segment is decoded");
+
+    for (std::size_t i = 0; i < bundles.size(); ++i)
+    {
+        const auto decompressed = inflater.inflate(bundles[i].payload);
+        check(
+            std::equal(
+                decompressed.begin(),
+                decompressed.end(),
+                expected[i].payload.begin(),
+                expected[i].payload.end()),
+            "inflated payloads match the originals");
+    }
+
+    const auto capacity = inflater.capacity();
+
+    counting = true;
+    for (int round = 0; round < 100; ++round)
+    {
+        decode_all(inflater, bundles);
+    }
+    counting = false;
+
+    check(allocations == 0, "inflating after warming up doesn't allocate");
+    check(inflater.capacity() == capacity, "the buffer doesn't grow after warming up");
+
+    return gunblade::test::result();
+}
@@ -0,0 +1,154 @@
+#include "test_support.h"
+
+#include "ffxiv/inflater.h"
+#include "ffxiv/json_writer.h"
+#include "ffxiv/structs.h"
+
+#include <cstdint>  // uint16_t, uint32_t
+#include <cstdio>   // fprintf
+#include <span>     // span
+#include <string>   // string
+#include <vector>   // vector
+
+#include <nlohmann/json.hpp>
+
+using namespace gunblade::ffxiv;
+using gunblade::test::check;
+
+template <typename KeepAliveType>
+static std::vector<char> keep_alive_data(std::uint32_t id)
+{
+    const KeepAliveType keep_alive{id, 1600000000 + id};
+    const auto* bytes = reinterpret_cast<const char*>(&keep_alive);
+    return std::vector<char>(bytes, bytes + sizeof(keep_alive));
+}
+
+/** @returns A bundle with one of every kind of segment that can be written. */
+static Bundle make_mixed_bundle(Compression compression)
+{
+    const std::vector<char> unknown{'\x01', '\x02', '\x03'};
+
+    gunblade::test::BundleBuilder builder;
+    builder.add_ipc(0x0101, 64, 1)
+        .add(SegmentType::CLIENT_KEEPALIVE, keep_alive_data<ClientKeepAlive>(7))
+        .add(SegmentType::SERVER_KEEPALIVE, keep_alive_data<ServerKeepAlive>(8))
+        .add(static_cast<SegmentType>(0x1234), unknown)
+        .add(static_cast<SegmentType>(0), std::span<const char>());
+
+    // IPC data of every length mod 3, to cover each kind of base64 padding
+    for (std::uint32_t size = 0; size < 6; ++size)
+    {
+        builder.add_ipc(static_cast<std::uint16_t>(0xfff0 + size), size, size);
+    }
+
+    return builder.build(compression);
+}
+
+/** @brief The record that `write_json_line` writes, built with `to_json` instead. */
+static nlohmann::json expected_record(
+    const Connection& connection,
+    unsigned long process_id,
+    const Bundle& bundle,
+    const Timing* timing)
+{
+    // clang-format off
+    nlohmann::json record = {
+        {"connection", {
+            {"source", {
+                {"host", connection.source.host},
+                {"port", connection.source.port}
+            }},
+            {"destination", {
+                {"host", connection.destination.host},
+                {"port", connection.destination.port}
+            }},
+        }},
+        {"processId", process_id},
+        {"bundle", bundle}
+    };
+    // clang-format on
+
+    if (timing)
+    {
+        record["timing"] = {{"capturedUs", timing->captured_us}, {"emittedUs", timing->emitted_us}};
+    }
+
+    return record;
+}
+
+/** @brief Checks that the line written for @p bundle is exactly what `dump()` makes of it. */
+static void check_bundle(
+    const std::string& name,
+    Inflater& inflater,
+    const Connection& connection,
+    unsigned long process_id,
+    const Bundle& bundle,
+    const Timing* timing)
+{
+    const auto view = bundle.view();
+    const auto segments = view.segments(view.decompressed_payload(inflater));
+
+    std::string actual;
+    write_json_line(actual, connection, process_id, view, segments, timing);
+
+    const auto expected = expected_record(connection, process_id, bundle, timing).dump() + '\n';
+
+    check(actual == expected, name);
+    if (actual != expected)
+    {
+        std::fprintf(stderr, "  expected: %s  actual:   %s", expected.c_str(), actual.c_str());
+    }
+}
+
+/** @brief `to_json` encodes IPC data with `append_base64` too, so check it on its own. */
+static void check_base64()
+{
+    // The test vectors from RFC 4648
+    const std::string vectors[][2] = {
+        {"", ""},
+        {"f", "Zg=="},
+        {"fo", "Zm8="},
+        {"foo", "Zm9v"},
+        {"foob", "Zm9vYg=="},
+        {"fooba", "Zm9vYmE="},
+        {"foobar", "Zm9vYmFy"}};
+
+    for (const auto& [input, expected] : vectors)
+    {
+        std::string actual = "prefix:";
+        append_base64(actual, input);
+        check(actual == "prefix:" + expected, "base64 of \"" + input + "\"");
+    }
+}
+
+/**
+ * @brief Checks that `write_json_line` writes byte-for-byte what
+ * `nlohmann::json::dump()` does for the same record, built from the owned
+ * bundle with `to_json`.
+ */
+int main()
+{
+    const Connection ipv4{{"203.0.113.1", 55006}, {"192.168.0.2", 50000}};
+    const Connection ipv6{{"2001:db8::1", 443}, {"fe80::1", 0}};
+    const Timing timing{1700000000123456, 1700000000124000};
+
+    check_base64();
+
+    Inflater inflater;
+
+    for (const auto compression : {Compression::NONE, Compression::ZLIB})
+    {
+        const auto prefix = compression == Compression::NONE ? std::string("NONE")
+                                                             : std::string("ZLIB");
+
+        const auto mixed = make_mixed_bundle(compression);
+        const auto empty = gunblade::test::BundleBuilder().build(compression, 0);
+
+        check_bundle(prefix + " mixed bundle", inflater, ipv4, 1234, mixed, nullptr);
+        check_bundle(prefix + " mixed bundle, --timestamps", inflater, ipv6, 0, mixed, &timing);
+        check_bundle(prefix + " empty bundle", inflater, ipv4, 4294967295ul, empty, nullptr);
+        check_bundle(prefix + " empty bundle, --timestamps", inflater, ipv6, 1, empty, &timing);
+    }
+
+    return gunblade::test::result();
+}
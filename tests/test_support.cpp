@@ -0,0 +1,114 @@
+#include "test_support.h"
+
+#include "ffxiv/magic_scanner.h"
+
+#include <cstdio>     // fprintf
+#include <cstring>    // memcpy
+#include <stdexcept>  // runtime_error
+
+#include <zlib.h>
+
+using namespace gunblade::ffxiv;
+
+static bool failed = false;
+
+template <typename T>
+static void append_raw(std::vector<char>& out, const T& value)
+{
+    const auto* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+static std::vector<char> compress(const std::vector<char>& data)
+{
+    auto length = compressBound(static_cast<uLong>(data.size()));
+    std::vector<char> compressed(length);
+
+    if (compress2(
+            reinterpret_cast<Bytef*>(compressed.data()),
+            &length,
+            reinterpret_cast<const Bytef*>(data.data()),
+            static_cast<uLong>(data.size()),
+            6) != Z_OK)
+    {
+        throw std::runtime_error("compress2 failed");
+    }
+
+    compressed.resize(length);
+    return compressed;
+}
+
+namespace gunblade::test
+{
+    BundleBuilder& BundleBuilder::add(SegmentType type, std::span<const char> data)
+    {
+        Segment::Header header{};
+        header.size = static_cast<std::uint32_t>(sizeof(header) + data.size());
+        header.source = 0x10000000u + count_;
+        header.target = 0x20000000u + count_;
+        header.type = type;
+
+        append_raw(payload_, header);
+        payload_.insert(payload_.end(), data.begin(), data.end());
+        ++count_;
+
+        return *this;
+    }
+
+    BundleBuilder& BundleBuilder::add_ipc(std::uint16_t type, std::size_t size, std::uint32_t seed)
+    {
+        IPC::Header ipc{};
+        ipc.magic = 0x0014;
+        ipc.type = type;
+        ipc.server_id = 1;
+        ipc.epoch = 1600000000;
+
+        std::vector<char> data;
+        append_raw(data, ipc);
+
+        // Half noise, half zeroes, so the payload still compresses
+        auto state = seed * 2654435761u + 1;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            state = state * 1103515245u + 12345u;
+            data.push_back(i % 2 == 0 ? static_cast<char>(state >> 16) : '\0');
+        }
+
+        return add(SegmentType::IPC, data);
+    }
+
+    Bundle BundleBuilder::build(Compression compression, std::uint64_t epoch) const
+    {
+        Bundle bundle{};
+        bundle.payload = compression == Compression::NONE ? payload_ : compress(payload_);
+
+        if (sizeof(bundle.header) + bundle.payload.size() > Bundle::max_length)
+        {
+            throw std::runtime_error("Test bundle is too large");
+        }
+
+        std::memcpy(&bundle.header, magic_number.data(), magic_number.size());
+        bundle.header.epoch = epoch;
+        bundle.header.length =
+            static_cast<std::uint16_t>(sizeof(bundle.header) + bundle.payload.size());
+        bundle.header.message_count = count_;
+        bundle.header.encoding = 1;
+        bundle.header.compression = compression;
+
+        return bundle;
+    }
+
+    void check(bool condition, std::string_view what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED: %.*s\n", static_cast<int>(what.size()), what.data());
+            failed = true;
+        }
+    }
+
+    int result()
+    {
+        return failed ? 1 : 0;
+    }
+}  // namespace gunblade::test
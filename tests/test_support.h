@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ffxiv/structs.h"
+
+#include <cstddef>      // size_t
+#include <cstdint>      // uint16_t, uint32_t, uint64_t
+#include <span>         // span
+#include <string_view>  // string_view
+#include <vector>       // vector
+
+namespace gunblade::test
+{
+    /** @brief Builds bundles one segment at a time, to test what consumes them. */
+    class BundleBuilder final
+    {
+    public:
+        /**
+         * @brief Adds a segment.
+         *
+         * @param type The segment type, which needn't be one that's known
+         * @param data The segment data, following its header
+         */
+        BundleBuilder& add(ffxiv::SegmentType type, std::span<const char> data);
+
+        /** @brief Adds an IPC segment, with @p size bytes of data that follow from @p seed. */
+        BundleBuilder& add_ipc(std::uint16_t type, std::size_t size, std::uint32_t seed = 0);
+
+        /**
+         * @brief Builds the bundle.
+         *
+         * @param compression How to encode the payload
+         * @param epoch The bundle's timestamp
+         * @throws std::runtime_error If the bundle is too large
+         */
+        ffxiv::Bundle build(
+            ffxiv::Compression compression,
+            std::uint64_t epoch = 1600000000000) const;
+
+    private:
+        /** @brief The decompressed payload. */
+        std::vector<char> payload_;
+
+        std::uint16_t count_ = 0;
+    };
+
+    /** @brief Reports @p what as a failure unless @p condition holds, and carries on. */
+    void check(bool condition, std::string_view what);
+
+    /** @returns The test's exit code: non-zero if any check failed. */
+    int result();
+}  // namespace gunblade::test
@@ -8,10 +8,8 @@ vcpkg_from_github(
 
 string(COMPARE EQUAL "${VCPKG_LIBRARY_LINKAGE}" "dynamic" LIBTINS_BUILD_SHARED)
 
-set(ENABLE_PCAP FALSE)
-if(NOT VCPKG_CMAKE_SYSTEM_NAME OR VCPKG_CMAKE_SYSTEM_NAME STREQUAL "WindowsStore")
-  set(ENABLE_PCAP TRUE)
-endif()
+# Sniffing (and replaying captures) needs pcap on every platform Gunblade supports
+set(ENABLE_PCAP TRUE)
 
 if(VCPKG_TARGET_IS_WINDOWS AND ENABLE_PCAP)
     # Using the Npcap SDK installed by vcpkg